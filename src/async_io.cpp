@@ -0,0 +1,241 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "async_io.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#endif
+
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/invalid_page_exception.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Number of threads of the pool used where io_uring is not available.
+ */
+static const int ASYNCPOOLTHREADS = 8;
+
+/**
+ * @brief Byte offset of page pageNo in a BlobFile.
+ */
+static inline off_t pageOffset(PageId pageNo)
+{
+	return (off_t) (pageNo - 1) * Page::SIZE;
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageReader::AsyncPageReader -- Constructor
+// -----------------------------------------------------------------------------
+
+AsyncPageReader::AsyncPageReader(const std::string& fileNameIn, int queueDepthIn)
+	: fileName(fileNameIn), queueDepth(queueDepthIn), inFlight(0), failedPageNo(Page::INVALID_NUMBER),
+	  ringFd(-1), stopping(false)
+{
+	fd = ::open(fileName.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw FileNotFoundException(fileName);
+
+	if (!setupRing()) {
+		for (int i = 0; i < ASYNCPOOLTHREADS; i++)
+			workers.push_back(std::thread(&AsyncPageReader::work, this));
+	}
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageReader::~AsyncPageReader -- destructor
+// -----------------------------------------------------------------------------
+
+AsyncPageReader::~AsyncPageReader()
+{
+	try {
+		wait();
+	} catch (const InvalidPageException &) {
+	}
+	if (ringFd >= 0) {
+		munmap(sqEntries, sqEntriesSize);
+		munmap(sqRing, sqRingSize);
+		if (cqRing != sqRing) munmap(cqRing, cqRingSize);
+		::close(ringFd);
+	} else {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		ready.notify_all();
+		for (std::thread& worker : workers) worker.join();
+	}
+	::close(fd);
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageReader::submit
+// -----------------------------------------------------------------------------
+
+void AsyncPageReader::submit(PageId pageNo, Page* page)
+{
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+	if (ringFd >= 0) {
+		if (inFlight == queueDepth) reapRing(1);
+
+		unsigned tail = *sqTail;
+		unsigned index = tail & *sqMask;
+		io_uring_sqe* sqe = reinterpret_cast<io_uring_sqe*>(sqEntries) + index;
+		std::memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = fd;
+		sqe->addr = reinterpret_cast<std::uint64_t>(page);
+		sqe->len = Page::SIZE;
+		sqe->off = pageOffset(pageNo);
+		sqe->user_data = pageNo;
+		sqArray[index] = index;
+		__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+		inFlight++;
+		// a failed submit leaves the entry queued; reapRing() submits it again
+		syscall(__NR_io_uring_enter, ringFd, 1, 0, 0, nullptr, 0);
+		return;
+	}
+#endif
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return inFlight < queueDepth; });
+	Request request = { pageNo, page };
+	requests.push_back(request);
+	inFlight++;
+	ready.notify_one();
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageReader::wait
+// -----------------------------------------------------------------------------
+
+void AsyncPageReader::wait()
+{
+	if (ringFd >= 0) {
+		while (inFlight > 0) reapRing(inFlight);
+	} else {
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return inFlight == 0; });
+	}
+
+	if (failedPageNo != Page::INVALID_NUMBER) {
+		PageId pageNo = failedPageNo;
+		failedPageNo = Page::INVALID_NUMBER;
+		throw InvalidPageException(pageNo, fileName);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageReader -- io_uring
+// -----------------------------------------------------------------------------
+
+bool AsyncPageReader::setupRing()
+{
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+	io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+	int ring = syscall(__NR_io_uring_setup, queueDepth, &params);
+	if (ring < 0)
+		return false;
+
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (singleMap) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+	sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+	if (sqRing == MAP_FAILED) {
+		::close(ring);
+		return false;
+	}
+	cqRing = singleMap ? sqRing
+		: mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+	sqEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+	sqEntries = mmap(nullptr, sqEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+	if (cqRing == MAP_FAILED || sqEntries == MAP_FAILED) {
+		if (sqEntries != MAP_FAILED) munmap(sqEntries, sqEntriesSize);
+		if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+		munmap(sqRing, sqRingSize);
+		::close(ring);
+		return false;
+	}
+
+	char* sq = static_cast<char*>(sqRing);
+	char* cq = static_cast<char*>(cqRing);
+	sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+	sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+	sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+	sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+	cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+	cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+	cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+	cqes = cq + params.cq_off.cqes;
+	queueDepth = std::min<int>(queueDepth, params.sq_entries);
+	ringFd = ring;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void AsyncPageReader::reapRing(unsigned minComplete)
+{
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+	unsigned unsubmitted = *sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+	if (syscall(__NR_io_uring_enter, ringFd, unsubmitted, minComplete, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) {
+		// the ring is unusable; count what is in flight as failed rather than wait forever
+		if (failedPageNo == Page::INVALID_NUMBER) failedPageNo = 1;
+		inFlight = 0;
+		return;
+	}
+	unsigned head = *cqHead;
+	unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++) {
+		io_uring_cqe* cqe = reinterpret_cast<io_uring_cqe*>(cqes) + (head & *cqMask);
+		if (cqe->res != (int) Page::SIZE && failedPageNo == Page::INVALID_NUMBER)
+			failedPageNo = cqe->user_data;
+		inFlight--;
+	}
+	__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// AsyncPageReader -- thread pool
+// -----------------------------------------------------------------------------
+
+void AsyncPageReader::work()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		ready.wait(lock, [this] { return stopping || !requests.empty(); });
+		if (requests.empty())
+			return;
+		Request request = requests.front();
+		requests.pop_front();
+
+		lock.unlock();
+		bool whole = pread(fd, request.page, Page::SIZE, pageOffset(request.pageNo)) == (ssize_t) Page::SIZE;
+		lock.lock();
+
+		if (!whole && failedPageNo == Page::INVALID_NUMBER)
+			failedPageNo = request.pageNo;
+		inFlight--;
+		done.notify_all();
+	}
+}
+
+}
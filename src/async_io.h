@@ -0,0 +1,137 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+#include "page.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Reads pages of a BlobFile asynchronously, many at a time, past the buffer manager.
+ *
+ * Reads go through io_uring where the kernel allows it and through a small pool of threads
+ * doing pread() otherwise. The reader opens the file a second time, read only, and reads page
+ * n at offset (n - 1) * Page::SIZE as BlobFile lays pages out. It therefore only sees what has
+ * been written to the file: callers flush the buffer manager first.
+ */
+class AsyncPageReader {
+ public:
+  /**
+   * @brief Open fileName for asynchronous reads with at most queueDepth reads in flight.
+   *
+   * @throws FileNotFoundException if the file does not exist
+   */
+  AsyncPageReader(const std::string& fileName, int queueDepth = 64);
+
+  /**
+   * @brief Waits for reads still in flight and closes the file.
+   */
+  ~AsyncPageReader();
+
+  /**
+   * @brief Queue a read of page pageNo into page. Returns at once unless queueDepth reads are in
+   * flight, in which case it first waits for one to complete. page must stay valid until wait().
+   */
+  void submit(PageId pageNo, Page* page);
+
+  /**
+   * @brief Wait until every read submitted so far has completed.
+   *
+   * @throws InvalidPageException if a read did not return a whole page
+   */
+  void wait();
+
+  /**
+   * @brief True if reads go through io_uring, false if through the thread pool.
+   */
+  bool usesIoUring() const { return ringFd >= 0; }
+
+ private:
+  /**
+   * Name of the file and the read only descriptor of it that reads use.
+   */
+  std::string fileName;
+  int fd;
+
+  /**
+   * Maximum number of reads in flight, and the number in flight now.
+   */
+  int queueDepth;
+  int inFlight;
+
+  /**
+   * Page number of the first read that failed, Page::INVALID_NUMBER if none did.
+   */
+  PageId failedPageNo;
+
+  /**
+   * io_uring instance, ringFd is -1 if the thread pool is used instead. The rings are shared
+   * with the kernel: sq* point into the submission ring, cq* into the completion ring.
+   */
+  int ringFd;
+  void* sqRing;
+  std::size_t sqRingSize;
+  void* cqRing;
+  std::size_t cqRingSize;
+  void* sqEntries;
+  std::size_t sqEntriesSize;
+  unsigned* sqHead;
+  unsigned* sqTail;
+  unsigned* sqMask;
+  unsigned* sqArray;
+  unsigned* cqHead;
+  unsigned* cqTail;
+  unsigned* cqMask;
+  void* cqes;
+
+  /**
+   * Set up io_uring with queueDepth entries. Returns false, leaving ringFd at -1, if the kernel
+   * does not allow it.
+   */
+  bool setupRing();
+
+  /**
+   * Reap completed io_uring reads, entering the kernel to wait for at least minComplete.
+   */
+  void reapRing(unsigned minComplete);
+
+  /**
+   * A queued read for the thread pool.
+   */
+  struct Request {
+    PageId pageNo;
+    Page* page;
+  };
+
+  /**
+   * Thread pool: workers take requests from the queue; done is signalled when inFlight drops.
+   */
+  std::vector<std::thread> workers;
+  std::deque<Request> requests;
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::condition_variable done;
+  bool stopping;
+
+  /**
+   * Body of each pool thread.
+   */
+  void work();
+};
+
+}
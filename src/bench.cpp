@@ -0,0 +1,1394 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "btree.h"
+#include "partitioned_index.h"
+#include "merge_join.h"
+#include "rid_bitmap.h"
+#include "heap_fetch.h"
+#include "page.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/insufficient_space_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+
+using namespace badgerdb;
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock benchClock;
+
+/**
+ * @brief Nanoseconds elapsed since start.
+ */
+static double elapsedNs(benchClock::time_point start)
+{
+	return std::chrono::duration<double, std::nano>(benchClock::now() - start).count();
+}
+
+/**
+ * @brief The p-th quantile (0..1) of sorted values, 0 if there are none.
+ */
+static double percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty()) return 0;
+	return sorted[(std::size_t) (p * (sorted.size() - 1))];
+}
+
+// -----------------------------------------------------------------------------
+// Node layouts
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Capacity of the node layouts at one page size: entries per leaf of each leaf format,
+ * fan-out of a non-leaf, and the height and page count of a tree of numKeys entries in plain
+ * leaves with every node filled to fill. Computed from IntNodeLayout alone, as a model: the index
+ * code runs only at Page::SIZE, the size of a buffer frame.
+ */
+template <std::size_t PAGE_SIZE>
+static void layoutCapacity(int numKeys, double fill)
+{
+	typedef IntNodeLayout<PAGE_SIZE> Layout;
+	long perLeaf = std::max(1, (int) (Layout::LEAFSIZE * fill));
+	long fanOut = std::max(2, (int) ((Layout::NONLEAFSIZE + 1) * fill));
+	long level = (numKeys + perLeaf - 1) / perLeaf;
+	long pages = level;
+	int height = 1;
+	do {
+		level = (level + fanOut - 1) / fanOut;
+		pages += level;
+		height++;
+	} while (level > 1);
+	std::cout << PAGE_SIZE << "," << Layout::LEAFSIZE << "," << Layout::COMPRESSEDLEAFSIZE << "," << Layout::POSTINGSLEAFSIZE << ","
+		<< Layout::NONLEAFSIZE + 1 << "," << height << "," << pages << std::endl;
+}
+
+/**
+ * @brief Lookup, scan and insert cost per entry of a BTreeIndex at Page::SIZE, over numKeys even
+ * keys inserted in random order into a buffer pool that holds the whole index: numOps single-key
+ * lookups, numOps / 100 scans of 1000 entries and numOps inserts of odd keys. Prints one CSV row
+ * per operation.
+ */
+static void layoutMeasured(int numKeys, int numOps)
+{
+	const std::string relationName = "bench_layout.rel";
+	std::vector<int> keys(numKeys);
+	for (int i = 0; i < numKeys; i++) keys[i] = 2 * i;
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+	std::mt19937 gen(7);
+	std::uniform_int_distribution<int> dist(0, numKeys - 1);
+	std::vector<int> probes(numOps);
+	for (int& p : probes) p = 2 * dist(gen);
+
+	BufMgr* bufMgr = new BufMgr(16384);
+	IndexOptions options;
+	options.buildFromRelation = false;
+	std::string indexName;
+	{
+		BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER, options);
+		RecordId rid;
+		rid.page_number = 1;
+		rid.slot_number = 1;
+		for (int key : keys) index.insertEntryInt(key, rid);
+		index.checkpoint();
+		int height = index.collectStats().height;
+
+		std::vector<int> key(1);
+		std::vector<std::vector<RecordId>> results;
+		long hits = 0;
+		benchClock::time_point start = benchClock::now();
+		for (int p : probes) {
+			key[0] = p;
+			index.lookupBatch(key, results);
+			hits += results[0].size();
+		}
+		double lookupNs = elapsedNs(start) / numOps;
+
+		std::vector<RecordId> rids(4096);
+		long scanned = 0;
+		start = benchClock::now();
+		for (int i = 0; i < numOps / 100; i++) {
+			int low = probes[i], high = probes[i] + 2000;
+			try {
+				index.startScan(&low, GTE, &high, LT);
+				while (true) scanned += index.scanNextBatch(rids.data(), rids.size());
+			} catch (const IndexScanCompletedException &) {
+				index.endScan();
+			}
+		}
+		double scanNs = elapsedNs(start) / std::max(1L, scanned);
+
+		start = benchClock::now();
+		for (int p : probes) index.insertEntryInt(p + 1, rid);
+		double insertNs = elapsedNs(start) / numOps;
+		IndexStats stats = index.collectStats();
+
+		std::cout << Page::SIZE << ",lookup," << lookupNs << "," << height << "," << hits << std::endl;
+		std::cout << Page::SIZE << ",scan," << scanNs << "," << height << "," << scanned << std::endl;
+		std::cout << Page::SIZE << ",insert," << insertNs << "," << stats.height << "," << stats.numLeafPages + stats.numNonLeafPages << std::endl;
+	}
+	File::remove(indexName);
+	delete bufMgr;
+}
+
+/**
+ * @brief Capacity of the node layouts at 4 to 32 KB pages, computed rather than measured since
+ * only the layouts are parameterized on the page size, then the measured cost of the index at
+ * Page::SIZE. Prints two CSV tables.
+ */
+static void benchLayout(int numKeys, int numOps)
+{
+	std::cout << "model_page_size,leaf_entries,compressed_leaf_max,postings_leaf_max,fan_out,model_height,model_pages" << std::endl;
+	layoutCapacity<4096>(numKeys, 0.67);
+	layoutCapacity<8192>(numKeys, 0.67);
+	layoutCapacity<16384>(numKeys, 0.67);
+	layoutCapacity<32768>(numKeys, 0.67);
+	std::cout << std::endl << "page_size,op,ns_per_entry,height,count" << std::endl;
+	layoutMeasured(numKeys, numOps);
+}
+
+// -----------------------------------------------------------------------------
+// Split policy
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Write a relation whose records are the given int keys, in the given order, each padded
+ * to recordSize bytes.
+ */
+static void createKeyRelation(const std::string& relationName, const std::vector<int>& keys,
+		std::size_t recordSize = sizeof(int))
+{
+	try {
+		File::remove(relationName);
+	} catch (const FileNotFoundException &) {
+	}
+	PageFile file = PageFile::create(relationName);
+	PageId pageNo;
+	Page page = file.allocatePage(pageNo);
+	for (int key : keys) {
+		std::string record(reinterpret_cast<const char*>(&key), sizeof(key));
+		record.resize(std::max(recordSize, sizeof(key)), ' ');
+		try {
+			page.insertRecord(record);
+		} catch (const InsufficientSpaceException &) {
+			file.writePage(pageNo, page);
+			page = file.allocatePage(pageNo);
+			page.insertRecord(record);
+		}
+	}
+	file.writePage(pageNo, page);
+}
+
+/**
+ * @brief Build indexes over forward, backward and random ingest orders with fill factor 50 (the
+ * classic split in the middle) and 100, and print their space utilization as CSV rows.
+ */
+static void benchSplit(int numKeys)
+{
+	const std::string relationName = "bench_split.rel";
+	BufMgr* bufMgr = new BufMgr(1000);
+	std::vector<int> keys(numKeys);
+	for (int i = 0; i < numKeys; i++) keys[i] = i;
+
+	std::cout << "order,leaf_format,fill_factor,build_ns_per_entry,height,nonleaf_pages,leaf_pages,entries,avg_leaf_fill" << std::endl;
+	const char* orders[] = { "forward", "backward", "random" };
+	for (const char* order : orders) {
+		if (std::string(order) == "backward") std::reverse(keys.begin(), keys.end());
+		if (std::string(order) == "random") std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+		createKeyRelation(relationName, keys);
+
+		const char* formatNames[] = { "plain", "compressed", "postings" };
+		LeafFormat formats[] = { LEAF_PLAIN, LEAF_COMPRESSED, LEAF_POSTINGS };
+		for (LeafFormat format : formats) {
+			for (int fillFactor : { 50, 100 }) {
+				IndexOptions options;
+				options.leafFormat = format;
+				options.fillFactor = fillFactor;
+				std::string indexName;
+				benchClock::time_point start = benchClock::now();
+				{
+					BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER, options);
+					double buildNs = elapsedNs(start) / numKeys;
+					IndexStats stats = index.collectStats();
+					std::cout << order << "," << formatNames[format] << "," << fillFactor << "," << buildNs << "," << stats.height << ","
+						<< stats.numNonLeafPages << "," << stats.numLeafPages << "," << stats.numEntries << "," << stats.avgLeafFill << std::endl;
+				}
+				File::remove(indexName);
+			}
+		}
+	}
+	File::remove(relationName);
+	delete bufMgr;
+}
+
+// -----------------------------------------------------------------------------
+// Insert hint
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Build indexes over forward and backward ingest orders with and without the insert
+ * hint, and print build time and buffer pool accesses per entry as CSV rows.
+ */
+static void benchHint(int numKeys)
+{
+	const std::string relationName = "bench_hint.rel";
+	BufMgr* bufMgr = new BufMgr(1000);
+	std::vector<int> keys(numKeys);
+	for (int i = 0; i < numKeys; i++) keys[i] = i;
+
+	std::cout << "order,leaf_format,insert_hint,build_ns_per_entry,accesses_per_entry,height" << std::endl;
+	const char* orders[] = { "forward", "backward" };
+	for (const char* order : orders) {
+		if (std::string(order) == "backward") std::reverse(keys.begin(), keys.end());
+		createKeyRelation(relationName, keys);
+
+		const char* formatNames[] = { "plain", "compressed", "postings" };
+		LeafFormat formats[] = { LEAF_PLAIN, LEAF_COMPRESSED, LEAF_POSTINGS };
+		for (LeafFormat format : formats) {
+			for (bool insertHint : { false, true }) {
+				IndexOptions options;
+				options.leafFormat = format;
+				options.insertHint = insertHint;
+				std::string indexName;
+				bufMgr->clearBufStats();
+				benchClock::time_point start = benchClock::now();
+				{
+					BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER, options);
+					double buildNs = elapsedNs(start) / numKeys;
+					double accesses = (double) bufMgr->getBufStats().accesses / numKeys;
+					std::cout << order << "," << formatNames[format] << "," << insertHint << "," << buildNs << ","
+						<< accesses << "," << index.collectStats().height << std::endl;
+				}
+				File::remove(indexName);
+			}
+		}
+	}
+	File::remove(relationName);
+	delete bufMgr;
+}
+
+// -----------------------------------------------------------------------------
+// Suite
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Keys of a relation of numKeys records in the named distribution, in insertion order:
+ * sequential (0 .. numKeys-1 ascending, as createRelationForward), reverse (descending, as
+ * createRelationBackward), uniform (a random permutation, as createRelationRandom), zipfian
+ * (ranks drawn with exponent 0.99, so key 0 is the most frequent) or duplicates (numKeys / 100
+ * distinct keys in random order).
+ */
+static std::vector<int> generateKeys(const std::string& distribution, int numKeys, std::mt19937& gen)
+{
+	std::vector<int> keys(numKeys);
+	for (int i = 0; i < numKeys; i++) keys[i] = i;
+	if (distribution == "reverse") {
+		std::reverse(keys.begin(), keys.end());
+	} else if (distribution == "uniform") {
+		std::shuffle(keys.begin(), keys.end(), gen);
+	} else if (distribution == "zipfian") {
+		std::vector<double> cdf(numKeys);
+		double sum = 0;
+		for (int i = 0; i < numKeys; i++) cdf[i] = sum += 1 / std::pow(i + 1.0, 0.99);
+		std::uniform_real_distribution<double> dist(0, sum);
+		for (int& key : keys) key = std::lower_bound(cdf.begin(), cdf.end(), dist(gen)) - cdf.begin();
+	} else if (distribution == "duplicates") {
+		std::uniform_int_distribution<int> dist(0, std::max(1, numKeys / 100) - 1);
+		for (int& key : keys) key = dist(gen);
+	}
+	return keys;
+}
+
+/**
+ * @brief Run scans [low, low + width) and record the latency of each, from startScan() until all
+ * of its rids are read, in latencies. Returns the number of rids read.
+ */
+static long timeScans(BTreeIndex& index, const std::vector<int>& lows, int width, std::vector<double>& latencies)
+{
+	std::vector<RecordId> rids(1000);
+	long found = 0;
+	for (int low : lows) {
+		int high = low + width;
+		benchClock::time_point start = benchClock::now();
+		try {
+			index.startScan(&low, GTE, &high, LT);
+			while (true) found += index.scanNextBatch(rids.data(), rids.size());
+		} catch (const NoSuchKeyFoundException &) {
+		} catch (const IndexScanCompletedException &) {
+			index.endScan();
+		}
+		latencies.push_back(elapsedNs(start));
+	}
+	return found;
+}
+
+/**
+ * @brief Print one CSV row of the suite: count rids found over numOps operations, whose latencies
+ * are given, and the counters of the index over these operations.
+ */
+static void suiteRow(const std::string& distribution, const char* leafFormat, int frames, const char* op, double selectivity,
+		long count, long numOps, std::vector<double>& latencies, const IndexCounters& counters)
+{
+	std::sort(latencies.begin(), latencies.end());
+	double sum = 0;
+	for (double l : latencies) sum += l;
+	double ops = std::max(1L, numOps);
+	std::cout << distribution << "," << leafFormat << "," << frames << "," << op << "," << selectivity << "," << count << ","
+		<< sum / std::max<std::size_t>(1, latencies.size()) << "," << percentile(latencies, 0.5) << "," << percentile(latencies, 0.9) << ","
+		<< percentile(latencies, 0.99) << "," << (latencies.empty() ? 0 : latencies.back()) << ","
+		<< counters.pins / ops << "," << counters.bufferMisses / ops << std::endl;
+}
+
+/**
+ * @brief For each key distribution and buffer pool size: build an index and time the build, then
+ * point lookups and range scans over several selectivities. Prints one CSV row per operation with
+ * latency percentiles in ns, and index page pins and buffer misses per operation.
+ */
+static void benchSuite(int numKeys, int numOps, LeafFormat leafFormat)
+{
+	const std::string relationName = "bench_suite.rel";
+	const char* formatNames[] = { "plain", "compressed", "postings" };
+	const char* distributions[] = { "sequential", "reverse", "uniform", "zipfian", "duplicates" };
+	const int frameCounts[] = { 100, 1000, 10000 };
+	const double selectivities[] = { 0.0001, 0.001, 0.01, 0.1 };
+
+	std::cout << "distribution,leaf_format,buffer_frames,op,selectivity,count,mean_ns,p50_ns,p90_ns,p99_ns,max_ns,"
+		"pins_per_op,misses_per_op" << std::endl;
+	for (const char* distribution : distributions) {
+		std::mt19937 gen(42);
+		std::vector<int> keys = generateKeys(distribution, numKeys, gen);
+		createKeyRelation(relationName, keys);
+		int minKey = *std::min_element(keys.begin(), keys.end());
+		int maxKey = *std::max_element(keys.begin(), keys.end());
+
+		std::vector<int> lookups(numOps);
+		std::uniform_int_distribution<int> pick(0, numKeys - 1);
+		for (int& key : lookups) key = keys[pick(gen)];
+		std::vector<int> lows(std::max(1, numOps / 100));
+		std::uniform_int_distribution<int> lowDist(minKey, maxKey);
+		for (int& low : lows) low = lowDist(gen);
+
+		for (int frames : frameCounts) {
+			BufMgr* bufMgr = new BufMgr(frames);
+			IndexOptions options;
+			options.leafFormat = leafFormat;
+			std::string indexName;
+			{
+				benchClock::time_point start = benchClock::now();
+				BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER, options);
+				std::vector<double> build(1, elapsedNs(start) / numKeys); // per entry: the build is one insert per record
+				suiteRow(distribution, formatNames[leafFormat], frames, "build", 1, numKeys, numKeys, build, index.getCounters());
+
+				std::vector<double> latencies;
+				index.resetCounters();
+				long found = timeScans(index, lookups, 1, latencies);
+				suiteRow(distribution, formatNames[leafFormat], frames, "lookup", 0, found, lookups.size(), latencies, index.getCounters());
+
+				for (double selectivity : selectivities) {
+					int width = std::max(1, (int) (selectivity * ((double) maxKey - minKey + 1)));
+					latencies.clear();
+					index.resetCounters();
+					found = timeScans(index, lows, width, latencies);
+					suiteRow(distribution, formatNames[leafFormat], frames, "scan", selectivity, found, lows.size(), latencies, index.getCounters());
+				}
+			}
+			File::remove(indexName);
+			delete bufMgr;
+		}
+	}
+	File::remove(relationName);
+}
+
+// -----------------------------------------------------------------------------
+// Scan ring
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Mixed workload of point lookups on a hot key range (the lowest 5% of keys) and big range
+ * scans (10% of the keys each) elsewhere, on a buffer pool smaller than the index, with and without
+ * the scan ring. Prints the buffer pool hit rate of the lookups and of everything as CSV rows.
+ */
+static void benchScanRing(int numKeys, int numOps)
+{
+	const std::string relationName = "bench_ring.rel";
+	std::vector<int> keys(numKeys);
+	for (int i = 0; i < numKeys; i++) keys[i] = i;
+	createKeyRelation(relationName, keys);
+
+	std::cout << "scan_ring,lookups,scans,lookup_hit_rate,lookup_misses_per_op,total_hit_rate,ring_reads" << std::endl;
+	for (bool scanRing : { false, true }) {
+		BufMgr* bufMgr = new BufMgr(200);
+		IndexOptions options;
+		options.scanRing = scanRing;
+		std::string indexName;
+		{
+			BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER, options);
+			std::mt19937 gen(42);
+			std::uniform_int_distribution<int> hot(0, numKeys / 20 - 1);
+			std::uniform_int_distribution<int> cold(numKeys / 10, numKeys - numKeys / 10);
+			std::vector<RecordId> rids(1000);
+			long lookupAccesses = 0, lookupMisses = 0;
+			int lookups = 0, scans = 0;
+			bufMgr->clearBufStats();
+			index.resetCounters();
+
+			for (int op = 0; op < numOps; op++) {
+				bool scan = op % 100 == 99;
+				int low = scan ? cold(gen) : hot(gen);
+				int high = scan ? low + numKeys / 10 : low;
+				int accesses = bufMgr->getBufStats().accesses;
+				int misses = bufMgr->getBufStats().diskreads;
+				try {
+					index.startScan(&low, GTE, &high, LTE);
+					while (true) index.scanNextBatch(rids.data(), rids.size());
+				} catch (const NoSuchKeyFoundException &) {
+				} catch (const IndexScanCompletedException &) {
+					index.endScan();
+				}
+				if (scan) {
+					scans++;
+				} else {
+					lookups++;
+					lookupAccesses += bufMgr->getBufStats().accesses - accesses;
+					lookupMisses += bufMgr->getBufStats().diskreads - misses;
+				}
+			}
+			BufStats& total = bufMgr->getBufStats();
+			std::cout << scanRing << "," << lookups << "," << scans << ","
+				<< 1 - (double) lookupMisses / std::max(1L, lookupAccesses) << ","
+				<< (double) lookupMisses / std::max(1, lookups) << ","
+				<< 1 - (double) total.diskreads / std::max(1, total.accesses) << ","
+				<< index.getCounters().scanRingReads << std::endl;
+		}
+		File::remove(indexName);
+		delete bufMgr;
+	}
+	File::remove(relationName);
+}
+
+/**
+ * @brief Drop the pages of fileName from the operating system page cache, so that the next reads
+ * of it go to the device.
+ */
+static void evictFromOsCache(const std::string& fileName)
+{
+	int fd = open(fileName.c_str(), O_RDONLY);
+	if (fd < 0) return;
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+}
+
+/**
+ * @brief Point lookups and range scans on a cold cache, one at a time through the buffer pool
+ * against lookupBatch() and scanAsync(). The index file is dropped from the OS page cache before
+ * every run and the buffer pool is too small to hold the tree. Prints one CSV row per run.
+ */
+static void benchAsync(int numKeys, int numOps)
+{
+	const std::string relationName = "bench_async.rel";
+	std::mt19937 gen(42);
+	createKeyRelation(relationName, generateKeys("uniform", numKeys, gen));
+
+	BufMgr* bufMgr = new BufMgr(64);
+	std::string indexName;
+	{
+		BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER);
+		std::uniform_int_distribution<int> dist(0, numKeys - 1);
+		std::vector<int> keys(numOps);
+		for (int& key : keys) key = dist(gen);
+		int numScans = std::max(1, numOps / 100);
+		int width = std::max(1, numKeys / 100);
+		std::vector<RecordId> rids(1000);
+
+		std::cout << "op,engine,ops,found,total_ms,us_per_op,async_reads" << std::endl;
+		for (bool async : { false, true }) {
+			evictFromOsCache(indexName);
+			index.resetCounters();
+			long found = 0;
+			benchClock::time_point start = benchClock::now();
+			if (async) {
+				std::vector<std::vector<RecordId>> results;
+				for (int first = 0; first < numOps; first += 1024) {
+					std::vector<int> batch(keys.begin() + first, keys.begin() + std::min(numOps, first + 1024));
+					index.lookupBatch(batch, results);
+					for (const std::vector<RecordId>& result : results) found += result.size();
+				}
+			} else {
+				for (int key : keys) {
+					try {
+						index.startScan(&key, GTE, &key, LTE);
+						while (true) found += index.scanNextBatch(rids.data(), rids.size());
+					} catch (const NoSuchKeyFoundException &) {
+					} catch (const IndexScanCompletedException &) {
+						index.endScan();
+					}
+				}
+			}
+			double ms = elapsedNs(start) / 1e6;
+			std::cout << "lookup," << (async ? (index.asyncUsesIoUring() ? "io_uring" : "threads") : "sync") << ","
+				<< numOps << "," << found << "," << ms << "," << ms * 1000 / numOps << ","
+				<< index.getCounters().asyncReads << std::endl;
+		}
+
+		std::vector<int> lows(numScans);
+		for (int& low : lows) low = dist(gen);
+		for (bool async : { false, true }) {
+			evictFromOsCache(indexName);
+			index.resetCounters();
+			long found = 0;
+			benchClock::time_point start = benchClock::now();
+			if (async) {
+				std::vector<RecordId> scanRids;
+				for (int low : lows) {
+					int high = low + width;
+					scanRids.clear();
+					found += index.scanAsync(&low, GTE, &high, LT, scanRids);
+				}
+			} else {
+				std::vector<double> latencies;
+				found = timeScans(index, lows, width, latencies);
+			}
+			double ms = elapsedNs(start) / 1e6;
+			std::cout << "scan," << (async ? (index.asyncUsesIoUring() ? "io_uring" : "threads") : "sync") << ","
+				<< numScans << "," << found << "," << ms << "," << ms * 1000 / numScans << ","
+				<< index.getCounters().asyncReads << std::endl;
+		}
+	}
+	File::remove(indexName);
+	delete bufMgr;
+	File::remove(relationName);
+}
+
+/**
+ * @brief Point lookups one after another, each a descent by startScan(), against probeInterleaved()
+ * with several group sizes. First in memory, with a warm buffer pool that holds the whole index,
+ * then out of core, with a 64 frame pool and the index file dropped from the OS page cache before
+ * every run. Prints one CSV row per run.
+ */
+static void benchProbe(int numKeys, int numOps)
+{
+	const std::string relationName = "bench_probe.rel";
+	std::mt19937 gen(42);
+	createKeyRelation(relationName, generateKeys("uniform", numKeys, gen));
+	std::uniform_int_distribution<int> dist(0, numKeys - 1);
+	std::vector<int> keys(numOps);
+	for (int& key : keys) key = dist(gen);
+
+	std::cout << "cache,engine,group,ops,found,total_ms,ns_per_op" << std::endl;
+	for (bool inMemory : { true, false }) {
+		BufMgr* bufMgr = new BufMgr(inMemory ? 8192 : 64);
+		std::string indexName;
+		{
+			BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER);
+			std::vector<RecordId> rids(1000);
+			std::vector<std::vector<RecordId>> results;
+			if (inMemory) index.probeInterleaved(keys, results, PROBE_BUFFER_POOL, 1);
+
+			for (int group : { 0, 1, 4, 8, 16, 32, 64 }) {
+				if (!inMemory) evictFromOsCache(indexName);
+				long found = 0;
+				benchClock::time_point start = benchClock::now();
+				if (group == 0) {
+					for (int key : keys) {
+						try {
+							index.startScan(&key, GTE, &key, LTE);
+							while (true) found += index.scanNextBatch(rids.data(), rids.size());
+						} catch (const NoSuchKeyFoundException &) {
+						} catch (const IndexScanCompletedException &) {
+							index.endScan();
+						}
+					}
+				} else {
+					index.probeInterleaved(keys, results, inMemory ? PROBE_BUFFER_POOL : PROBE_FILE, group);
+					for (const std::vector<RecordId>& result : results) found += result.size();
+				}
+				double ns = elapsedNs(start);
+				std::cout << (inMemory ? "memory" : "cold") << "," << (group == 0 ? "sequential" : "interleaved") << ","
+					<< group << "," << numOps << "," << found << "," << ns / 1e6 << "," << ns / numOps << std::endl;
+			}
+		}
+		File::remove(indexName);
+		delete bufMgr;
+	}
+	File::remove(relationName);
+}
+
+/**
+ * @brief Build time of a range-partitioned index over uniform keys with 1 to 8 equal partitions,
+ * each with its own buffer manager so that they build in parallel, and the time of scans over
+ * 1% of the keys. Prints one CSV row per partition count.
+ */
+static void benchPartition(int numKeys, int numOps)
+{
+	const std::string relationName = "bench_part.rel";
+	std::mt19937 gen(42);
+	createKeyRelation(relationName, generateKeys("uniform", numKeys, gen));
+	std::uniform_int_distribution<int> dist(0, numKeys - 1);
+	int numScans = std::max(1, numOps / 100);
+	int width = std::max(1, numKeys / 100);
+
+	std::cout << "partitions,build_ms,scans,found,scan_ms" << std::endl;
+	for (int numParts : { 1, 2, 4, 8 }) {
+		std::vector<int> splitKeys;
+		for (int i = 1; i < numParts; i++) splitKeys.push_back((std::int64_t) numKeys * i / numParts);
+		std::vector<BufMgr*> bufMgrs;
+		for (int i = 0; i < numParts; i++) bufMgrs.push_back(new BufMgr(std::max(64, 4096 / numParts)));
+		std::vector<std::string> indexNames;
+		{
+			benchClock::time_point start = benchClock::now();
+			PartitionedIndex index(relationName, indexNames, bufMgrs, 0, INTEGER, splitKeys);
+			double buildMs = elapsedNs(start) / 1e6;
+
+			std::vector<RecordId> rids(1000);
+			long found = 0;
+			start = benchClock::now();
+			for (int s = 0; s < numScans; s++) {
+				int low = dist(gen), high = low + width;
+				try {
+					index.startScan(&low, GTE, &high, LT);
+					while (true) found += index.scanNextBatch(rids.data(), rids.size());
+				} catch (const NoSuchKeyFoundException &) {
+				} catch (const IndexScanCompletedException &) {
+					index.endScan();
+				}
+			}
+			std::cout << numParts << "," << buildMs << "," << numScans << "," << found << "," << elapsedNs(start) / 1e6 << std::endl;
+		}
+		for (const std::string& indexName : indexNames) File::remove(indexName);
+		for (BufMgr* bufMgr : bufMgrs) delete bufMgr;
+	}
+	File::remove(relationName);
+}
+
+/**
+ * @brief Lookup throughput of lookupOptimistic() against the latch coupling of lookupLatched()
+ * with 1 to 64 reader threads, each doing numOps lookups of uniform keys, on their own and
+ * with a writer thread inserting new keys meanwhile. The buffer pool holds the whole index.
+ * Prints one CSV row per run.
+ */
+static void benchOlc(int numKeys, int numOps)
+{
+	const std::string relationName = "bench_olc.rel";
+	std::mt19937 gen(42);
+	createKeyRelation(relationName, generateKeys("uniform", numKeys, gen));
+	BufMgr* bufMgr = new BufMgr(16384);
+	std::string indexName;
+	{
+		IndexOptions options;
+		options.optimisticReads = true;
+		BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER, options);
+		RecordId rid;
+		rid.page_number = 1;
+		rid.slot_number = 1;
+		int nextKey = numKeys;
+
+		std::cout << "engine,threads,writer,lookups,found,inserts,total_ms,mops_per_s" << std::endl;
+		for (int numThreads : { 1, 2, 4, 8, 16, 32, 64 }) {
+			for (bool writer : { false, true }) {
+				for (bool optimistic : { true, false }) {
+					std::atomic<long> found(0);
+					std::atomic<int> running(numThreads);
+					std::vector<std::thread> threads;
+					benchClock::time_point start = benchClock::now();
+					for (int t = 0; t < numThreads; t++) {
+						threads.push_back(std::thread([&, t]() {
+							std::mt19937 threadGen(t);
+							std::uniform_int_distribution<int> dist(0, numKeys - 1);
+							std::vector<RecordId> rids;
+							long threadFound = 0;
+							for (int i = 0; i < numOps; i++) {
+								rids.clear();
+								if (optimistic) index.lookupOptimistic(dist(threadGen), rids);
+								else index.lookupLatched(dist(threadGen), rids);
+								threadFound += rids.size();
+							}
+							found += threadFound;
+							running--;
+						}));
+					}
+					int inserts = 0;
+					for (; writer && running.load() > 0 && inserts < numOps; inserts++)
+						index.insertEntryInt(nextKey++, rid);
+					for (std::thread& thread : threads) thread.join();
+					double ns = elapsedNs(start);
+					long lookups = (long) numThreads * numOps;
+					std::cout << (optimistic ? "optimistic" : "latched") << "," << numThreads << "," << writer << ","
+						<< lookups << "," << found.load() << "," << inserts << "," << ns / 1e6 << "," << lookups * 1e3 / ns << std::endl;
+				}
+			}
+		}
+	}
+	File::remove(indexName);
+	delete bufMgr;
+	File::remove(relationName);
+}
+
+/**
+ * @brief Insert throughput of numKeys keys in random and in ascending order into an empty index,
+ * with no delta and with deltas of 1024 to 65536 entries, in a buffer pool that holds the whole
+ * index and in one of 64 frames. Prints one CSV row per run.
+ */
+static void benchDelta(int numKeys)
+{
+	const std::string relationName = "bench_delta.rel";
+	std::vector<int> sequential(numKeys);
+	for (int i = 0; i < numKeys; i++) sequential[i] = i;
+	std::vector<int> random = sequential;
+	std::shuffle(random.begin(), random.end(), std::mt19937(42));
+
+	std::cout << "order,frames,delta_entries,ns_per_insert,merges,buffer_misses" << std::endl;
+	for (int frames : { 16384, 64 }) {
+		for (const char* order : { "random", "sequential" }) {
+			const std::vector<int>& keys = std::string(order) == "random" ? random : sequential;
+			for (int deltaEntries : { 0, 1024, 16384, 65536 }) {
+				BufMgr* bufMgr = new BufMgr(frames);
+				IndexOptions options;
+				options.buildFromRelation = false;
+				options.deltaEntries = deltaEntries;
+				std::string indexName;
+				{
+					BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER, options);
+					RecordId rid;
+					rid.page_number = 1;
+					rid.slot_number = 1;
+					benchClock::time_point start = benchClock::now();
+					for (int key : keys) index.insertEntryInt(key, rid);
+					index.mergeDelta();
+					double ns = elapsedNs(start);
+					IndexCounters counters = index.getCounters();
+					std::cout << order << "," << frames << "," << deltaEntries << "," << ns / numKeys << ","
+						<< counters.deltaMerges << "," << counters.bufferMisses << std::endl;
+				}
+				File::remove(indexName);
+				delete bufMgr;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Insert throughput of numKeys keys in random order into an empty index with plain and
+ * with buffered non-leaf nodes, in a buffer pool that holds the whole index and in one of 64
+ * frames. The checkpoint that follows applies the inserts still buffered. Prints one CSV row per run.
+ */
+static void benchBuffered(int numKeys)
+{
+	const std::string relationName = "bench_buffered.rel";
+	std::vector<int> keys(numKeys);
+	for (int i = 0; i < numKeys; i++) keys[i] = i;
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+
+	std::cout << "nonleaf_format,frames,ns_per_insert,checkpoint_ms,buffer_misses,height,leaf_pages" << std::endl;
+	for (int frames : { 16384, 64 }) {
+		const char* formatNames[] = { "plain", "summary", "buffered" };
+		for (NonLeafFormat format : { NONLEAF_PLAIN, NONLEAF_BUFFERED }) {
+			BufMgr* bufMgr = new BufMgr(frames);
+			IndexOptions options;
+			options.buildFromRelation = false;
+			options.nonLeafFormat = format;
+			std::string indexName;
+			{
+				BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER, options);
+				RecordId rid;
+				rid.page_number = 1;
+				rid.slot_number = 1;
+				benchClock::time_point start = benchClock::now();
+				for (int key : keys) index.insertEntryInt(key, rid);
+				double insertNs = elapsedNs(start);
+				start = benchClock::now();
+				index.checkpoint();
+				double checkpointNs = elapsedNs(start);
+				IndexStats stats = index.collectStats();
+				std::cout << formatNames[format] << "," << frames << "," << insertNs / numKeys << "," << checkpointNs / 1e6 << ","
+					<< index.getCounters().bufferMisses << "," << stats.height << "," << stats.numLeafPages << std::endl;
+			}
+			File::remove(indexName);
+			delete bufMgr;
+		}
+	}
+}
+
+/**
+ * @brief Join of an index of numKeys keys with one of every stride-th key, as a merge join that
+ * skips ahead with scanSkipTo() and as a hash join over full scans of both; then the intersection
+ * and union of the rid sets of the two, with the galloping merge and with a hash set. Prints one
+ * CSV row per run.
+ */
+static void benchJoin(int numKeys)
+{
+	const std::string relationName = "bench_join.rel";
+	std::cout << "stride,operator,ms,results,leaf_reads,skip_descents" << std::endl;
+	for (int stride : { 1, 16, 1024 }) {
+		BufMgr* bufMgr = new BufMgr(16384);
+		IndexOptions options;
+		options.buildFromRelation = false;
+		std::string leftName, rightName;
+		{
+			// rids name their key, so that both indexes hold the same rid for a key
+			BTreeIndex left(relationName, leftName, bufMgr, 0, INTEGER, options);
+			BTreeIndex right(relationName, rightName, bufMgr, sizeof(int), INTEGER, options);
+			for (int key = 0; key < numKeys; key++) {
+				RecordId rid;
+				rid.page_number = key / 100 + 1;
+				rid.slot_number = key % 100 + 1;
+				left.insertEntryInt(key, rid);
+				if (key % stride == 0) right.insertEntryInt(key, rid);
+			}
+			ScanRange all = { 0, GTE, numKeys, LT };
+
+			auto report = [&](const char* op, benchClock::time_point start, long results) {
+				double ns = elapsedNs(start);
+				IndexCounters l = left.getCounters(), r = right.getCounters();
+				std::cout << stride << "," << op << "," << ns / 1e6 << "," << results << ","
+					<< l.siblingHops + r.siblingHops + l.skipDescents + r.skipDescents << ","
+					<< l.skipDescents + r.skipDescents << std::endl;
+				left.resetCounters();
+				right.resetCounters();
+			};
+
+			left.resetCounters();
+			right.resetCounters();
+			benchClock::time_point start = benchClock::now();
+			long pairs = 0;
+			{
+				MergeJoin join(left, right, all);
+				RecordId l, r;
+				while (join.next(l, r)) pairs++;
+			}
+			report("merge_join", start, pairs);
+
+			start = benchClock::now();
+			pairs = 0;
+			{
+				std::unordered_multimap<int, RecordId> built;
+				int key;
+				RecordId rid;
+				right.startScan(&all.lowVal, all.lowOp, &all.highVal, all.highOp);
+				try {
+					while (true) {
+						right.scanNextEntry(key, rid);
+						built.emplace(key, rid);
+					}
+				} catch (const IndexScanCompletedException &) {
+				}
+				right.endScan();
+				left.startScan(&all.lowVal, all.lowOp, &all.highVal, all.highOp);
+				try {
+					while (true) {
+						left.scanNextEntry(key, rid);
+						pairs += built.count(key);
+					}
+				} catch (const IndexScanCompletedException &) {
+				}
+				left.endScan();
+			}
+			report("hash_join", start, pairs);
+
+			start = benchClock::now();
+			std::vector<RecordId> leftRids, rightRids, result;
+			scanRangeRids(left, all, leftRids);
+			scanRangeRids(right, all, rightRids);
+			intersectRids(leftRids, rightRids, result);
+			report("gallop_intersect", start, result.size());
+
+			start = benchClock::now();
+			scanRangeRids(left, all, leftRids);
+			scanRangeRids(right, all, rightRids);
+			unionRids(leftRids, rightRids, result);
+			report("merge_union", start, result.size());
+
+			start = benchClock::now();
+			long common = 0;
+			{
+				scanRangeRids(left, all, leftRids);
+				scanRangeRids(right, all, rightRids);
+				std::unordered_set<long> built;
+				for (const RecordId& rid : rightRids) built.insert((long) rid.page_number << 16 | rid.slot_number);
+				for (const RecordId& rid : leftRids) common += built.count((long) rid.page_number << 16 | rid.slot_number);
+			}
+			report("hash_intersect", start, common);
+		}
+		File::remove(leftName);
+		File::remove(rightName);
+		delete bufMgr;
+	}
+}
+
+/**
+ * @brief IN lists of 10 to 100000 random keys, half of them missing, over an index of numKeys
+ * keys: one startScan()/endScan() cycle per key against one startInListScan() cursor. Prints
+ * one CSV row per run.
+ */
+static void benchInList(int numKeys)
+{
+	const std::string relationName = "bench_inlist.rel";
+	BufMgr* bufMgr = new BufMgr(16384);
+	IndexOptions options;
+	options.buildFromRelation = false;
+	std::string indexName;
+	{
+		BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER, options);
+		// even keys only, so that odd keys in the lists miss
+		for (int key = 0; key < numKeys; key++) {
+			RecordId rid;
+			rid.page_number = key / 100 + 1;
+			rid.slot_number = key % 100 + 1;
+			index.insertEntryInt(key * 2, rid);
+		}
+		std::mt19937 gen(42);
+		std::cout << "list_size,method,ms,results,descents,sibling_hops" << std::endl;
+		for (int listSize : { 10, 1000, 100000 }) {
+			std::vector<int> keys(listSize);
+			for (int& key : keys) key = gen() % (2 * numKeys);
+			// an IN list returns the entries of a repeated key once
+			std::sort(keys.begin(), keys.end());
+			keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+			std::shuffle(keys.begin(), keys.end(), gen);
+			RecordId rids[256];
+			for (const char* method : { "scan_per_key", "in_list" }) {
+				index.resetCounters();
+				benchClock::time_point start = benchClock::now();
+				long results = 0;
+				if (std::string(method) == "in_list") {
+					try {
+						index.startInListScan(keys);
+						while (true) results += index.scanNextBatch(rids, 256);
+					} catch (const IndexScanCompletedException &) {
+					}
+					index.endScan();
+				} else {
+					for (int key : keys) {
+						try {
+							index.startScan(&key, GTE, &key, LTE);
+						} catch (const NoSuchKeyFoundException &) {
+							continue;
+						}
+						try {
+							while (true) results += index.scanNextBatch(rids, 256);
+						} catch (const IndexScanCompletedException &) {
+						}
+						index.endScan();
+					}
+				}
+				double ns = elapsedNs(start);
+				IndexCounters counters = index.getCounters();
+				std::cout << listSize << "," << method << "," << ns / 1e6 << "," << results << ","
+					<< counters.descents << "," << counters.siblingHops << std::endl;
+			}
+		}
+	}
+	File::remove(indexName);
+	delete bufMgr;
+}
+
+/**
+ * @brief Scans of 1% to 50% of an index of numKeys keys whose rids are spread at random over the
+ * heap pages, into a rid vector sorted by hand and into a RidBitmap, and the AND and OR of two
+ * overlapping such scans with intersectRids()/unionRids() and with bitmaps. Prints one CSV row per
+ * run; bytes is the size of the result.
+ */
+static void benchBitmap(int numKeys)
+{
+	const std::string relationName = "bench_bitmap.rel";
+	BufMgr* bufMgr = new BufMgr(16384);
+	IndexOptions options;
+	options.buildFromRelation = false;
+	std::string indexName;
+	{
+		BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER, options);
+		std::vector<int> positions(numKeys);
+		for (int i = 0; i < numKeys; i++) positions[i] = i;
+		std::shuffle(positions.begin(), positions.end(), std::mt19937(42));
+		for (int key = 0; key < numKeys; key++) {
+			RecordId rid;
+			rid.page_number = positions[key] / 100 + 1;
+			rid.slot_number = positions[key] % 100 + 1;
+			index.insertEntryInt(key, rid);
+		}
+
+		std::cout << "selectivity,method,ms,results,bytes" << std::endl;
+		for (double selectivity : { 0.01, 0.1, 0.5 }) {
+			int width = numKeys * selectivity;
+			// the second range overlaps the second half of the first
+			ScanRange first = { 0, GTE, width, LT };
+			ScanRange second = { width / 2, GTE, width / 2 + width, LT };
+
+			benchClock::time_point start = benchClock::now();
+			std::vector<RecordId> rids;
+			scanRangeRids(index, first, rids);
+			std::sort(rids.begin(), rids.end(), ridLess);
+			std::cout << selectivity << ",sorted_rids," << elapsedNs(start) / 1e6 << "," << rids.size() << ","
+				<< rids.size() * sizeof(RecordId) << std::endl;
+
+			start = benchClock::now();
+			RidBitmap bitmap;
+			scanBitmap(index, first, bitmap);
+			std::cout << selectivity << ",bitmap," << elapsedNs(start) / 1e6 << "," << bitmap.cardinality() << ","
+				<< bitmap.sizeInBytes() << std::endl;
+
+			std::vector<RecordId> otherRids, result;
+			scanRangeRids(index, second, otherRids);
+			RidBitmap other;
+			scanBitmap(index, second, other);
+			for (const char* op : { "and", "or" }) {
+				bool isAnd = std::string(op) == "and";
+				start = benchClock::now();
+				if (isAnd)
+					intersectRids(rids, otherRids, result);
+				else
+					unionRids(rids, otherRids, result);
+				std::cout << selectivity << ",rids_" << op << "," << elapsedNs(start) / 1e6 << "," << result.size() << ","
+					<< result.size() * sizeof(RecordId) << std::endl;
+				start = benchClock::now();
+				RidBitmap combined = isAnd ? bitmapAnd(bitmap, other) : bitmapOr(bitmap, other);
+				std::cout << selectivity << ",bitmap_" << op << "," << elapsedNs(start) / 1e6 << "," << combined.cardinality() << ","
+					<< combined.sizeInBytes() << std::endl;
+			}
+		}
+	}
+	File::remove(indexName);
+	delete bufMgr;
+}
+
+/**
+ * @brief Scans of 0.1% to 10% of a relation of numKeys 100 byte records in random key order,
+ * fetching every record: one heap page read per rid in key order as intScan() in main.cpp does,
+ * against HeapFetcher in heap order and in key order and fetchRecords() over a bitmap. The heap
+ * pages are dropped from the buffer pool and the OS page cache before every run. Prints one CSV
+ * row per run; heap_reads counts buffer pool misses.
+ */
+static void benchHeapFetch(int numKeys)
+{
+	const std::string relationName = "bench_heapfetch.rel";
+	std::vector<int> keys(numKeys);
+	for (int i = 0; i < numKeys; i++) keys[i] = i;
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+	createKeyRelation(relationName, keys, 100);
+
+	BufMgr* bufMgr = new BufMgr(1024);
+	std::string indexName;
+	{
+		BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER);
+		PageFile relation = PageFile::open(relationName);
+		std::cout << "selectivity,method,ms,records,heap_reads" << std::endl;
+		for (double selectivity : { 0.001, 0.01, 0.1 }) {
+			ScanRange range = { 0, GTE, (int) (numKeys * selectivity), LT };
+			for (const char* method : { "per_rid", "heap_order", "key_order", "bitmap" }) {
+				std::string name = method;
+				bufMgr->flushFile(&relation);
+				evictFromOsCache(relationName);
+				// index pages stay resident: warm them so that misses are heap reads
+				std::vector<RecordId> rids;
+				scanRangeRids(index, range, rids);
+				bufMgr->clearBufStats();
+
+				benchClock::time_point start = benchClock::now();
+				long records = 0;
+				std::string record;
+				if (name == "per_rid") {
+					for (const RecordId& rid : rids) {
+						Page* page;
+						bufMgr->readPage(&relation, rid.page_number, page);
+						record = page->getRecord(rid);
+						bufMgr->unPinPage(&relation, rid.page_number, false);
+						records++;
+					}
+				} else if (name == "bitmap") {
+					RidBitmap bitmap;
+					scanBitmap(index, range, bitmap);
+					std::vector<std::string> fetched;
+					fetchRecords(bitmap, &relation, bufMgr, fetched);
+					records = fetched.size();
+				} else {
+					HeapFetcher fetcher(index, &relation, bufMgr, name == "key_order");
+					fetcher.startScan(range);
+					RecordId rid;
+					while (fetcher.next(rid, record)) records++;
+				}
+				std::cout << selectivity << "," << method << "," << elapsedNs(start) / 1e6 << "," << records << ","
+					<< bufMgr->getBufStats().diskreads << std::endl;
+			}
+		}
+		bufMgr->flushFile(&relation);
+	}
+	File::remove(indexName);
+	File::remove(relationName);
+	delete bufMgr;
+}
+
+/**
+ * @brief Build an index over numKeys records of 100 bytes while a writer thread inserts one key
+ * every 10 microseconds, blocking in the constructor and online at several page rates. A write
+ * is late by the time since it was due, so a writer held up by the build shows in the tail. Prints
+ * one CSV row per run.
+ */
+static void benchOnline(int numKeys)
+{
+	const std::string relationName = "bench_online.rel";
+	std::vector<int> keys(numKeys);
+	for (int i = 0; i < numKeys; i++) keys[i] = i;
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+	createKeyRelation(relationName, keys, 100);
+
+	std::cout << "method,pages_per_s,build_ms,writes,p50_us,p99_us,max_us,catch_up_entries" << std::endl;
+	for (int pagesPerSecond : { -1, 0, 20000, 5000 }) {
+		bool online = pagesPerSecond >= 0;
+		BufMgr* bufMgr = new BufMgr(16384);
+		IndexOptions options;
+		options.onlineBuild = online;
+		options.buildPagesPerSecond = std::max(0, pagesPerSecond);
+		std::string indexName;
+		std::atomic<BTreeIndex*> target(nullptr);
+		std::atomic<long> lastWrite(LONG_MAX);
+		std::vector<double> late;
+		benchClock::time_point start = benchClock::now();
+		std::thread writer([&]() {
+			RecordId rid;
+			rid.page_number = 1;
+			rid.slot_number = 1;
+			for (long i = 0; i <= lastWrite.load(); i++) {
+				benchClock::time_point due = start + std::chrono::microseconds(i * 10);
+				std::this_thread::sleep_until(due);
+				BTreeIndex* index;
+				while ((index = target.load()) == nullptr) std::this_thread::yield();
+				index->insertEntryInt(numKeys + (int) i, rid);
+				late.push_back(elapsedNs(due) / 1e3);
+			}
+		});
+		{
+			BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER, options);
+			target = &index;
+			index.finishBuild();
+			double ms = elapsedNs(start) / 1e6;
+			// the writes due during the build are issued, late if the build held them up
+			lastWrite = (long) (ms * 100);
+			writer.join();
+			std::sort(late.begin(), late.end());
+			std::cout << (online ? "online" : "blocking") << "," << options.buildPagesPerSecond << "," << ms << ","
+				<< late.size() << "," << percentile(late, 0.5) << "," << percentile(late, 0.99) << ","
+				<< (late.empty() ? 0 : late.back()) << "," << index.getCounters().finalCatchUpEntries << std::endl;
+		}
+		File::remove(indexName);
+		delete bufMgr;
+	}
+	File::remove(relationName);
+}
+
+/**
+ * @brief Time to create an index over numKeys records and to open it again, once while it is
+ * current and once after the relation file has been rewritten. Prints one CSV row per open.
+ */
+static void benchOpen(int numKeys)
+{
+	const std::string relationName = "bench_open.rel";
+	std::vector<int> keys(numKeys);
+	for (int i = 0; i < numKeys; i++) keys[i] = i;
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+	createKeyRelation(relationName, keys);
+
+	BufMgr* bufMgr = new BufMgr(16384);
+	std::string indexName;
+	std::cout << "open,ms,disk_reads,tuples" << std::endl;
+	for (const char* open : { "create", "current", "current", "stale" }) {
+		if (std::string(open) == "stale") createKeyRelation(relationName, keys);
+		bufMgr->clearBufStats();
+		benchClock::time_point start = benchClock::now();
+		BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER);
+		double ms = elapsedNs(start) / 1e6;
+		std::cout << open << "," << ms << "," << bufMgr->getBufStats().diskreads << "," << index.tupleCount() << std::endl;
+	}
+	File::remove(indexName);
+	File::remove(relationName);
+	delete bufMgr;
+}
+
+/**
+ * @brief File size, leaf count and fill, and cold full-range scan time of an index built from
+ * numKeys keys in random order, before and after compact(), with the index file dropped from the
+ * OS page cache before each scan. Prints one CSV row per state.
+ */
+static void benchCompact(int numKeys)
+{
+	const std::string relationName = "bench_compact.rel";
+	std::vector<int> keys(numKeys);
+	for (int i = 0; i < numKeys; i++) keys[i] = i;
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+	createKeyRelation(relationName, keys);
+
+	BufMgr* bufMgr = new BufMgr(1024);
+	std::string indexName;
+	{
+		BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER);
+		std::cout << "state,file_bytes,leaves,leaf_fill,compact_ms,scan_ms,scan_mentries_per_s" << std::endl;
+		for (const char* state : { "split", "compacted" }) {
+			double compactMs = 0;
+			if (std::string(state) == "compacted") {
+				benchClock::time_point start = benchClock::now();
+				index.compact();
+				compactMs = elapsedNs(start) / 1e6;
+			}
+			IndexStats stats = index.collectStats();
+			index.checkpoint();
+			struct stat st;
+			stat(indexName.c_str(), &st);
+			evictFromOsCache(indexName);
+
+			int low = 0, high = numKeys;
+			std::vector<RecordId> rids(4096);
+			long entries = 0;
+			benchClock::time_point start = benchClock::now();
+			try {
+				index.startScan(&low, GTE, &high, LTE);
+				while (true) entries += index.scanNextBatch(rids.data(), rids.size());
+			} catch (const IndexScanCompletedException &) {
+				index.endScan();
+			}
+			double ns = elapsedNs(start);
+			std::cout << state << "," << st.st_size << "," << stats.numLeafPages << "," << stats.avgLeafFill << ","
+				<< compactMs << "," << ns / 1e6 << "," << entries * 1e3 / ns << std::endl;
+		}
+	}
+	File::remove(indexName);
+	File::remove(relationName);
+	delete bufMgr;
+}
+
+// -----------------------------------------------------------------------------
+// In-memory index
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Insert time of numKeys keys in random order into an empty index, and time of numOps
+ * single-key lookups of random keys, with the nodes in a buffer pool that holds the whole index
+ * and in a NodeArena; then for the in-memory index the time to save a snapshot and to load it
+ * again. Prints one CSV row per backend.
+ */
+static void benchMemory(int numKeys, int numOps)
+{
+	const std::string relationName = "bench_memory.rel";
+	std::vector<int> keys(numKeys);
+	for (int i = 0; i < numKeys; i++) keys[i] = i;
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+	std::mt19937 rng(7);
+	std::vector<int> lookupKeys(numOps);
+	for (int& key : lookupKeys) key = rng() % numKeys;
+
+	std::cout << "backend,ns_per_insert,ns_per_lookup,found,snapshot_save_ms,snapshot_load_ms" << std::endl;
+	for (bool inMemory : { false, true }) {
+		BufMgr* bufMgr = new BufMgr(16384);
+		IndexOptions options;
+		options.buildFromRelation = false;
+		options.inMemory = inMemory;
+		std::string indexName;
+		double saveMs = 0, loadMs = 0;
+		{
+			BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER, options);
+			RecordId rid;
+			rid.page_number = 1;
+			rid.slot_number = 1;
+			benchClock::time_point start = benchClock::now();
+			for (int key : keys) index.insertEntryInt(key, rid);
+			double insertNs = elapsedNs(start);
+
+			std::vector<int> key(1);
+			std::vector<std::vector<RecordId>> results;
+			long found = 0;
+			start = benchClock::now();
+			for (int lookupKey : lookupKeys) {
+				key[0] = lookupKey;
+				index.lookupBatch(key, results);
+				found += results[0].size();
+			}
+			double lookupNs = elapsedNs(start);
+
+			if (inMemory) {
+				start = benchClock::now();
+				index.saveSnapshot();
+				saveMs = elapsedNs(start) / 1e6;
+			}
+			std::cout << (inMemory ? "in_memory" : "buffer_pool") << "," << insertNs / numKeys << "," << lookupNs / numOps << "," << found;
+		}
+		if (inMemory) {
+			benchClock::time_point start = benchClock::now();
+			BTreeIndex index(relationName, indexName, bufMgr, 0, INTEGER, options);
+			loadMs = elapsedNs(start) / 1e6;
+		}
+		std::cout << "," << saveMs << "," << loadMs << std::endl;
+		File::remove(indexName);
+		delete bufMgr;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	std::string mode = argc > 1 ? argv[1] : "layout";
+	int numKeys = argc > 2 ? atoi(argv[2]) : 1000000;
+	int numOps = argc > 3 ? atoi(argv[3]) : 200000;
+
+	if (mode == "layout") {
+		benchLayout(numKeys, numOps);
+	} else if (mode == "split") {
+		benchSplit(numKeys);
+	} else if (mode == "hint") {
+		benchHint(numKeys);
+	} else if (mode == "ring") {
+		benchScanRing(numKeys, numOps);
+	} else if (mode == "async") {
+		benchAsync(numKeys, numOps);
+	} else if (mode == "probe") {
+		benchProbe(numKeys, numOps);
+	} else if (mode == "partition") {
+		benchPartition(numKeys, numOps);
+	} else if (mode == "olc") {
+		benchOlc(numKeys, numOps);
+	} else if (mode == "delta") {
+		benchDelta(numKeys);
+	} else if (mode == "buffered") {
+		benchBuffered(numKeys);
+	} else if (mode == "join") {
+		benchJoin(numKeys);
+	} else if (mode == "inlist") {
+		benchInList(numKeys);
+	} else if (mode == "bitmap") {
+		benchBitmap(numKeys);
+	} else if (mode == "heapfetch") {
+		benchHeapFetch(numKeys);
+	} else if (mode == "online") {
+		benchOnline(numKeys);
+	} else if (mode == "open") {
+		benchOpen(numKeys);
+	} else if (mode == "compact") {
+		benchCompact(numKeys);
+	} else if (mode == "memory") {
+		benchMemory(numKeys, numOps);
+	} else if (mode == "suite") {
+		std::string format = argc > 4 ? argv[4] : "plain";
+		benchSuite(numKeys, numOps, format == "compressed" ? LEAF_COMPRESSED : format == "postings" ? LEAF_POSTINGS : LEAF_PLAIN);
+	} else {
+		std::cerr << "usage: " << argv[0] << " layout|split|hint|ring|async|probe|partition|olc|delta|buffered|join|inlist|bitmap|heapfetch|online|open|compact|memory [numKeys] [numOps]" << std::endl;
+		std::cerr << "       " << argv[0] << " suite [numKeys] [numOps] [plain|compressed|postings]" << std::endl;
+		return 1;
+	}
+	return 0;
+}
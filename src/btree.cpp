@@ -15,7 +15,22 @@
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/page_pinned_exception.h"
+#include "exceptions/invalid_page_exception.h"
 #include <type_traits>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <sys/stat.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
 // #include "pagePtr.h"
 
 
@@ -24,6 +39,211 @@
 namespace badgerdb
 {
 
+/**
+ * Hash of the size, modification time and page count of the file of relationName and of the
+ * bytes of its first and last pages as on disk, 0 if it has none. A build from the relation is
+ * current as long as this is unchanged.
+ */
+static std::uint64_t relationFingerprint(const std::string& relationName)
+{
+	struct stat st;
+	if (stat(relationName.c_str(), &st) != 0)
+		return 0;
+	std::uint64_t h = (std::uint64_t) st.st_size * 0x9E3779B97F4A7C15ULL;
+	h ^= (std::uint64_t) st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+	PageId numPages = st.st_size / Page::SIZE;
+	h = (h ^ numPages) * 0xBF58476D1CE4E5B9ULL;
+	// a record written into a page with room changes neither the size nor, within the clock's
+	// granularity, the time; appends go to the last page
+	try {
+		PageFile relation(relationName, false);
+		for (PageId pageNo : { (PageId) 1, numPages }) {
+			if (pageNo == Page::INVALID_NUMBER)
+				continue;
+			Page page = relation.readPage(pageNo);
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&page);
+			for (std::size_t i = 0; i < Page::SIZE; i++)
+				h = (h ^ bytes[i]) * 0x100000001B3ULL;
+		}
+	} catch (const FileNotFoundException &) {
+	} catch (const InvalidPageException &) {
+	}
+	return h * 0xBF58476D1CE4E5B9ULL | 1;
+}
+
+// -----------------------------------------------------------------------------
+// Compressed leaf encoding
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Bytes of data needed to encode entries [begin, end) of keys/rids as one compressed leaf.
+ */
+static int compressedLeafSize(const int* keys, const RecordId* rids, int begin, int end) {
+	if (begin == end) return 0;
+	int runs = 1;
+	for (int i = begin + 1; i < end; i++)
+		if (rids[i].page_number != rids[i-1].page_number) runs++;
+	std::uint32_t range = (std::uint32_t) keys[end-1] - (std::uint32_t) keys[begin];
+	int keyBytes = range <= UINT16_MAX ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+	return runs * sizeof(RidRun) + (end - begin) * (keyBytes + sizeof(SlotId));
+}
+
+/**
+ * @brief Overwrite the entries of a compressed leaf with entries [begin, end) of keys/rids.
+ * The caller checks compressedLeafSize() first. rightSibPageNo and highKey are left unchanged.
+ */
+static void encodeCompressedLeaf(CompressedLeafNodeInt* node, const int* keys, const RecordId* rids, int begin, int end) {
+	int n = end - begin;
+	node->numEntries = n;
+	node->baseKey = n > 0 ? keys[begin] : 0;
+	std::uint32_t range = n > 0 ? (std::uint32_t) keys[end-1] - (std::uint32_t) keys[begin] : 0;
+	node->keyBytes = range <= UINT16_MAX ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+
+	RidRun* runs = reinterpret_cast<RidRun*>(node->data);
+	int r = -1;
+	for (int i = begin; i < end; i++) {
+		if (r < 0 || runs[r].pageNo != rids[i].page_number) {
+			r++;
+			runs[r].pageNo = rids[i].page_number;
+			runs[r].length = 0;
+		}
+		runs[r].length++;
+	}
+	node->numRuns = r + 1;
+
+	char* offsets = node->data + node->numRuns * sizeof(RidRun);
+	if (node->keyBytes == sizeof(std::uint16_t)) {
+		std::uint16_t* out = reinterpret_cast<std::uint16_t*>(offsets);
+		for (int i = 0; i < n; i++) out[i] = (std::uint32_t) keys[begin+i] - (std::uint32_t) node->baseKey;
+	} else {
+		std::uint32_t* out = reinterpret_cast<std::uint32_t*>(offsets);
+		for (int i = 0; i < n; i++) out[i] = (std::uint32_t) keys[begin+i] - (std::uint32_t) node->baseKey;
+	}
+	SlotId* slots = reinterpret_cast<SlotId*>(offsets + n * node->keyBytes);
+	for (int i = 0; i < n; i++) slots[i] = rids[begin+i].slot_number;
+}
+
+/**
+ * @brief Decode all entries of a compressed leaf into keys/rids. Returns the number of entries.
+ */
+static int decodeCompressedLeaf(const CompressedLeafNodeInt* node, int* keys, RecordId* rids) {
+	int n = node->numEntries;
+	const RidRun* runs = reinterpret_cast<const RidRun*>(node->data);
+	const char* offsets = node->data + node->numRuns * sizeof(RidRun);
+
+	int i = 0;
+	if (node->keyBytes == sizeof(std::uint16_t)) {
+		const std::uint16_t* in = reinterpret_cast<const std::uint16_t*>(offsets);
+#if defined(__SSE2__)
+		// widen 8 offsets to 32 bits and add the base key per iteration
+		const __m128i base = _mm_set1_epi32(node->baseKey);
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 8 <= n; i += 8) {
+			__m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(keys + i), _mm_add_epi32(base, _mm_unpacklo_epi16(packed, zero)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(keys + i + 4), _mm_add_epi32(base, _mm_unpackhi_epi16(packed, zero)));
+		}
+#endif
+		for (; i < n; i++) keys[i] = (std::uint32_t) node->baseKey + in[i];
+	} else {
+		const std::uint32_t* in = reinterpret_cast<const std::uint32_t*>(offsets);
+		for (; i < n; i++) keys[i] = (std::uint32_t) node->baseKey + in[i];
+	}
+
+	const SlotId* slots = reinterpret_cast<const SlotId*>(offsets + n * node->keyBytes);
+	int e = 0;
+	for (int r = 0; r < node->numRuns; r++) {
+		for (std::uint32_t j = 0; j < runs[r].length; j++, e++) {
+			rids[e].page_number = runs[r].pageNo;
+			rids[e].slot_number = slots[e];
+		}
+	}
+	return n;
+}
+
+// -----------------------------------------------------------------------------
+// Postings leaf encoding
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Number of rids of a postings list stored inside its leaf.
+ */
+static inline int inlineRids(const PostingInt& posting) {
+	return posting.overflowPageNo == Page::INVALID_NUMBER ? posting.numRids : 0;
+}
+
+/**
+ * @brief Decode a postings leaf into postings/rids. Returns the number of postings.
+ */
+static int decodePostingsLeaf(const PostingsLeafNodeInt* node, PostingInt* postings, RecordId* rids) {
+	const PostingInt* inPostings = reinterpret_cast<const PostingInt*>(node->data);
+	const RecordId* inRids = reinterpret_cast<const RecordId*>(node->data + node->numPostings * sizeof(PostingInt));
+	std::copy(inPostings, inPostings + node->numPostings, postings);
+	std::copy(inRids, inRids + node->numRids, rids);
+	return node->numPostings;
+}
+
+/**
+ * @brief Overwrite the entries of a postings leaf with numPostings postings whose in-leaf
+ * rids start at rids. rightSibPageNo and highKey are left unchanged.
+ */
+static void encodePostingsLeaf(PostingsLeafNodeInt* node, const PostingInt* postings, int numPostings, const RecordId* rids) {
+	int numRids = 0;
+	for (int i = 0; i < numPostings; i++) numRids += inlineRids(postings[i]);
+	node->numPostings = numPostings;
+	node->numRids = numRids;
+	std::copy(postings, postings + numPostings, reinterpret_cast<PostingInt*>(node->data));
+	std::copy(rids, rids + numRids, reinterpret_cast<RecordId*>(node->data + numPostings * sizeof(PostingInt)));
+}
+
+/**
+ * @brief Number of entries in the buffer of a NONLEAF_BUFFERED node.
+ */
+static inline int& bufferSize(NonLeafNodeInt* node) {
+	return node->keyArray[INTARRAYBUFFEREDNONLEAFSIZE];
+}
+
+static inline int bufferSize(const NonLeafNodeInt* node) {
+	return node->keyArray[INTARRAYBUFFEREDNONLEAFSIZE];
+}
+
+/**
+ * @brief Entry m of the buffer of a NONLEAF_BUFFERED node: in the key array past the count for
+ * the first IntNodeLayout::BUFFERKEYMESSAGES entries, past the last child for the others.
+ */
+static inline BufferMessageInt* bufferMessage(NonLeafNodeInt* node, int m) {
+	const int inKeys = IntNodeLayout<Page::SIZE>::BUFFERKEYMESSAGES;
+	if (m < inKeys)
+		return reinterpret_cast<BufferMessageInt*>(node->keyArray + INTARRAYBUFFEREDNONLEAFSIZE + 1) + m;
+	return reinterpret_cast<BufferMessageInt*>(node->pageNoArray + INTARRAYBUFFEREDNONLEAFSIZE + 1) + (m - inKeys);
+}
+
+static inline const BufferMessageInt* bufferMessage(const NonLeafNodeInt* node, int m) {
+	return bufferMessage(const_cast<NonLeafNodeInt*>(node), m);
+}
+
+static inline bool messageKeyLess(const BufferMessageInt& a, const BufferMessageInt& b) {
+	return a.key < b.key;
+}
+
+/**
+ * @brief True if key lies inside the range given by lowVal, lowOp, highVal and highOp.
+ */
+static inline bool keyInRange(int key, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+	bool match;
+	if (lowOp== GTE && highOp == LTE) {
+	   match = (key <= highVal && key >= lowVal);
+    } else if (lowOp == GTE && highOp == LT) {
+           match = (key < highVal && key >= lowVal);
+	} else if (lowOp == GT && highOp == LTE) {
+           match = (key <= highVal && key > lowVal);
+	} else { // GT, LT
+	   match = (key < highVal && key > lowVal);
+	}
+	return match;
+}
+
 // -----------------------------------------------------------------------------
 // BTreeIndex::BTreeIndex -- Constructor
 // -----------------------------------------------------------------------------
@@ -32,69 +252,182 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		std::string & outIndexName,
 		BufMgr *bufMgrIn,
 		const int attrByteOffset,
-		const Datatype attrType)
+		const Datatype attrType,
+		const IndexOptions & options)
 {
-	if (attrType != INTEGER) {
-		std::cout<<"Not Implement"<<std::endl;
-		return;
-	}
+	if (attrType != INTEGER)
+		throw BadIndexInfoException(relationName + ": only INTEGER keys are supported");
 	bufMgr = bufMgrIn;
+	counters = IndexCounters();
+	optimisticReads = options.optimisticReads;
+	poolFrames = std::max(0, options.poolFrames);
+	// concurrent lookups do not read the delta
+	deltaCapacity = optimisticReads ? 0 : std::max(0, options.deltaEntries);
+	olcChunks = optimisticReads ? new std::atomic<OptimisticNode*>[OLCMAXCHUNKS]() : nullptr;
+	timingSampleRate = 0;
+	timingCountdown = 0;
 	std::ostringstream idxStr;
   	idxStr << relationName << '.' << attrByteOffset;
+	if (options.partition >= 0) idxStr << ".p" << options.partition;
   	outIndexName = idxStr.str(); // outIndexName is the name of the index file.
+	indexFileName = outIndexName;
+	arena = options.inMemory ? new NodeArena() : nullptr;
+	file = nullptr;
+	numIndexPages = 0;
 	Page* metaPage;
 	PageId metaPageId = 1;
 	IndexMetaInfo* metaData;
-	bool fileExists = false;
+	bool newFile = false;
 
   	try {
 		// BlobFile temp = BlobFile::open(outIndexName);
 		file = new BlobFile(outIndexName, false);
 		// file = &temp; // already exists
 		// Page* metaPage;
-		bufMgr->readPage(file, metaPageId, metaPage);
+		if (arena != nullptr) {
+			// the meta page first: the rest of the file is only loaded if the index is current
+			arena->allocate(metaPageId, metaPage);
+			*metaPage = file->readPage(metaPageId);
+		}
+		readPage(metaPageId, metaPage);
 		metaData = reinterpret_cast<IndexMetaInfo*>(metaPage);
 
-		if (metaData->relationName != relationName || metaData->attrByteOffset != attrByteOffset || metaData->attrType != attrType) {
-			bufMgr->unPinPage(file, metaPageId, false);
+		bool fromRelation = options.buildFromRelation || options.onlineBuild;
+		if (metaData->relationName != relationName || metaData->attrByteOffset != attrByteOffset || metaData->attrType != attrType
+			|| metaData->pageSize != (int) Page::SIZE || metaData->lowKey != options.lowKey || metaData->highKey != options.highKey
+			|| (metaData->formatVersion != INDEXFORMATVERSION && !fromRelation)
+			|| (arena != nullptr && !fromRelation && !metaData->complete)) {
+			unpinPage(metaPageId, false);
 			throw BadIndexInfoException(outIndexName);
 		}
+		if (fromRelation && (metaData->formatVersion != INDEXFORMATVERSION || !metaData->complete
+				|| metaData->relationFingerprint != relationFingerprint(relationName))) {
+			// stale, half written or of an older format: build the index anew
+			unpinPage(metaPageId, false);
+			if (arena == nullptr) bufMgr->flushFile(file);
+			delete file;
+			file = nullptr;
+			// an in-memory index leaves the file to saveSnapshot()
+			if (arena == nullptr) File::remove(outIndexName);
+			else arena->reset();
+			newFile = true;
+		} else if (arena != nullptr) {
+			for (PageId pageNo = metaPageId + 1; pageNo <= metaData->numPages; pageNo++) {
+				PageId arenaPageNo;
+				Page* page;
+				arena->allocate(arenaPageNo, page);
+				*page = file->readPage(pageNo);
+			}
+			delete file;
+			file = nullptr;
+		}
+		numIndexPages = metaData->numPages;
   	} catch(FileNotFoundException e)
 	{
-		fileExists = true;
-		file = new BlobFile(outIndexName, true);
+		newFile = true;
+	}
+	if (newFile) {
+		numIndexPages = 0;
+		if (arena == nullptr) file = new BlobFile(outIndexName, true);
 	  	// Page* metaPage;
 	  	// PageId metaPageId;
-	  	bufMgr->allocPage(file, metaPageId, metaPage);
+	  	allocPage(metaPageId, metaPage);
 	  	metaData = reinterpret_cast<IndexMetaInfo*>(metaPage);
 		strcpy(metaData->relationName, relationName.c_str());
 		metaData->attrByteOffset = attrByteOffset;
 		metaData->attrType = attrType;
+		metaData->pageSize = Page::SIZE;
+		metaData->lowKey = options.lowKey;
+		metaData->highKey = options.highKey;
+		metaData->nonLeafFormat = options.nonLeafFormat;
+		metaData->leafFormat = options.leafFormat;
+		metaData->fillFactor = std::max(50, std::min(100, options.fillFactor));
+		metaData->stats = IndexStatsSummary();
+		metaData->formatVersion = INDEXFORMATVERSION;
+		metaData->complete = false;
+		metaData->relationFingerprint = 0;
+		metaData->numTuples = 0;
+	}
+	relationFileName = relationName;
+	numTuples = metaData->numTuples;
+	metaComplete = metaData->complete;
+	// build BTreeIndex object
+	headerPageNum = 1;
+	leafFormat = metaData->leafFormat;
+	fillFactor = metaData->fillFactor;
+	insertHint = options.insertHint;
+	insertAppend = false;
+	storedStats = metaData->stats;
+	hintLeafPageNum = Page::INVALID_NUMBER;
+	leafOccupancy = leafFormat == LEAF_COMPRESSED ? INTARRAYCOMPRESSEDLEAFSIZE : INTARRAYLEAFSIZE;
+	if (leafFormat == LEAF_COMPRESSED) {
+		leafKeyBuf.resize(INTARRAYCOMPRESSEDLEAFSIZE + 1);
+		leafRidBuf.resize(INTARRAYCOMPRESSEDLEAFSIZE + 1);
+		scanKeyBuf.resize(INTARRAYCOMPRESSEDLEAFSIZE);
+		scanRidBuf.resize(INTARRAYCOMPRESSEDLEAFSIZE);
+		asyncKeyBuf.resize(INTARRAYCOMPRESSEDLEAFSIZE);
+		asyncRidBuf.resize(INTARRAYCOMPRESSEDLEAFSIZE);
+	} else if (leafFormat == LEAF_POSTINGS) {
+		leafOccupancy = INTARRAYPOSTINGSLEAFSIZE;
+		leafPostingBuf.resize(INTARRAYPOSTINGSLEAFSIZE + 1);
+		leafRidBuf.resize(INTARRAYPOSTINGSLEAFSIZE + 1);
+		scanKeyBuf.resize(INTARRAYPOSTINGSLEAFSIZE);
+		scanRidBuf.resize(INTARRAYPOSTINGSLEAFSIZE);
+		asyncKeyBuf.resize(INTARRAYPOSTINGSLEAFSIZE);
+		asyncRidBuf.resize(INTARRAYPOSTINGSLEAFSIZE);
+	}
+	nonLeafFormat = metaData->nonLeafFormat;
+	nodeOccupancy = nonLeafFormat == NONLEAF_SUMMARY ? IntNodeLayout<Page::SIZE>::SUMMARYNONLEAFSIZE
+			: nonLeafFormat == NONLEAF_BUFFERED ? INTARRAYBUFFEREDNONLEAFSIZE : INTARRAYNONLEAFSIZE;
+	// concurrent lookups do not read the buffers; the checkpoint below empties those in the file
+	bufferInserts = nonLeafFormat == NONLEAF_BUFFERED && !optimisticReads;
+
+	if (newFile) {
 		// construct root
 		metaData->rootPageNo = createNonLeafInt(1);
 		//construct first leaf node
 		PageId leafPageId = createLeafInt();
 		Page* rootPage;
-		bufMgr->readPage(file, metaData->rootPageNo, rootPage);
+		readPage(metaData->rootPageNo, rootPage);
 		NonLeafNodeInt* root = reinterpret_cast<NonLeafNodeInt*>(rootPage);
 		root->pageNoArray[0] = leafPageId;
 		
-		bufMgr->unPinPage(file, metaData->rootPageNo, true);  // un pin meta page ?????
-
-	}	
-	// build BTreeIndex object
-	headerPageNum = 1;
+		unpinPage(metaData->rootPageNo, true);  // un pin meta page ?????
+	}
 	rootPageNum = metaData->rootPageNo;
-	leafOccupancy = INTARRAYLEAFSIZE;
-	nodeOccupancy = INTARRAYNONLEAFSIZE;
 	
 	scanExecuting = false;
+	scanRangeIndex = 0;
 	nextEntry = 0;
 	currentPageNum = Page::INVALID_NUMBER;
 	currentPageData = nullptr; 
-	bufMgr->unPinPage(file, metaPageId, metaPage);
+	// an in-memory index has no file to read leaves from past its pages
+	useScanRing = options.scanRing && arena == nullptr;
+	scanRing.resize(SCANRINGSIZE);
+	scanRingNext = 0;
+	fileInSync = false;
+	asyncReader = nullptr;
+	scanLeavesRead = 0;
+	currentPageInRing = false;
+	overflowPageNum = Page::INVALID_NUMBER;
+	overflowPageData = nullptr;
+	buildScan = nullptr;
+	buildAttrOffset = attrByteOffset;
+	buildPending = false;
+	buildPageNo = Page::INVALID_NUMBER;
+	buildPagesPerSecond = std::max(0, options.buildPagesPerSecond);
+	buildReadPages = 0;
+	onlineBuilding = false;
+	unpinPage(metaPageId, newFile);
+	if (options.onlineBuild) {
+		// an existing index is complete; a new one is filled by buildStep() and finishBuild()
+		if (newFile) {
+			buildScan = new FileScan(relationName, bufMgrIn);
+			buildStartTime = std::chrono::steady_clock::now();
+			onlineBuilding = true;
+		}
+	} else if (options.buildFromRelation && newFile) {
   // read inputs from fscan and insert into B tree
-
 		FileScan fscan = FileScan(relationName, bufMgrIn); 
 		try{
 				RecordId scanRid;
@@ -110,8 +443,29 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 			}
 			catch(const EndOfFileException &e)
 			{
-				std::cout << "Inserted all records" << std::endl;
 			}	
+	}
+	// an opened index is in its file already, with its statistics in the meta page
+	if (newFile || (nonLeafFormat == NONLEAF_BUFFERED && !bufferInserts))
+		checkpoint();
+	else
+		fileInSync = true;
+	if (optimisticReads && arena == nullptr) {
+		// every node into the node table now, so that a pool too small for the index fails here
+		// rather than under concurrent lookups
+		try {
+			for (PageId pageNo = headerPageNum; pageNo <= indexPages(); pageNo++) {
+				Page* page;
+				readPage(pageNo, page);
+				unpinPage(pageNo, false);
+			}
+		} catch (const BufferExceededException &) {
+			flushIndexFile();
+			delete file;
+			file = nullptr;
+			throw;
+		}
+	}
 }
 
 // -----------------------------------------------------------------------------
@@ -120,10 +474,26 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 
 BTreeIndex::~BTreeIndex()
 {
-	if (currentPageNum != Page::INVALID_NUMBER) bufMgr->unPinPage(file, currentPageNum, true);
-	bufMgr->flushFile(BTreeIndex::file);
+	if (currentPageNum != Page::INVALID_NUMBER) releaseScanLeaf(currentPageNum);
+	if (overflowPageNum != Page::INVALID_NUMBER) unpinPage(overflowPageNum, false);
+	scanExecuting = false;
+	try {
+		finishBuild();
+	} catch (...) {
+	}
+	delete buildScan;
+	delete asyncReader;
+	mergeDelta();
+	if (!metaComplete) saveMetaState(!building());
+	flushIndexFile();
+	if (olcChunks != nullptr) {
+		for (int c = 0; c < OLCMAXCHUNKS; c++) delete[] olcChunks[c].load();
+		delete[] olcChunks;
+	}
 	delete file;
 	file = nullptr;
+	delete arena;
+	arena = nullptr;
 }
 
 // -----------------------------------------------------------------------------
@@ -133,82 +503,115 @@ BTreeIndex::~BTreeIndex()
 PageId BTreeIndex::createNonLeafInt(int level) {
 	Page* page;
 	PageId pageId;
-	bufMgr->allocPage(file, pageId, page);
+	allocPage(pageId, page);
 	NonLeafNodeInt* node = reinterpret_cast<NonLeafNodeInt*>(page);
 	node->level = level;
+	node->highKey = INT32_MAX;
+	node->rightSibPageNo = Page::INVALID_NUMBER;
 	for (int i = 0; i < INTARRAYNONLEAFSIZE; i++) node->keyArray[i] = INT32_MAX;
 	node->keyArray[0] = INT32_MAX;
 	node->pageNoArray[0] = Page::INVALID_NUMBER;
-	bufMgr->unPinPage(file, pageId, true);
+	if (nonLeafFormat == NONLEAF_BUFFERED) bufferSize(node) = 0;
+	updateSummary(node, 0);
+	unpinPage(pageId, true);
 	return pageId;
 }
 
 PageId BTreeIndex::createLeafInt() {
 	PageId pageId;
 	Page* page; //create new leaf node, key & rid are first things in page
-	bufMgr->allocPage(file, pageId, page);
+	allocPage(pageId, page);
+	if (leafFormat == LEAF_COMPRESSED) {
+		CompressedLeafNodeInt* node = reinterpret_cast<CompressedLeafNodeInt*>(page);
+		encodeCompressedLeaf(node, nullptr, nullptr, 0, 0);
+		node->rightSibPageNo = Page::INVALID_NUMBER;
+		node->highKey = INT32_MAX;
+		unpinPage(pageId, true);
+		return pageId;
+	}
+	if (leafFormat == LEAF_POSTINGS) {
+		PostingsLeafNodeInt* node = reinterpret_cast<PostingsLeafNodeInt*>(page);
+		encodePostingsLeaf(node, nullptr, 0, nullptr);
+		node->rightSibPageNo = Page::INVALID_NUMBER;
+		node->highKey = INT32_MAX;
+		unpinPage(pageId, true);
+		return pageId;
+	}
 	LeafNodeInt* node = reinterpret_cast<LeafNodeInt*>(page);
 	for (int i = 0; i < INTARRAYLEAFSIZE; i++) node->keyArray[i] = INT32_MAX;
 	node->rightSibPageNo = Page::INVALID_NUMBER;
-	bufMgr->unPinPage(file, pageId, true);
+	node->highKey = INT32_MAX;
+	unpinPage(pageId, true);
 	return pageId;
 }
 
 
-void BTreeIndex::insertLeafInt(int &key, const RecordId rid, PageId &pageId) {	
+void BTreeIndex::insertLeafInt(int &key, const RecordId rid, PageId &pageId, Page* page) {	
+	BTREE_COUNT(nodesVisited, 1);
+	if (pageId != Page::INVALID_NUMBER && page == nullptr)
+		readPage(pageId, page);
+	if (leafFormat == LEAF_COMPRESSED) {
+		insertCompressedLeafInt(key, rid, pageId, page);
+		return;
+	}
+	if (leafFormat == LEAF_POSTINGS) {
+		insertPostingsLeafInt(key, rid, pageId, page);
+		return;
+	}
 	if (pageId == Page::INVALID_NUMBER) { // first entry -- ?? need this ??
 		pageId = createLeafInt();
-		Page* page; //create new leaf node, key & rid are first things in page
-		bufMgr->readPage(file, pageId, page);
+		//create new leaf node, key & rid are first things in page
+		readPage(pageId, page);
 		LeafNodeInt* node = reinterpret_cast<LeafNodeInt*>(page);
 		node->keyArray[0] = key;
 		node->ridArray[0] = rid;
-		bufMgr->unPinPage(file, pageId, true);
+		unpinPage(pageId, true);
 		return;
 	}
 
-	Page* page;
-	bufMgr->readPage(file, pageId, page);
 	LeafNodeInt* node = reinterpret_cast<LeafNodeInt*>(page);
 	if (node->keyArray[INTARRAYLEAFSIZE-1] != INT32_MAX) {
-		// split (leaf in half)
+		// split: lay out the full leaf plus the new entry in order
+		int keys[INTARRAYLEAFSIZE + 1];
+		RecordId rids[INTARRAYLEAFSIZE + 1];
+		int pos = insertAppend ? INTARRAYLEAFSIZE : leafLowerBound(node, key);
+		std::copy(node->keyArray, node->keyArray + pos, keys);
+		std::copy(node->keyArray + pos, node->keyArray + INTARRAYLEAFSIZE, keys + pos + 1);
+		std::copy(node->ridArray, node->ridArray + pos, rids);
+		std::copy(node->ridArray + pos, node->ridArray + INTARRAYLEAFSIZE, rids + pos + 1);
+		keys[pos] = key;
+		rids[pos] = rid;
+		int mid = splitPoint(INTARRAYLEAFSIZE + 1, INTARRAYLEAFSIZE, pos, insertRightmost, insertLeftmost);
+
 		Page* newPage;
-		int mid = INTARRAYLEAFSIZE / 2;
 		PageId newPageId = createLeafInt();
-		bufMgr->readPage(file, newPageId, newPage);
+		readPage(newPageId, newPage);
 		LeafNodeInt* newNode = reinterpret_cast<LeafNodeInt*>(newPage);
-
-		for (int i = mid; i < INTARRAYLEAFSIZE; i++){
-			newNode->keyArray[i-mid] = node->keyArray[i];
-			newNode->ridArray[i-mid] = node->ridArray[i];
-			node->keyArray[i] = INT32_MAX;
-		}
+		std::copy(keys + mid, keys + INTARRAYLEAFSIZE + 1, newNode->keyArray);
+		std::copy(rids + mid, rids + INTARRAYLEAFSIZE + 1, newNode->ridArray);
+		std::copy(keys, keys + mid, node->keyArray);
+		std::copy(rids, rids + mid, node->ridArray);
+		std::fill(node->keyArray + mid, node->keyArray + INTARRAYLEAFSIZE, INT32_MAX);
 		newNode->rightSibPageNo = node->rightSibPageNo;
+		newNode->highKey = node->highKey;
 		node->rightSibPageNo = newPageId;
-		
-		// insert into correct half
-		if (key > newNode->keyArray[0]) {
-			PageId tempPageId = newPageId;
-			insertLeafInt(key, rid, tempPageId);
-		} else {
-			PageId tempPageId = pageId;
-			insertLeafInt(key, rid, tempPageId);
-		}
-		bufMgr->unPinPage(file, pageId, true);
+		node->highKey = keys[mid];
+
+		unpinPage(pageId, true);
+		unpinPage(newPageId, true);
+		BTREE_COUNT(leafSplits, 1);
 		pageId = newPageId;
-		key = newNode->keyArray[0];
-		bufMgr->unPinPage(file, newPageId, true);
-		 
+		key = keys[mid];
 		return;
 	}
 	
 	int i;
-	for (i = 0; key > node->keyArray[i]; i++) ; //find insertion index
+	for (i = 0; insertAppend ? node->keyArray[i] != INT32_MAX : key > node->keyArray[i]; i++) ; //find insertion index
 
 	if (node->keyArray[i] == INT32_MAX){ // insert in current node
 		node->keyArray[i] = key;
 		node->ridArray[i] = rid;
-		bufMgr->unPinPage(file, pageId, true);
+		unpinPage(pageId, true);
 		pageId = Page::INVALID_NUMBER;
 		return;
 	} else { // shift to insert in middle of node
@@ -220,15 +623,273 @@ void BTreeIndex::insertLeafInt(int &key, const RecordId rid, PageId &pageId) {
 		}
 		node->keyArray[i] = key;
 		node->ridArray[i] = rid;
-		bufMgr->unPinPage(file, pageId, true);
+		unpinPage(pageId, true);
 		pageId = Page::INVALID_NUMBER;
 		return;
 	}
 }
 
-void BTreeIndex::insertNoSplit(NonLeafNodeInt* node, const int newKey, const PageId newPageId) {
-	int i;
-	for (i = 0; i < INTARRAYNONLEAFSIZE && newKey > node->keyArray[i]; i++);
+void BTreeIndex::insertCompressedLeafInt(int &key, const RecordId rid, PageId &pageId, Page* page) {
+	CompressedLeafNodeInt* node = reinterpret_cast<CompressedLeafNodeInt*>(page);
+	int* keys = leafKeyBuf.data();
+	RecordId* rids = leafRidBuf.data();
+	int n = decodeCompressedLeaf(node, keys, rids);
+
+	int i = insertAppend ? n : std::lower_bound(keys, keys + n, key) - keys; //find insertion index
+	std::copy_backward(keys + i, keys + n, keys + n + 1);
+	std::copy_backward(rids + i, rids + n, rids + n + 1);
+	keys[i] = key;
+	rids[i] = rid;
+	n++;
+
+	if (n <= INTARRAYCOMPRESSEDLEAFSIZE && compressedLeafSize(keys, rids, 0, n) <= CompressedLeafNodeInt::DATASIZE) {
+		encodeCompressedLeaf(node, keys, rids, 0, n);
+		unpinPage(pageId, true);
+		pageId = Page::INVALID_NUMBER;
+		return;
+	}
+
+	// split in the middle, or by bytes leaving fillFactor of a page behind when appending to the
+	// rightmost (leftmost) leaf; then move the split point until both halves encode into a page
+	int mid = n / 2;
+	int target = CompressedLeafNodeInt::DATASIZE * fillFactor / 100;
+	if (insertRightmost && i == n - 1) {
+		int lo = 1, hi = n - 1;
+		while (lo + 1 < hi) {
+			int m = (lo + hi) / 2;
+			if (compressedLeafSize(keys, rids, 0, m) <= target) lo = m; else hi = m;
+		}
+		mid = lo;
+	} else if (insertLeftmost && i == 0) {
+		int lo = 1, hi = n - 1;
+		while (lo + 1 < hi) {
+			int m = (lo + hi) / 2;
+			if (compressedLeafSize(keys, rids, m, n) <= target) hi = m; else lo = m;
+		}
+		mid = hi;
+	}
+	if (compressedLeafSize(keys, rids, 0, mid) > CompressedLeafNodeInt::DATASIZE) {
+		int lo = 1, hi = mid;
+		while (lo + 1 < hi) {
+			int m = (lo + hi) / 2;
+			if (compressedLeafSize(keys, rids, 0, m) <= CompressedLeafNodeInt::DATASIZE) lo = m; else hi = m;
+		}
+		mid = lo;
+	} else if (compressedLeafSize(keys, rids, mid, n) > CompressedLeafNodeInt::DATASIZE) {
+		int lo = mid, hi = n - 1;
+		while (lo + 1 < hi) {
+			int m = (lo + hi) / 2;
+			if (compressedLeafSize(keys, rids, m, n) <= CompressedLeafNodeInt::DATASIZE) hi = m; else lo = m;
+		}
+		mid = hi;
+	}
+
+	Page* newPage;
+	PageId newPageId = createLeafInt();
+	readPage(newPageId, newPage);
+	CompressedLeafNodeInt* newNode = reinterpret_cast<CompressedLeafNodeInt*>(newPage);
+	encodeCompressedLeaf(newNode, keys, rids, mid, n);
+	encodeCompressedLeaf(node, keys, rids, 0, mid);
+	newNode->rightSibPageNo = node->rightSibPageNo;
+	newNode->highKey = node->highKey;
+	node->rightSibPageNo = newPageId;
+	node->highKey = keys[mid];
+
+	unpinPage(pageId, true);
+	unpinPage(newPageId, true);
+	BTREE_COUNT(leafSplits, 1);
+	pageId = newPageId;
+	key = keys[mid];
+}
+
+void BTreeIndex::insertPostingsLeafInt(int &key, const RecordId rid, PageId &pageId, Page* page) {
+	PostingsLeafNodeInt* node = reinterpret_cast<PostingsLeafNodeInt*>(page);
+	PostingInt* postings = leafPostingBuf.data();
+	RecordId* rids = leafRidBuf.data();
+	int numPostings = decodePostingsLeaf(node, postings, rids);
+	int numRids = node->numRids;
+
+	int i; // posting of key, and the position of its rids
+	int ridPos = 0;
+	for (i = 0; i < numPostings && postings[i].key < key; i++) ridPos += inlineRids(postings[i]);
+
+	if (i < numPostings && postings[i].key == key) {
+		if (postings[i].overflowPageNo != Page::INVALID_NUMBER) {
+			// only the count in the leaf changes
+			insertOverflowRid(postings[i].overflowPageNo, rid);
+			reinterpret_cast<PostingInt*>(node->data)[i].numRids++;
+			unpinPage(pageId, true);
+			pageId = Page::INVALID_NUMBER;
+			return;
+		}
+		RecordId* first = rids + ridPos;
+		RecordId* at = std::upper_bound(first, first + postings[i].numRids, rid, ridLess);
+		std::copy_backward(at, rids + numRids, rids + numRids + 1);
+		*at = rid;
+		numRids++;
+		postings[i].numRids++;
+
+		if (postings[i].numRids > POSTINGSINLINESIZE) { // spill the list to overflow pages
+			postings[i].overflowPageNo = createOverflowChain(first, postings[i].numRids);
+			std::copy(first + postings[i].numRids, rids + numRids, first);
+			numRids -= postings[i].numRids;
+		}
+	} else {
+		std::copy_backward(postings + i, postings + numPostings, postings + numPostings + 1);
+		postings[i].key = key;
+		postings[i].numRids = 1;
+		postings[i].overflowPageNo = Page::INVALID_NUMBER;
+		numPostings++;
+		std::copy_backward(rids + ridPos, rids + numRids, rids + numRids + 1);
+		rids[ridPos] = rid;
+		numRids++;
+	}
+
+	int size = numPostings * sizeof(PostingInt) + numRids * sizeof(RecordId);
+	if (size <= PostingsLeafNodeInt::DATASIZE) {
+		encodePostingsLeaf(node, postings, numPostings, rids);
+		unpinPage(pageId, true);
+		pageId = Page::INVALID_NUMBER;
+		return;
+	}
+
+	// split between two postings lists: in the middle of the data, or leaving fillFactor of the
+	// page in the left (right) leaf when appending to the rightmost (leftmost) leaf
+	int target = size / 2;
+	if (insertRightmost && i == numPostings - 1)
+		target = PostingsLeafNodeInt::DATASIZE * fillFactor / 100;
+	else if (insertLeftmost && i == 0)
+		target = size - PostingsLeafNodeInt::DATASIZE * fillFactor / 100;
+
+	int mid = 1;
+	int leftRids = 0;
+	int bestDistance = INT32_MAX;
+	int leftSize = 0;
+	int ridsBefore = 0;
+	for (int m = 1; m < numPostings; m++) {
+		leftSize += sizeof(PostingInt) + inlineRids(postings[m-1]) * sizeof(RecordId);
+		ridsBefore += inlineRids(postings[m-1]);
+		if (leftSize > PostingsLeafNodeInt::DATASIZE) break;
+		if (size - leftSize > PostingsLeafNodeInt::DATASIZE) continue;
+		if (std::abs(leftSize - target) < bestDistance) {
+			bestDistance = std::abs(leftSize - target);
+			mid = m;
+			leftRids = ridsBefore;
+		}
+	}
+
+	Page* newPage;
+	PageId newPageId = createLeafInt();
+	readPage(newPageId, newPage);
+	PostingsLeafNodeInt* newNode = reinterpret_cast<PostingsLeafNodeInt*>(newPage);
+	encodePostingsLeaf(newNode, postings + mid, numPostings - mid, rids + leftRids);
+	encodePostingsLeaf(node, postings, mid, rids);
+	newNode->rightSibPageNo = node->rightSibPageNo;
+	newNode->highKey = node->highKey;
+	node->rightSibPageNo = newPageId;
+	node->highKey = postings[mid].key;
+
+	unpinPage(pageId, true);
+	unpinPage(newPageId, true);
+	BTREE_COUNT(leafSplits, 1);
+	pageId = newPageId;
+	key = postings[mid].key;
+}
+
+PageId BTreeIndex::createOverflowChain(const RecordId* rids, int n) {
+	PageId headPageNo = Page::INVALID_NUMBER;
+	PageId prevPageNo = Page::INVALID_NUMBER;
+	Page* prevPage = nullptr;
+	for (int done = 0; done < n; ) {
+		PageId pageNo;
+		Page* page;
+		allocPage(pageNo, page);
+		PostingsOverflowPage* overflow = reinterpret_cast<PostingsOverflowPage*>(page);
+		overflow->nextPageNo = Page::INVALID_NUMBER;
+		overflow->tailPageNo = Page::INVALID_NUMBER;
+		overflow->numRids = std::min(n - done, PostingsOverflowPage::SIZE);
+		std::copy(rids + done, rids + done + overflow->numRids, overflow->ridArray);
+		done += overflow->numRids;
+
+		if (prevPage != nullptr) {
+			reinterpret_cast<PostingsOverflowPage*>(prevPage)->nextPageNo = pageNo;
+			unpinPage(prevPageNo, true);
+		} else {
+			headPageNo = pageNo;
+		}
+		prevPageNo = pageNo;
+		prevPage = page;
+	}
+	unpinPage(prevPageNo, true);
+
+	Page* headPage;
+	readPage(headPageNo, headPage);
+	reinterpret_cast<PostingsOverflowPage*>(headPage)->tailPageNo = prevPageNo;
+	unpinPage(headPageNo, true);
+	return headPageNo;
+}
+
+void BTreeIndex::insertOverflowRid(PageId headPageNo, const RecordId rid) {
+	Page* headPage;
+	readPage(headPageNo, headPage);
+	PostingsOverflowPage* head = reinterpret_cast<PostingsOverflowPage*>(headPage);
+
+	// rids mostly arrive in heap order from the relation scan: try appending to the tail first
+	PageId pageNo = head->tailPageNo;
+	Page* page = headPage;
+	if (pageNo != headPageNo) readPage(pageNo, page);
+	PostingsOverflowPage* overflow = reinterpret_cast<PostingsOverflowPage*>(page);
+	if (overflow->numRids > 0 && ridLess(rid, overflow->ridArray[overflow->numRids-1])) {
+		// walk from the head to the first page whose last rid is not smaller than rid
+		if (pageNo != headPageNo) unpinPage(pageNo, false);
+		pageNo = headPageNo;
+		page = headPage;
+		overflow = head;
+		while (ridLess(overflow->ridArray[overflow->numRids-1], rid)) {
+			PageId nextPageNo = overflow->nextPageNo;
+			if (pageNo != headPageNo) unpinPage(pageNo, false);
+			pageNo = nextPageNo;
+			readPage(pageNo, page);
+			overflow = reinterpret_cast<PostingsOverflowPage*>(page);
+		}
+	}
+
+	if (overflow->numRids == (std::uint32_t) PostingsOverflowPage::SIZE) {
+		// split the page, moving its upper half to a new page after it
+		PageId newPageNo;
+		Page* newPage;
+		allocPage(newPageNo, newPage);
+		PostingsOverflowPage* newOverflow = reinterpret_cast<PostingsOverflowPage*>(newPage);
+		int mid = overflow->numRids / 2;
+		bool append = !ridLess(rid, overflow->ridArray[overflow->numRids-1]);
+		if (append) mid = overflow->numRids; // appending to the tail: leave the old page full
+		newOverflow->numRids = overflow->numRids - mid;
+		std::copy(overflow->ridArray + mid, overflow->ridArray + overflow->numRids, newOverflow->ridArray);
+		overflow->numRids = mid;
+		newOverflow->nextPageNo = overflow->nextPageNo;
+		newOverflow->tailPageNo = Page::INVALID_NUMBER;
+		overflow->nextPageNo = newPageNo;
+		if (head->tailPageNo == pageNo) head->tailPageNo = newPageNo;
+
+		if (append || !ridLess(rid, newOverflow->ridArray[0])) {
+			if (pageNo != headPageNo) unpinPage(pageNo, true);
+			pageNo = newPageNo;
+			overflow = newOverflow;
+		} else {
+			unpinPage(newPageNo, true);
+		}
+	}
+
+	RecordId* at = std::upper_bound(overflow->ridArray, overflow->ridArray + overflow->numRids, rid, ridLess);
+	std::copy_backward(at, overflow->ridArray + overflow->numRids, overflow->ridArray + overflow->numRids + 1);
+	*at = rid;
+	overflow->numRids++;
+
+	if (pageNo != headPageNo) unpinPage(pageNo, true);
+	unpinPage(headPageNo, true);
+}
+
+void BTreeIndex::insertNoSplit(NonLeafNodeInt* node, int i, const int newKey, const PageId newPageId) {
 	if (node->keyArray[i] == INT32_MAX) {
 			// insert without shift
 		node->keyArray[i] = newKey;
@@ -237,7 +898,7 @@ void BTreeIndex::insertNoSplit(NonLeafNodeInt* node, const int newKey, const Pag
 	} else { // shift and insert
 			// keys
 		int j;
-		for (j = INTARRAYNONLEAFSIZE-1; node->keyArray[j] == INT32_MAX; j--);
+		for (j = nodeOccupancy-1; node->keyArray[j] == INT32_MAX; j--);
 		for (; j >= i; j--) {
 			node->keyArray[j+1] = node->keyArray[j];
 			node->pageNoArray[j+2] = node->pageNoArray[j+1];
@@ -246,212 +907,1869 @@ void BTreeIndex::insertNoSplit(NonLeafNodeInt* node, const int newKey, const Pag
 		node->pageNoArray[i+1] = newPageId;
 
 	}
+	updateSummary(node, i);
 }
 
-void BTreeIndex::insertNonLeafInt(int &key, const RecordId rid, PageId &pageId) {
-	PageId result = Page::INVALID_NUMBER;
-	if (pageId == Page::INVALID_NUMBER) { // create new page
-		result = pageId = createNonLeafInt(1);
-		
+int BTreeIndex::findChildIndex(const NonLeafNodeInt* node, int key, bool upper) {
+	if (nonLeafFormat == NONLEAF_SUMMARY)
+		return summaryChildIndex(node, key, upper, nodeOccupancy);
+	return nonLeafChildIndex(node, key, upper, nodeOccupancy);
+}
+
+void BTreeIndex::updateSummary(NonLeafNodeInt* node, int from) {
+	if (nonLeafFormat != NONLEAF_SUMMARY) return;
+	int* summary = node->keyArray + nodeOccupancy;
+	for (int b = from / SUMMARYSTRIDE; b * SUMMARYSTRIDE < nodeOccupancy; b++) {
+		int first = node->keyArray[b * SUMMARYSTRIDE];
+		// past the last key both the keys and the summary are padding
+		if (first == INT32_MAX && summary[b] == INT32_MAX) break;
+		summary[b] = first;
 	}
-	
+}
+
+void BTreeIndex::insertNonLeafInt(int &key, const RecordId rid, PageId &pageId) {
 	Page* currPage;
-	bufMgr->readPage(file, pageId, currPage); // read current node
+	readPage(pageId, currPage); // read current node
+	BTREE_COUNT(nodesVisited, 1);
 	NonLeafNodeInt* node = reinterpret_cast<NonLeafNodeInt*>(currPage);
-	int i;
-	for (i = 0; i < INTARRAYNONLEAFSIZE && key > node->keyArray[i]; i++) ; //find index
+	int numKeys = nodeKeyCount(node, nodeOccupancy);
+	// postings lists must stay whole, so a key equal to a separator goes right, to its list
+	int i = insertAppend ? numKeys : findChildIndex(node, key, leafFormat == LEAF_POSTINGS); //find index
 	
-	PageId newPageId = node->pageNoArray[i];
+	// this node is on the rightmost (leftmost) path; its children are if i is the last (first) slot
+	bool rightmost = insertRightmost;
+	bool leftmost = insertLeftmost;
+	insertRightmost = rightmost && i == numKeys;
+	insertLeftmost = leftmost && i == 0;
+	if (i > 0) insertLowFence = node->keyArray[i-1];
+	if (i < numKeys) insertHighFence = node->keyArray[i];
+
+	PageId childPageId = node->pageNoArray[i];
+	PageId newPageId = childPageId;
 	if (node->level == 0) {
 		insertNonLeafInt(key, rid, newPageId);
 	} else {
+		lockNode(childPageId);
 		insertLeafInt(key, rid, newPageId);
-
+		unlockNode(childPageId);
 	} 
-	Page* splitPage;
-	PageId splitPageId;
-	if (newPageId != Page::INVALID_NUMBER) {
-		if (node->keyArray[INTARRAYNONLEAFSIZE-1] != INT32_MAX) {
-			// split
-			splitPageId = createNonLeafInt(node->level);
-			bufMgr->readPage(file, splitPageId, splitPage);
-			NonLeafNodeInt* newNode = reinterpret_cast<NonLeafNodeInt*>(splitPage);
-
-			int mid = INTARRAYNONLEAFSIZE / 2;
-			int newKey = node->keyArray[mid];  // key to be passed up
-			node->keyArray[mid] = INT32_MAX;
-			int j;
-			for (j = mid+1; j < INTARRAYNONLEAFSIZE; j++){
-				newNode->keyArray[(j-mid)-1] = node->keyArray[j];
-				node->keyArray[j] = INT32_MAX;
-			}
-			for (j = mid+1; j <= INTARRAYNONLEAFSIZE; j++) {
-				newNode->pageNoArray[(j-mid)-1] = node->pageNoArray[j];
-				node->pageNoArray[j] = Page::INVALID_NUMBER;
-			}
-			if (key > newNode->keyArray[0]) {
-				insertNoSplit(newNode, key, newPageId);
-			} else {
-				insertNoSplit(node, key, pageId);
-			}
-			pageId = splitPageId;
-			key = newKey;
-			bufMgr->unPinPage(file, splitPageId, true);
-			bufMgr->unPinPage(file, pageId, true);
-			return;
+	if (newPageId == Page::INVALID_NUMBER) { // child did not split
+		if (node->level == 1 && insertHint) {
+			hintLeafPageNum = node->pageNoArray[i];
+			hintLowFence = insertLowFence;
+			hintHighFence = insertHighFence;
 		}
-
-		insertNoSplit(node, key, newPageId);
-		bufMgr->unPinPage(file, pageId, true);
-		// bufMgr->unPinPage(file, newPageId, true);
+		unpinPage(pageId, false);
 		pageId = Page::INVALID_NUMBER;
-		
-		return ;
+		return;
 	}
-	bufMgr->unPinPage(file, pageId, true);
-	pageId = Page::INVALID_NUMBER;
-	return;
-}
-
-void BTreeIndex::insertEntryInt(const int key, const RecordId rid) 
-{
-	int newKey = key;
-	PageId pageId = rootPageNum;
-	insertNonLeafInt(newKey, rid, pageId);
-	if (pageId != Page::INVALID_NUMBER) { // new root created
-		PageId newRootPageId = createNonLeafInt(0);
-		Page* rootPage;
-		bufMgr->readPage(file, newRootPageId, rootPage);
-		NonLeafNodeInt* root = reinterpret_cast<NonLeafNodeInt*>(rootPage);
-		root->keyArray[0] = newKey;
-		root->pageNoArray[0] = rootPageNum;
-		root->pageNoArray[1] = pageId;
-		rootPageNum  = newRootPageId;
-		bufMgr->unPinPage(file, newRootPageId, true);
 
-		// update meta
-		Page* metaPage;
-		bufMgr->readPage(file, headerPageNum, metaPage);
-		IndexMetaInfo* metaData = reinterpret_cast<IndexMetaInfo*>(metaPage);
-		metaData->rootPageNo = rootPageNum;
-		bufMgr->unPinPage(file, headerPageNum, true);
+	// the child that split is unlocked already: until this node holds the separator to its new
+	// sibling, lookups get there through the right link of the child
+	lockNode(pageId);
+	if (numKeys < nodeOccupancy) {
+		insertNoSplit(node, i, key, newPageId);
+		unlockNode(pageId);
+		unpinPage(pageId, true);
+		pageId = Page::INVALID_NUMBER;
+		return;
 	}
+
+	splitNonLeafInt(node, i, key, newPageId, rightmost, leftmost);
+	unlockNode(pageId);
+	unpinPage(pageId, true);
+	pageId = newPageId;
 }
 
-// -----------------------------------------------------------------------------
-// BTreeIndex::startScan
-// -----------------------------------------------------------------------------
+void BTreeIndex::insertBufferedNonLeafInt(int &key, const RecordId rid, PageId &pageId) {
+	Page* currPage;
+	readPage(pageId, currPage);
+	BTREE_COUNT(nodesVisited, 1);
+	NonLeafNodeInt* node = reinterpret_cast<NonLeafNodeInt*>(currPage);
+	bool postings = leafFormat == LEAF_POSTINGS;
+	bool rightmost = insertRightmost;
+	bool leftmost = insertLeftmost;
 
-void BTreeIndex::startScan(const void* lowValParm,
-				   const Operator lowOpParm,
-				   const void* highValParm,
-				   const Operator highOpParm)
-{
-    if ((lowOpParm != GT && lowOpParm != GTE) || (highOpParm != LT && highOpParm != LTE))
-        throw BadOpcodesException();
+	if (bufferSize(node) == NONLEAFBUFFERSIZE) {
+		// flush the entries of the child that has the most of them, one batch for all of them
+		int numKeys = nodeKeyCount(node, nodeOccupancy);
+		int route[NONLEAFBUFFERSIZE];
+		std::vector<int> perChild(numKeys + 1);
+		for (int m = 0; m < NONLEAFBUFFERSIZE; m++) {
+			route[m] = findChildIndex(node, bufferMessage(node, m)->key, postings);
+			perChild[route[m]]++;
+		}
+		int flushChild = std::max_element(perChild.begin(), perChild.end()) - perChild.begin();
+		std::vector<BufferMessageInt> batch;
+		batch.reserve(perChild[flushChild]);
+		int kept = 0;
+		for (int m = 0; m < NONLEAFBUFFERSIZE; m++) {
+			BufferMessageInt message = *bufferMessage(node, m);
+			if (route[m] == flushChild) batch.push_back(message);
+			else *bufferMessage(node, kept++) = message;
+		}
+		bufferSize(node) = kept;
+		std::stable_sort(batch.begin(), batch.end(), messageKeyLess);
+		BTREE_COUNT(bufferFlushes, 1);
+		BTREE_COUNT(bufferMessagesFlushed, batch.size());
 
-    lowOp = lowOpParm;
-    highOp = highOpParm;
-    lowValInt = *((int*) lowValParm);
-    highValInt = *((int*) highValParm);
+		for (std::size_t b = 0; b < batch.size(); b++) {
+			// a split of the child may have moved the key to its new sibling
+			int i = findChildIndex(node, batch[b].key, postings);
+			int childKey = batch[b].key;
+			PageId childPageId = node->pageNoArray[i];
+			numKeys = nodeKeyCount(node, nodeOccupancy);
+			insertRightmost = rightmost && i == numKeys;
+			insertLeftmost = leftmost && i == 0;
+			if (node->level == 0)
+				insertBufferedNonLeafInt(childKey, batch[b].rid, childPageId);
+			else
+				insertLeafInt(childKey, batch[b].rid, childPageId);
+			if (childPageId == Page::INVALID_NUMBER)
+				continue;
+			if (numKeys < nodeOccupancy) {
+				insertNoSplit(node, i, childKey, childPageId);
+				continue;
+			}
 
-    if (lowValInt > highValInt)
-        throw BadScanrangeException();
+			// this node is full as well: the rest of the batch goes back into the buffer, which
+			// the split divides between the two halves
+			for (b++; b < batch.size(); b++) *bufferMessage(node, bufferSize(node)++) = batch[b];
+			splitNonLeafInt(node, i, childKey, childPageId, rightmost, leftmost);
+			if (postings ? key >= childKey : key > childKey) {
+				Page* splitPage;
+				readPage(childPageId, splitPage);
+				NonLeafNodeInt* splitNode = reinterpret_cast<NonLeafNodeInt*>(splitPage);
+				*bufferMessage(splitNode, bufferSize(splitNode)++) = { key, rid };
+				unpinPage(childPageId, true);
+			} else {
+				*bufferMessage(node, bufferSize(node)++) = { key, rid };
+			}
+			unpinPage(pageId, true);
+			pageId = childPageId;
+			key = childKey;
+			return;
+		}
+	}
 
-	scanExecuting = true;
+	*bufferMessage(node, bufferSize(node)++) = { key, rid };
+	unpinPage(pageId, true);
+	pageId = Page::INVALID_NUMBER;
+}
 
-    Page* leafPage;
-	PageId leafPageId;
-	Page* rootPage;
-	bufMgr->readPage(file, rootPageNum, rootPage);
-	traverse(rootPage, ((NonLeafNodeInt*) rootPage)->level, lowValParm, leafPageId);
-	bufMgr->unPinPage(file, rootPageNum, false);
-	bufMgr->readPage(file, leafPageId, leafPage);
+void BTreeIndex::splitNonLeafInt(NonLeafNodeInt* node, int i, int &key, PageId &newPageId, bool rightmost, bool leftmost) {
+	// lay out the full node plus the new separator and child in order
+	int keys[INTARRAYNONLEAFSIZE + 1];
+	PageId children[INTARRAYNONLEAFSIZE + 2];
+	std::copy(node->keyArray, node->keyArray + i, keys);
+	std::copy(node->keyArray + i, node->keyArray + nodeOccupancy, keys + i + 1);
+	std::copy(node->pageNoArray, node->pageNoArray + i + 1, children);
+	std::copy(node->pageNoArray + i + 1, node->pageNoArray + nodeOccupancy + 1, children + i + 2);
+	keys[i] = key;
+	children[i+1] = newPageId;
 
-	LeafNodeInt* leaf = reinterpret_cast<LeafNodeInt*>(leafPage);
-    currentPageNum = leafPageId;
+	// the left node keeps keys [0, mid) and their children, keys[mid] is passed up
+	int mid = splitPoint(nodeOccupancy + 1, nodeOccupancy, i, rightmost, leftmost);
+	if (mid == nodeOccupancy) mid--; // the right node needs at least one child besides the new one
 
-	bool foundFlag = false;
-	while(!foundFlag) {
-		
-		for(int i = 0; i < leafOccupancy; i++) {
- 
-			if(leaf->keyArray[i] != INT32_MAX && 
-				((lowOp == GT && leaf->keyArray[i] > lowValInt) || (lowOp == GTE && leaf->keyArray[i] >= lowValInt)) && 
-				((highOp == LT && leaf->keyArray[i] < highValInt) || (highOp == LTE && leaf->keyArray[i] <= highValInt))) {
-						
-                currentPageData = leafPage;
-				currentPageNum = leafPageId;
-				nextEntry = i;
-				foundFlag = true;
-				break;
-			} 
+	Page* splitPage;
+	PageId splitPageId = createNonLeafInt(node->level);
+	readPage(splitPageId, splitPage);
+	NonLeafNodeInt* newNode = reinterpret_cast<NonLeafNodeInt*>(splitPage);
+	std::copy(keys + mid + 1, keys + nodeOccupancy + 1, newNode->keyArray);
+	std::copy(children + mid + 1, children + nodeOccupancy + 2, newNode->pageNoArray);
+	std::copy(keys, keys + mid, node->keyArray);
+	std::fill(node->keyArray + mid, node->keyArray + nodeOccupancy, INT32_MAX);
+	std::copy(children, children + mid + 1, node->pageNoArray);
+	std::fill(node->pageNoArray + mid + 1, node->pageNoArray + nodeOccupancy + 1, Page::INVALID_NUMBER);
+	newNode->rightSibPageNo = node->rightSibPageNo;
+	newNode->highKey = node->highKey;
+	node->rightSibPageNo = splitPageId;
+	node->highKey = keys[mid];
+	updateSummary(node, 0);
+	updateSummary(newNode, 0);
+	if (nonLeafFormat == NONLEAF_BUFFERED) {
+		// buffered entries that the parent will route past the separator move with their keys
+		int kept = 0;
+		for (int m = 0; m < bufferSize(node); m++) {
+			BufferMessageInt message = *bufferMessage(node, m);
+			if (leafFormat == LEAF_POSTINGS ? message.key >= keys[mid] : message.key > keys[mid])
+				*bufferMessage(newNode, bufferSize(newNode)++) = message;
+			else
+				*bufferMessage(node, kept++) = message;
 		}
+		bufferSize(node) = kept;
+	}
 
-		if(!foundFlag) {
-			if(leaf->rightSibPageNo != NULL) {
-				PageId nextPageId = leaf->rightSibPageNo;
-				bufMgr->unPinPage(file, leafPageId, false);
-				bufMgr->readPage(file, nextPageId, leafPage);
-					
-				leafPageId = nextPageId;
-				leaf = (LeafNodeInt*) leafPage;
-			} else {
-				bufMgr->unPinPage(file, leafPageId, false);
+	unpinPage(splitPageId, true);
+	BTREE_COUNT(nonLeafSplits, 1);
+	newPageId = splitPageId;
+	key = keys[mid];
+}
 
-				nextEntry = 0;
-				foundFlag = true; 
-                throw NoSuchKeyFoundException();
-            }
-        }
-    }
+int BTreeIndex::splitPoint(int total, int capacity, int pos, bool rightmost, bool leftmost) const {
+	int keep = capacity * fillFactor / 100;
+	if (rightmost && pos == total - 1)
+		return std::max(1, std::min(total - 1, keep));
+	if (leftmost && pos == 0)
+		return std::max(1, std::min(total - 1, total - keep));
+	return total / 2;
+}
+
+void BTreeIndex::readPage(PageId pageNo, Page*& page) {
+	if (arena != nullptr) {
+		page = arena->page(pageNo);
+		BTREE_COUNT(pins, 1);
+		if (optimisticReads) {
+			OptimisticNode* node = olcNode(pageNo, true);
+			if (node != nullptr && node->page.load(std::memory_order_relaxed) == nullptr)
+				node->page.store(page, std::memory_order_release);
+		}
+		return;
+	}
+#ifndef BTREE_NO_COUNTERS
+	int diskReads = bufMgr->getBufStats().diskreads;
+	bufMgr->readPage(file, pageNo, page);
+	counters.pins++;
+	counters.bufferMisses += bufMgr->getBufStats().diskreads - diskReads;
+#else
+	bufMgr->readPage(file, pageNo, page);
+#endif
+	if (optimisticReads) {
+		OptimisticNode* node = olcNode(pageNo, true);
+		if (node != nullptr && node->page.load(std::memory_order_relaxed) == nullptr) {
+			// the node table holds a pin of its own, so the frame stays put until flushIndexFile()
+			Page* pinned;
+			bufMgr->readPage(file, pageNo, pinned);
+			node->page.store(pinned, std::memory_order_release);
+		}
+	}
+}
+
+void BTreeIndex::flushIndexFile() {
+	for (int c = 0; olcChunks != nullptr && c < OLCMAXCHUNKS; c++) {
+		OptimisticNode* chunk = olcChunks[c].load(std::memory_order_relaxed);
+		for (int j = 0; chunk != nullptr && j < OLCCHUNKSIZE; j++) {
+			if (chunk[j].page.load(std::memory_order_relaxed) == nullptr) continue;
+			unpinPage(c * OLCCHUNKSIZE + j, false);
+			chunk[j].page.store(nullptr, std::memory_order_relaxed);
+		}
+	}
+	if (file != nullptr) bufMgr->flushFile(file);
+}
+
+void BTreeIndex::unpinPage(PageId pageNo, bool dirty) {
+	if (arena == nullptr) bufMgr->unPinPage(file, pageNo, dirty);
+}
+
+void BTreeIndex::allocPage(PageId& pageNo, Page*& page) {
+	if (arena != nullptr) {
+		arena->allocate(pageNo, page);
+		return;
+	}
+	bufMgr->allocPage(file, pageNo, page);
+	numIndexPages++;
+}
+
+void BTreeIndex::readScanLeaf(PageId pageNo, Page*& page) {
+	scanLeavesRead++;
+	currentPageInRing = useScanRing && fileInSync && scanLeavesRead > SCANRINGTHRESHOLD;
+	if (!currentPageInRing) {
+		readPage(pageNo, page);
+		return;
+	}
+	Page& slot = scanRing[scanRingNext];
+	scanRingNext = (scanRingNext + 1) % SCANRINGSIZE;
+	slot = file->readPage(pageNo);
+	page = &slot;
+	BTREE_COUNT(scanRingReads, 1);
+}
+
+void BTreeIndex::releaseScanLeaf(PageId pageNo) {
+	if (!currentPageInRing)
+		unpinPage(pageNo, false);
+}
+
+bool BTreeIndex::insertIntoHintLeaf(int key, const RecordId rid) {
+	if (hintLeafPageNum == Page::INVALID_NUMBER)
+		return false;
+	// same routing of keys equal to a separator as the descent in insertNonLeafInt; an append
+	// belongs in the rightmost leaf even when it equals the separator left of it
+	if (!insertAppend && (leafFormat == LEAF_POSTINGS ? key < hintLowFence || key >= hintHighFence
+			: key <= hintLowFence || key > hintHighFence))
+		return false;
+
+	Page* page;
+	readPage(hintLeafPageNum, page);
+	if (!leafHasRoom(page, key)) { // the split has to reach the parent, which only a full descent knows
+		unpinPage(hintLeafPageNum, false);
+		return false;
+	}
+
+	int newKey = key;
+	PageId pageId = hintLeafPageNum;
+	lockNode(hintLeafPageNum);
+	insertLeafInt(newKey, rid, pageId, page);
+	unlockNode(hintLeafPageNum);
+	return true;
+}
+
+bool BTreeIndex::leafHasRoom(const Page* page, int key) const {
+	if (leafFormat == LEAF_COMPRESSED) {
+		const CompressedLeafNodeInt* node = reinterpret_cast<const CompressedLeafNodeInt*>(page);
+		int n = node->numEntries;
+		if (n + 1 > INTARRAYCOMPRESSEDLEAFSIZE)
+			return false;
+		// the new key may widen the key range past 16 bit offsets, and its rid may split a rid run
+		// in two around a run of its own
+		std::int64_t low = key, high = key;
+		if (n > 0) {
+			const char* offsets = node->data + node->numRuns * sizeof(RidRun);
+			std::uint32_t lastOffset = node->keyBytes == sizeof(std::uint16_t)
+				? reinterpret_cast<const std::uint16_t*>(offsets)[n-1] : reinterpret_cast<const std::uint32_t*>(offsets)[n-1];
+			low = std::min<std::int64_t>(key, node->baseKey);
+			high = std::max<std::int64_t>(key, (std::int64_t) node->baseKey + lastOffset);
+		}
+		int keyBytes = high - low <= UINT16_MAX ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+		return (node->numRuns + 2) * (int) sizeof(RidRun) + (n + 1) * (keyBytes + (int) sizeof(SlotId)) <= CompressedLeafNodeInt::DATASIZE;
+	}
+	if (leafFormat == LEAF_POSTINGS) {
+		const PostingsLeafNodeInt* node = reinterpret_cast<const PostingsLeafNodeInt*>(page);
+		return (node->numPostings + 1) * (int) sizeof(PostingInt) + (node->numRids + 1) * (int) sizeof(RecordId) <= PostingsLeafNodeInt::DATASIZE;
+	}
+	return reinterpret_cast<const LeafNodeInt*>(page)->keyArray[INTARRAYLEAFSIZE-1] == INT32_MAX;
+}
+
+void BTreeIndex::insertEntryInt(const int key, const RecordId rid) 
+{
+	if (onlineBuilding.load(std::memory_order_acquire)) {
+		std::lock_guard<std::mutex> sideLogLock(sideLogMutex);
+		// finishBuild() clears the flag under the lock once the side-log is applied
+		if (onlineBuilding.load(std::memory_order_relaxed)) {
+			sideLog.emplace_back(key, rid);
+			return;
+		}
+	}
+	insertIntoIndex(key, rid);
+}
+
+void BTreeIndex::insertIntoIndex(const int key, const RecordId rid)
+{
+	checkScanIdle();
+	std::unique_lock<std::mutex> writeLock(olcWriteMutex, std::defer_lock);
+	if (optimisticReads) writeLock.lock();
+	if (metaComplete) saveMetaState(false);
+	numTuples++;
+	std::uint64_t start = timingStart();
+	if (deltaCapacity > 0) {
+		delta.emplace(key, rid);
+		// a merge would move the entries of the delta a scan is returning
+		if ((int) delta.size() >= deltaCapacity && !scanExecuting)
+			mergeDelta();
+	} else {
+		insertIntoTree(key, rid);
+	}
+	timingEnd(INSERT_OP, start);
+}
+
+void BTreeIndex::checkScanIdle() const
+{
+	// the scan reads its leaf in place and has its entry count and right link, which an insert
+	// into the tree would leave stale; inserts into the delta leave the tree alone
+	if (scanExecuting && deltaCapacity == 0)
+		throw PagePinnedException(indexFileName, currentPageNum, 0);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::buildStep
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::buildStep(int maxPages)
+{
+	if (buildScan == nullptr)
+		return false;
+	checkScanIdle();
+	int pages = 0;
+	maxPages = std::max(1, maxPages);
+	if (buildPending) {
+		buildPending = false;
+		insertIntoIndex(buildPendingKey, buildPendingRid);
+	}
+	try {
+		RecordId scanRid;
+		while (1)
+		{
+			buildScan->scanNext(scanRid);
+			std::string recordStr = buildScan->getRecord();
+			int key = *(const int*) (recordStr.c_str() + buildAttrOffset);
+			if (scanRid.page_number != buildPageNo) {
+				// the record opens a page past this step: keep it for the next one
+				if (pages == maxPages) {
+					buildPending = true;
+					buildPendingKey = key;
+					buildPendingRid = scanRid;
+					return true;
+				}
+				pages++;
+				buildPageNo = scanRid.page_number;
+				BTREE_COUNT(buildPages, 1);
+				if (buildPagesPerSecond > 0) {
+					buildReadPages++;
+					std::this_thread::sleep_until(buildStartTime
+						+ std::chrono::microseconds(buildReadPages * 1000000 / buildPagesPerSecond));
+				}
+			}
+			insertIntoIndex(key, scanRid);
+		}
+	}
+	catch(const EndOfFileException &e)
+	{
+	}
+	delete buildScan;
+	buildScan = nullptr;
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::finishBuild
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::finishBuild()
+{
+	if (!onlineBuilding.load(std::memory_order_acquire))
+		return;
+	checkScanIdle();
+	while (buildStep(INT32_MAX))
+		;
+	std::vector<std::pair<int, RecordId>> entries;
+	while (true) {
+		{
+			std::lock_guard<std::mutex> sideLogLock(sideLogMutex);
+			if ((int) sideLog.size() <= BUILDCATCHUPENTRIES)
+				break;
+			entries.swap(sideLog);
+		}
+		// writers go on appending while this round is applied
+		applySideLog(entries);
+		entries.clear();
+	}
+	std::lock_guard<std::mutex> sideLogLock(sideLogMutex);
+	BTREE_COUNT(finalCatchUpEntries, sideLog.size());
+	applySideLog(sideLog);
+	sideLog = std::vector<std::pair<int, RecordId>>();
+	onlineBuilding.store(false, std::memory_order_release);
+}
+
+void BTreeIndex::applySideLog(const std::vector<std::pair<int, RecordId>>& entries)
+{
+	// records inserted during the build on pages the scan had yet to read are in the index already
+	std::vector<int> keys;
+	keys.reserve(entries.size());
+	for (const std::pair<int, RecordId>& entry : entries)
+		keys.push_back(entry.first);
+	std::vector<std::vector<RecordId>> found;
+	probeInterleaved(keys, found);
+	for (std::size_t i = 0; i < entries.size(); i++) {
+		if (std::find(found[i].begin(), found[i].end(), entries[i].second) != found[i].end())
+			continue;
+		insertIntoIndex(entries[i].first, entries[i].second);
+	}
+	BTREE_COUNT(sideLogApplied, entries.size());
+}
+
+void BTreeIndex::mergeDelta()
+{
+	if (delta.empty() || scanExecuting)
+		return;
+	BTREE_COUNT(deltaMerges, 1);
+	BTREE_COUNT(deltaEntriesMerged, delta.size());
+	// in key order, runs of entries for the same leaf go in through the insert hint
+	for (const std::pair<const int, RecordId>& entry : delta)
+		insertIntoTree(entry.first, entry.second);
+	delta.clear();
+}
+
+void BTreeIndex::deltaRange(int lowVal, Operator lowOp, int highVal, Operator highOp,
+		std::multimap<int, RecordId>::const_iterator& begin, std::multimap<int, RecordId>::const_iterator& end) const
+{
+	end = highOp == LTE ? delta.upper_bound(highVal) : delta.lower_bound(highVal);
+	begin = lowOp == GTE ? delta.lower_bound(lowVal) : delta.upper_bound(lowVal);
+	// an empty range such as (5, 5) would put begin past end
+	if (begin == delta.end() || !keyInRange(begin->first, lowVal, lowOp, highVal, highOp))
+		begin = end;
+}
+
+void BTreeIndex::deltaLookup(int key, std::vector<RecordId>& rids) const
+{
+	if (delta.empty())
+		return;
+	std::pair<std::multimap<int, RecordId>::const_iterator, std::multimap<int, RecordId>::const_iterator> range
+		= delta.equal_range(key);
+	for (std::multimap<int, RecordId>::const_iterator it = range.first; it != range.second; ++it)
+		rids.push_back(it->second);
+}
+
+void BTreeIndex::applyBuffers(int low, int high)
+{
+	if (nonLeafFormat != NONLEAF_BUFFERED)
+		return;
+	std::vector<BufferMessageInt> messages;
+	takeBufferedRange(rootPageNum, low, high, messages);
+	if (messages.empty())
+		return;
+	BTREE_COUNT(bufferFlushes, 1);
+	BTREE_COUNT(bufferMessagesFlushed, messages.size());
+
+	// in key order, runs of entries for the same leaf go in through the insert hint
+	std::stable_sort(messages.begin(), messages.end(), messageKeyLess);
+	bool buffering = bufferInserts;
+	bufferInserts = false;
+	for (const BufferMessageInt& message : messages)
+		insertIntoTree(message.key, message.rid);
+	bufferInserts = buffering;
+	// flushes of the buffers split leaves without moving the hint
+	hintLeafPageNum = Page::INVALID_NUMBER;
+}
+
+void BTreeIndex::takeBufferedRange(PageId pageNo, int low, int high, std::vector<BufferMessageInt>& messages)
+{
+	Page* page;
+	readPage(pageNo, page);
+	NonLeafNodeInt* node = reinterpret_cast<NonLeafNodeInt*>(page);
+	int numMessages = bufferSize(node);
+	int kept = 0;
+	for (int m = 0; m < numMessages; m++) {
+		BufferMessageInt message = *bufferMessage(node, m);
+		if (message.key >= low && message.key <= high) messages.push_back(message);
+		else *bufferMessage(node, kept++) = message;
+	}
+	bufferSize(node) = kept;
+	if (node->level == 0) {
+		// every child that either descent routes a key in [low, high] to
+		int last = findChildIndex(node, high, true);
+		for (int i = findChildIndex(node, low, false); i <= last; i++)
+			takeBufferedRange(node->pageNoArray[i], low, high, messages);
+	}
+	unpinPage(pageNo, kept != numMessages);
+}
+
+void BTreeIndex::bufferLookup(const NonLeafNodeInt* node, int key, std::vector<RecordId>& rids) const
+{
+	if (nonLeafFormat != NONLEAF_BUFFERED)
+		return;
+	// the buffer is in insert order; it fits in a page, so a pass over it costs no more than a read
+	for (int m = 0; m < bufferSize(node); m++) {
+		const BufferMessageInt* message = bufferMessage(node, m);
+		if (message->key == key) rids.push_back(message->rid);
+	}
+}
+
+void BTreeIndex::insertIntoTree(const int key, const RecordId rid)
+{
+	fileInSync = false;
+	if (!bufferInserts && insertIntoHintLeaf(key, rid)) {
+		BTREE_COUNT(hintHits, 1);
+		return;
+	}
+
+	BTREE_COUNT(descents, 1);
+	int newKey = key;
+	PageId pageId = rootPageNum;
+	insertRightmost = true;
+	insertLeftmost = true;
+	insertLowFence = INT64_MIN;
+	insertHighFence = INT64_MAX;
+	hintLeafPageNum = Page::INVALID_NUMBER;
+	if (bufferInserts)
+		insertBufferedNonLeafInt(newKey, rid, pageId);
+	else
+		insertNonLeafInt(newKey, rid, pageId);
+	if (pageId != Page::INVALID_NUMBER) { // new root created
+		PageId newRootPageId = createNonLeafInt(0);
+		Page* rootPage;
+		readPage(newRootPageId, rootPage);
+		NonLeafNodeInt* root = reinterpret_cast<NonLeafNodeInt*>(rootPage);
+		root->keyArray[0] = newKey;
+		root->pageNoArray[0] = rootPageNum;
+		root->pageNoArray[1] = pageId;
+		updateSummary(root, 0);
+		// lookups still starting at the old root move right from it
+		__atomic_store_n(&rootPageNum, newRootPageId, __ATOMIC_RELEASE);
+		unpinPage(newRootPageId, true);
+
+		// update meta
+		Page* metaPage;
+		readPage(headerPageNum, metaPage);
+		IndexMetaInfo* metaData = reinterpret_cast<IndexMetaInfo*>(metaPage);
+		metaData->rootPageNo = rootPageNum;
+		unpinPage(headerPageNum, true);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startScan
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::startScan(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm)
+{
+    if ((lowOpParm != GT && lowOpParm != GTE) || (highOpParm != LT && highOpParm != LTE))
+        throw BadOpcodesException();
+
+    lowOp = lowOpParm;
+    highOp = highOpParm;
+    lowValInt = *((int*) lowValParm);
+    highValInt = *((int*) highValParm);
+
+    if (lowValInt > highValInt)
+        throw BadScanrangeException();
+
+	if (scanExecuting)
+		endScan();
+	std::uint64_t start = timingStart();
+	scanRanges.clear();
+	applyBuffers(lowValInt, highValInt);
+	scanExecuting = true;
+	deltaRange(lowValInt, lowOp, highValInt, highOp, scanDeltaNext, scanDeltaEnd);
+
+    Page* leafPage;
+	PageId leafPageId;
+	Page* rootPage;
+	BTREE_COUNT(descents, 1);
+	readPage(rootPageNum, rootPage);
+	traverse(rootPage, ((NonLeafNodeInt*) rootPage)->level, lowValParm, leafPageId);
+	unpinPage(rootPageNum, false);
+	readPage(leafPageId, leafPage);
+	BTREE_COUNT(nodesVisited, 1);
+	scanLeavesRead = 1;
+	currentPageInRing = false;
+	loadScanLeaf(leafPage);
+
+	int i;
+	while(true) {
+		// first entry above the low end of the range
+		i = (lowOp == GTE ? std::lower_bound(scanKeys, scanKeys + scanCount, lowValInt)
+				: std::upper_bound(scanKeys, scanKeys + scanCount, lowValInt)) - scanKeys;
+		if(i < scanCount) {
+			if((highOp == LT && scanKeys[i] < highValInt) || (highOp == LTE && scanKeys[i] <= highValInt)) {
+				currentPageData = leafPage;
+				currentPageNum = leafPageId;
+				nextEntry = i;
+				timingEnd(STARTSCAN_OP, start);
+				return;
+			}
+			// the smallest candidate is already past the high end
+			break;
+		}
+
+		if(scanRightSibPageNo == Page::INVALID_NUMBER)
+			break;
+		PageId nextPageId = scanRightSibPageNo;
+		releaseScanLeaf(leafPageId);
+		readScanLeaf(nextPageId, leafPage);
+		BTREE_COUNT(siblingHops, 1);
+		leafPageId = nextPageId;
+		loadScanLeaf(leafPage);
+	}
+
+	if (scanDeltaNext != scanDeltaEnd) {
+		// only the delta has entries in range; the scan stays on the leaf where the tree ran out
+		currentPageData = leafPage;
+		currentPageNum = leafPageId;
+		nextEntry = i;
+		timingEnd(STARTSCAN_OP, start);
+		return;
+	}
+	releaseScanLeaf(leafPageId);
+	scanExecuting = false;
+	currentPageNum = Page::INVALID_NUMBER;
+	nextEntry = 0;
+	throw NoSuchKeyFoundException();
+}
+
+void BTreeIndex::loadScanLeaf(Page* page)
+{
+	scanCount = decodeLeaf(page, scanKeys, scanRids, scanRightSibPageNo, scanKeyBuf.data(), scanRidBuf.data());
+}
+
+int BTreeIndex::decodeLeaf(Page* page, const int*& keys, const RecordId*& rids, PageId& rightSibPageNo,
+		int* keyBuf, RecordId* ridBuf) const
+{
+	if (leafFormat == LEAF_COMPRESSED) {
+		CompressedLeafNodeInt* node = reinterpret_cast<CompressedLeafNodeInt*>(page);
+		keys = keyBuf;
+		rids = ridBuf;
+		rightSibPageNo = node->rightSibPageNo;
+		return decodeCompressedLeaf(node, keyBuf, ridBuf);
+	} else if (leafFormat == LEAF_POSTINGS) {
+		PostingsLeafNodeInt* node = reinterpret_cast<PostingsLeafNodeInt*>(page);
+		const PostingInt* postings = reinterpret_cast<const PostingInt*>(node->data);
+		const RecordId* postingRids = reinterpret_cast<const RecordId*>(node->data + node->numPostings * sizeof(PostingInt));
+		int count = 0;
+		for (int i = 0; i < node->numPostings; i++) {
+			if (postings[i].overflowPageNo != Page::INVALID_NUMBER) {
+				keyBuf[count] = postings[i].key;
+				ridBuf[count].page_number = postings[i].overflowPageNo;
+				ridBuf[count].slot_number = Page::INVALID_SLOT;
+				count++;
+				continue;
+			}
+			std::fill(keyBuf + count, keyBuf + count + postings[i].numRids, postings[i].key);
+			std::copy(postingRids, postingRids + postings[i].numRids, ridBuf + count);
+			postingRids += postings[i].numRids;
+			count += postings[i].numRids;
+		}
+		keys = keyBuf;
+		rids = ridBuf;
+		rightSibPageNo = node->rightSibPageNo;
+		return count;
+	} else {
+		LeafNodeInt* node = reinterpret_cast<LeafNodeInt*>(page);
+		keys = node->keyArray;
+		rids = node->ridArray;
+		rightSibPageNo = node->rightSibPageNo;
+		return nodeKeyCount(node);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNext
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::scanNext(RecordId& outRid) 
+{
+	scanNextBatch(&outRid, 1);
+}
+
+bool BTreeIndex::keyInScanRange(int key) const
+{
+	return keyInRange(key, lowValInt, lowOp, highValInt, highOp);
+}
+
+int BTreeIndex::scanNextBatch(RecordId* outRids, int maxRids)
+{
+	if (!scanExecuting) {
+        throw ScanNotInitializedException();
+    }
+
+	std::uint64_t start = timingStart();
+	int n = 0;
+	while (n < maxRids) {
+		if (overflowPageNum != Page::INVALID_NUMBER) {
+			// inside a spilled postings list: copy what is left of the overflow page
+			PostingsOverflowPage* overflow = reinterpret_cast<PostingsOverflowPage*>(overflowPageData);
+			int take = std::min<int>(maxRids - n, overflow->numRids - overflowEntry);
+			std::copy(overflow->ridArray + overflowEntry, overflow->ridArray + overflowEntry + take, outRids + n);
+			n += take;
+			overflowEntry += take;
+			if (overflowEntry == (int) overflow->numRids) {
+				PageId nextPageNo = overflow->nextPageNo;
+				unpinPage(overflowPageNum, false);
+				overflowPageNum = nextPageNo;
+				overflowEntry = 0;
+				if (overflowPageNum != Page::INVALID_NUMBER)
+					readPage(overflowPageNum, overflowPageData);
+				else
+					nextEntry++; // done with this list
+			}
+			continue;
+		}
+
+		if (nextEntry == scanCount && scanRightSibPageNo != Page::INVALID_NUMBER) {
+			scanNextLeaf();
+			continue;
+		}
+
+		// check for matching rid
+		bool treeInRange = nextEntry < scanCount && keyInScanRange(scanKeys[nextEntry]);
+		if (scanDeltaNext != scanDeltaEnd && (!treeInRange || scanDeltaNext->first < scanKeys[nextEntry])) {
+			outRids[n++] = scanDeltaNext->second;
+			++scanDeltaNext;
+			continue;
+		}
+		if (!treeInRange) {
+			if (scanRangeIndex + 1 >= scanRanges.size())
+				break;
+			enterScanRange(scanRangeIndex + 1);
+			continue;
+		}
+
+		if (scanRids[nextEntry].slot_number == Page::INVALID_SLOT) {
+			overflowPageNum = scanRids[nextEntry].page_number;
+			overflowEntry = 0;
+			readPage(overflowPageNum, overflowPageData);
+			continue;
+		}
+
+		// copy the run of matching in-leaf entries
+		int end = nextEntry;
+		int deltaKey = scanDeltaNext != scanDeltaEnd ? scanDeltaNext->first : INT32_MAX;
+		while (end < scanCount && end - nextEntry < maxRids - n && keyInScanRange(scanKeys[end])
+				&& scanRids[end].slot_number != Page::INVALID_SLOT && scanKeys[end] <= deltaKey)
+			end++;
+		std::copy(scanRids + nextEntry, scanRids + end, outRids + n);
+		n += end - nextEntry;
+		nextEntry = end;
+	}
+
+	if (n == 0) {
+		throw IndexScanCompletedException();
+	}
+	BTREE_COUNT(scanEntries, n);
+	timingEnd(SCANNEXT_OP, start);
+	return n;
+}
+
+void BTreeIndex::scanNextLeaf()
+{
+	// found page to read; look for sibling
+	// manage buffer
+	releaseScanLeaf(currentPageNum);
+	currentPageNum = scanRightSibPageNo;
+	readScanLeaf(currentPageNum, currentPageData);
+	BTREE_COUNT(siblingHops, 1);
+	loadScanLeaf(currentPageData);
+	nextEntry = 0;
+}
+
+bool BTreeIndex::scanPeekKey(int& key)
+{
+	if (overflowPageNum != Page::INVALID_NUMBER) {
+		// inside a spilled postings list, which stays at its entry of the leaf
+		key = scanKeys[nextEntry];
+		return true;
+	}
+	while (true) {
+		while (nextEntry == scanCount && scanRightSibPageNo != Page::INVALID_NUMBER)
+			scanNextLeaf();
+		bool treeInRange = nextEntry < scanCount && keyInScanRange(scanKeys[nextEntry]);
+		if (scanDeltaNext != scanDeltaEnd && (!treeInRange || scanDeltaNext->first < scanKeys[nextEntry])) {
+			key = scanDeltaNext->first;
+			return true;
+		}
+		if (treeInRange) {
+			key = scanKeys[nextEntry];
+			return true;
+		}
+		if (scanRangeIndex + 1 >= scanRanges.size())
+			return false;
+		enterScanRange(scanRangeIndex + 1);
+	}
+}
+
+void BTreeIndex::enterScanRange(std::size_t i)
+{
+	scanRangeIndex = i;
+	const ScanRange& range = scanRanges[i];
+	lowValInt = range.lowVal;
+	lowOp = range.lowOp;
+	highValInt = range.highVal;
+	highOp = range.highOp;
+	deltaRange(lowValInt, lowOp, highValInt, highOp, scanDeltaNext, scanDeltaEnd);
+	// (INT32_MAX, ...) is empty, which the range check finds at any entry
+	scanSkipTo(lowOp == GT && lowValInt < INT32_MAX ? lowValInt + 1 : lowValInt);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startMultiScan
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::startMultiScan(const std::vector<ScanRange>& ranges)
+{
+	if (ranges.empty())
+		throw BadScanrangeException();
+	for (std::size_t i = 0; i < ranges.size(); i++) {
+		const ScanRange& range = ranges[i];
+		if ((range.lowOp != GT && range.lowOp != GTE) || (range.highOp != LT && range.highOp != LTE))
+			throw BadOpcodesException();
+		if (range.lowVal > range.highVal)
+			throw BadScanrangeException();
+		// ranges touching at a key would return its entries twice
+		if (i > 0 && (range.lowVal < ranges[i-1].highVal
+				|| (range.lowVal == ranges[i-1].highVal && range.lowOp == GTE && ranges[i-1].highOp == LTE)))
+			throw BadScanrangeException();
+	}
+
+	// one descent to the first key of the span of all ranges, then a skip to each range
+	startScan(&ranges.front().lowVal, ranges.front().lowOp, &ranges.back().highVal, ranges.back().highOp);
+	scanRanges = ranges;
+	enterScanRange(0);
+	int key;
+	if (!scanPeekKey(key)) {
+		endScan();
+		throw NoSuchKeyFoundException();
+	}
+}
+
+void BTreeIndex::startInListScan(std::vector<int> keys)
+{
+	if (keys.empty())
+		throw BadScanrangeException();
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	std::vector<ScanRange> ranges;
+	ranges.reserve(keys.size());
+	for (int key : keys)
+		ranges.push_back(ScanRange{ key, GTE, key, LTE });
+	startMultiScan(ranges);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNextEntry
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::scanNextEntry(int& outKey, RecordId& outRid)
+{
+	if (!scanExecuting)
+		throw ScanNotInitializedException();
+	if (!scanPeekKey(outKey))
+		throw IndexScanCompletedException();
+	scanNextBatch(&outRid, 1);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanSkipTo
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::scanSkipTo(int key)
+{
+	if (!scanExecuting)
+		throw ScanNotInitializedException();
+
+	if (scanDeltaNext != scanDeltaEnd && scanDeltaNext->first < key) {
+		// scanDeltaEnd is the first delta entry of its key, so a skip past that key ends at it
+		std::multimap<int, RecordId>::const_iterator skipped = delta.lower_bound(key);
+		bool pastEnd = scanDeltaEnd != delta.end() && (skipped == delta.end() || skipped->first >= scanDeltaEnd->first);
+		scanDeltaNext = pastEnd ? scanDeltaEnd : skipped;
+	}
+
+	if (overflowPageNum != Page::INVALID_NUMBER) {
+		if (scanKeys[nextEntry] >= key)
+			return;
+		// the rest of the spilled postings list is skipped
+		unpinPage(overflowPageNum, false);
+		overflowPageNum = Page::INVALID_NUMBER;
+		nextEntry++;
+	}
+	if (nextEntry < scanCount && scanKeys[nextEntry] >= key)
+		return;
+
+	if ((nextEntry == scanCount || scanKeys[scanCount-1] < key) && scanRightSibPageNo != Page::INVALID_NUMBER) {
+		// a key just past this leaf is in the next one: try it before a descent
+		scanNextLeaf();
+	}
+	if (nextEntry < scanCount && scanKeys[scanCount-1] >= key) {
+		// gallop: double the step until it passes key, then search the last step
+		int step = 1;
+		while (nextEntry + step < scanCount && scanKeys[nextEntry + step] < key)
+			step *= 2;
+		nextEntry = std::lower_bound(scanKeys + nextEntry + step / 2, scanKeys + std::min(nextEntry + step, scanCount - 1), key)
+				- scanKeys;
+		return;
+	}
+	if (scanRightSibPageNo == Page::INVALID_NUMBER) {
+		nextEntry = scanCount;
+		return;
+	}
+
+	// key is past the next leaf too: descend to its leaf; scanNextBatch() moves on from there if
+	// the leaf holds no key of at least key
+	BTREE_COUNT(skipDescents, 1);
+	BTREE_COUNT(descents, 1);
+	releaseScanLeaf(currentPageNum);
+	Page* rootPage;
+	PageId rootPageNo = rootPageNum;
+	readPage(rootPageNo, rootPage);
+	traverse(rootPage, ((NonLeafNodeInt*) rootPage)->level, &key, currentPageNum);
+	unpinPage(rootPageNo, false);
+	// the leaves after a jump are not a sequential run for the scan ring
+	scanLeavesRead = 0;
+	readScanLeaf(currentPageNum, currentPageData);
+	BTREE_COUNT(nodesVisited, 1);
+	loadScanLeaf(currentPageData);
+	nextEntry = std::lower_bound(scanKeys, scanKeys + scanCount, key) - scanKeys;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupBatch
+// -----------------------------------------------------------------------------
 
-	
+void BTreeIndex::lookupBatch(const std::vector<int>& keys, std::vector<std::vector<RecordId>>& results)
+{
+	prepareAsync();
+	results.assign(keys.size(), std::vector<RecordId>());
+	BTREE_COUNT(descents, keys.size());
+
+	// (page to read next, lookup) of every lookup not yet complete, sorted so that lookups
+	// reading the same page are next to each other and share the read
+	std::vector<std::pair<PageId, std::size_t>> pending, following;
+	std::vector<LookupStage> stages(keys.size(), LOOKUP_NONLEAF);
+	for (std::size_t i = 0; i < keys.size(); i++)
+		pending.push_back(std::make_pair(rootPageNum, i));
+	std::vector<PageId> window;
+
+	while (!pending.empty()) {
+		std::sort(pending.begin(), pending.end());
+		following.clear();
+		for (std::size_t first = 0; first < pending.size(); ) {
+			// the lookups of the next ASYNCQUEUEDEPTH distinct pages
+			window.clear();
+			std::size_t end = first;
+			for (; end < pending.size(); end++) {
+				if (window.empty() || pending[end].first != window.back()) {
+					if ((int) window.size() == ASYNCQUEUEDEPTH) break;
+					window.push_back(pending[end].first);
+				}
+			}
+			readPagesAsync(window, 0, window.size());
+
+			int pageIndex = -1;
+			for (std::size_t j = first; j < end; j++) {
+				if (j == first || pending[j].first != pending[j-1].first) pageIndex++;
+				std::size_t lookup = pending[j].second;
+				PageId nextPageNo = advanceLookup(keys[lookup], &asyncPages[pageIndex], stages[lookup], results[lookup]);
+				if (nextPageNo != Page::INVALID_NUMBER)
+					following.push_back(std::make_pair(nextPageNo, lookup));
+			}
+			first = end;
+		}
+		pending.swap(following);
+	}
+	for (std::size_t i = 0; i < keys.size(); i++)
+		deltaLookup(keys[i], results[i]);
+}
+
+PageId BTreeIndex::advanceLookup(int key, Page* page, LookupStage& stage, std::vector<RecordId>& rids)
+{
+	BTREE_COUNT(nodesVisited, 1);
+	if (stage == LOOKUP_NONLEAF) {
+		// same routing as traverse()
+		NonLeafNodeInt* node = reinterpret_cast<NonLeafNodeInt*>(page);
+		if (pastHighKey(node, key)) {
+			BTREE_COUNT(rightMoves, 1);
+			return node->rightSibPageNo;
+		}
+		bufferLookup(node, key, rids);
+		if (node->level == 1) stage = LOOKUP_LEAF;
+		return node->pageNoArray[findChildIndex(node, key, false)];
+	}
+
+	if (stage == LOOKUP_OVERFLOW) {
+		PostingsOverflowPage* overflow = reinterpret_cast<PostingsOverflowPage*>(page);
+		rids.insert(rids.end(), overflow->ridArray, overflow->ridArray + overflow->numRids);
+		return overflow->nextPageNo;
+	}
+
+	bool spilled;
+	PageId nextPageNo = leafLookup(key, page, rids, asyncKeyBuf.data(), asyncRidBuf.data(), spilled);
+	if (spilled)
+		stage = LOOKUP_OVERFLOW;
+	else if (nextPageNo != Page::INVALID_NUMBER)
+		BTREE_COUNT(siblingHops, 1);
+	return nextPageNo;
+}
+
+PageId BTreeIndex::leafLookup(int key, Page* page, std::vector<RecordId>& rids, int* keyBuf, RecordId* ridBuf,
+		bool& spilled) const
+{
+	const int* leafKeys;
+	const RecordId* leafRids;
+	PageId rightSibPageNo;
+	int count = decodeLeaf(page, leafKeys, leafRids, rightSibPageNo, keyBuf, ridBuf);
+	int i = std::lower_bound(leafKeys, leafKeys + count, key) - leafKeys;
+	spilled = false;
+	for (; i < count && leafKeys[i] == key; i++) {
+		if (leafRids[i].slot_number == Page::INVALID_SLOT) {
+			// a spilled postings list holds every rid of its key
+			spilled = true;
+			return leafRids[i].page_number;
+		}
+		rids.push_back(leafRids[i]);
+	}
+	// keys equal to the high key may also be in the right sibling, smaller keys are not
+	if (i < count || key < leafHighKey(page))
+		return Page::INVALID_NUMBER;
+
+	// the run of key may go on in the right sibling, as startScan() would find by walking there
+	return rightSibPageNo;
+}
+
+int BTreeIndex::leafHighKey(const Page* page) const
+{
+	if (leafFormat == LEAF_COMPRESSED)
+		return reinterpret_cast<const CompressedLeafNodeInt*>(page)->highKey;
+	if (leafFormat == LEAF_POSTINGS)
+		return reinterpret_cast<const PostingsLeafNodeInt*>(page)->highKey;
+	return reinterpret_cast<const LeafNodeInt*>(page)->highKey;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::scanNext
+// BTreeIndex::scanAsync
 // -----------------------------------------------------------------------------
 
-void BTreeIndex::scanNext(RecordId& outRid) 
+std::size_t BTreeIndex::scanAsync(const void* lowValParm, const Operator lowOpParm,
+		const void* highValParm, const Operator highOpParm, std::vector<RecordId>& outRids)
 {
-	if (!scanExecuting) {
-        throw ScanNotInitializedException();
-    }
+	if ((lowOpParm != GT && lowOpParm != GTE) || (highOpParm != LT && highOpParm != LTE))
+		throw BadOpcodesException();
+	int lowVal = *((int*) lowValParm);
+	int highVal = *((int*) highValParm);
+	if (lowVal > highVal)
+		throw BadScanrangeException();
 
-    LeafNodeInt* currNode = reinterpret_cast<LeafNodeInt*>(currentPageData);
-    if (currNode->keyArray[nextEntry] == INT32_MAX or nextEntry == leafOccupancy) {
-        // found page to read; look for sibling
-        if (currNode->rightSibPageNo == 0) {
-            throw IndexScanCompletedException();
-        }
-
-        // manage buffer
-        bufMgr->unPinPage(file, currentPageNum, false);
-        currentPageNum = currNode->rightSibPageNo;
-        bufMgr->readPage(file, currNode->rightSibPageNo, currentPageData);
-        currNode = (LeafNodeInt*)currentPageData;
-        nextEntry = 0;
-    }
-        // check for matching rid
-    int key = currNode->keyArray[nextEntry];
-	bool match;
-	if (lowOp== GTE && highOp == LTE) {
-	   match = (key <= highValInt && key >= lowValInt);
-    } else if (lowOp == GTE && highOp == LT) {
-           match = (key < highValInt && key >= lowValInt);
-	} else if (lowOp == GT && highOp == LTE) {
-           match = (key <= highValInt && key > lowValInt);
-	} else { // GT, LT
-	   match = (key < highValInt && key > lowValInt);
+	applyBuffers(lowVal, highVal);
+	prepareAsync();
+	std::size_t before = outRids.size();
+	BTREE_COUNT(descents, 1);
+	std::multimap<int, RecordId>::const_iterator deltaNext, deltaEnd;
+	deltaRange(lowVal, lowOpParm, highVal, highOpParm, deltaNext, deltaEnd);
+
+	// the nodes of one level that overlap the range, in key order: the first of them is entered
+	// where the descent of startScan() would, the last where a descent for highVal would
+	std::vector<PageId> level(1, rootPageNum), below;
+	bool leafLevel = false;
+	while (!leafLevel) {
+		below.clear();
+		for (std::size_t first = 0; first < level.size(); first += ASYNCQUEUEDEPTH) {
+			std::size_t count = std::min<std::size_t>(ASYNCQUEUEDEPTH, level.size() - first);
+			readPagesAsync(level, first, count);
+			for (std::size_t j = 0; j < count; j++) {
+				NonLeafNodeInt* node = reinterpret_cast<NonLeafNodeInt*>(&asyncPages[j]);
+				int from = first + j == 0 ? findChildIndex(node, lowVal, false) : 0;
+				int to = first + j == level.size() - 1 ? findChildIndex(node, highVal, true)
+						: nodeKeyCount(node, nodeOccupancy);
+				below.insert(below.end(), node->pageNoArray + from, node->pageNoArray + to + 1);
+				leafLevel = node->level == 1;
+			}
+			BTREE_COUNT(nodesVisited, count);
+		}
+		level.swap(below);
+	}
+
+	for (std::size_t first = 0; first < level.size(); first += ASYNCQUEUEDEPTH) {
+		std::size_t count = std::min<std::size_t>(ASYNCQUEUEDEPTH, level.size() - first);
+		readPagesAsync(level, first, count);
+		for (std::size_t j = 0; j < count; j++) {
+			const int* leafKeys;
+			const RecordId* leafRids;
+			PageId rightSibPageNo;
+			int n = decodeLeaf(&asyncPages[j], leafKeys, leafRids, rightSibPageNo, asyncKeyBuf.data(), asyncRidBuf.data());
+			int i = (lowOpParm == GTE ? std::lower_bound(leafKeys, leafKeys + n, lowVal)
+					: std::upper_bound(leafKeys, leafKeys + n, lowVal)) - leafKeys;
+			for (; i < n && keyInRange(leafKeys[i], lowVal, lowOpParm, highVal, highOpParm); i++) {
+				// delta entries go after the tree entries with the same key, as in scanNextBatch()
+				for (; deltaNext != deltaEnd && deltaNext->first < leafKeys[i]; ++deltaNext)
+					outRids.push_back(deltaNext->second);
+				if (leafRids[i].slot_number == Page::INVALID_SLOT)
+					readOverflowAsync(leafRids[i].page_number, outRids);
+				else
+					outRids.push_back(leafRids[i]);
+			}
+		}
+		BTREE_COUNT(nodesVisited, count);
+		BTREE_COUNT(siblingHops, count - (first == 0));
+	}
+	for (; deltaNext != deltaEnd; ++deltaNext)
+		outRids.push_back(deltaNext->second);
+	BTREE_COUNT(scanEntries, outRids.size() - before);
+	return outRids.size() - before;
+}
+
+void BTreeIndex::prepareAsync()
+{
+	if (arena != nullptr) {
+		// reads past the buffer pool copy from the arena
+		asyncPages.resize(ASYNCQUEUEDEPTH + 1);
+		return;
+	}
+	if (!fileInSync) {
+		// the reader reads the file past the buffer pool, so the file has to hold every change
+		flushIndexFile();
+		fileInSync = true;
+	}
+	if (asyncReader == nullptr) {
+		asyncReader = new AsyncPageReader(file->filename(), ASYNCQUEUEDEPTH);
+		asyncPages.resize(ASYNCQUEUEDEPTH + 1);
+	}
+}
+
+void BTreeIndex::readPagesAsync(const std::vector<PageId>& pageNos, std::size_t first, std::size_t count)
+{
+	if (arena != nullptr) {
+		for (std::size_t j = 0; j < count; j++)
+			asyncPages[j] = *arena->page(pageNos[first + j]);
+	} else {
+		for (std::size_t j = 0; j < count; j++)
+			asyncReader->submit(pageNos[first + j], &asyncPages[j]);
+		asyncReader->wait();
+	}
+	BTREE_COUNT(asyncReads, count);
+}
+
+void BTreeIndex::readOverflowAsync(PageId headPageNo, std::vector<RecordId>& outRids)
+{
+	// the pages of a chain are only known one after the other
+	Page* page = &asyncPages[ASYNCQUEUEDEPTH];
+	for (PageId pageNo = headPageNo; pageNo != Page::INVALID_NUMBER; ) {
+		if (arena != nullptr) {
+			*page = *arena->page(pageNo);
+		} else {
+			asyncReader->submit(pageNo, page);
+			asyncReader->wait();
+		}
+		BTREE_COUNT(asyncReads, 1);
+		PostingsOverflowPage* overflow = reinterpret_cast<PostingsOverflowPage*>(page);
+		outRids.insert(outRids.end(), overflow->ridArray, overflow->ridArray + overflow->numRids);
+		pageNo = overflow->nextPageNo;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupOptimistic
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::lookupOptimistic(int key, std::vector<RecordId>& rids)
+{
+	// decode buffers and the copy of a compressed leaf are per thread, the index ones are shared
+	static thread_local std::vector<int> keyBuf;
+	static thread_local std::vector<RecordId> ridBuf;
+	alignas(8) static thread_local char leafCopy[Page::SIZE];
+	keyBuf.resize(scanKeyBuf.size());
+	ridBuf.resize(scanRidBuf.size());
+
+	std::size_t numRids = rids.size();
+	PageId fetchPageNo;
+	auto attempt = [&]() -> bool {
+		PageId pageNo = __atomic_load_n(&rootPageNum, __ATOMIC_ACQUIRE);
+		Page* page;
+		std::uint64_t version;
+		if (!olcReadLock(pageNo, page, version))
+			return false;
+
+		bool leafChildren = false;
+		while (!leafChildren) {
+			const NonLeafNodeInt* node = reinterpret_cast<const NonLeafNodeInt*>(page);
+			// a split since the parent was read moved key to the right sibling; an old root is
+			// such a node too
+			bool moveRight = pastHighKey(node, key);
+			leafChildren = node->level == 1 && !moveRight;
+			PageId childPageNo = moveRight ? node->rightSibPageNo : node->pageNoArray[findChildIndex(node, key, false)];
+			if (!olcValidate(pageNo, version))
+				return false;
+			Page* childPage;
+			std::uint64_t childVersion;
+			if (!olcReadLock(childPageNo, childPage, childVersion) || !olcValidate(pageNo, version))
+				return false;
+			pageNo = childPageNo;
+			page = childPage;
+			version = childVersion;
+		}
+
+		while (true) {
+			Page* leaf = page;
+			if (leafFormat != LEAF_PLAIN) {
+				// decoding a torn compressed leaf could run off its buffers, so decode a checked copy
+				std::memcpy(leafCopy, page, Page::SIZE);
+				if (!olcValidate(pageNo, version))
+					return false;
+				leaf = reinterpret_cast<Page*>(leafCopy);
+			}
+			bool spilled;
+			PageId nextPageNo = leafLookup(key, leaf, rids, keyBuf.data(), ridBuf.data(), spilled);
+			if (!olcValidate(pageNo, version))
+				return false;
+
+			if (spilled) {
+				// the overflow chain changes only with its leaf locked
+				while (nextPageNo != Page::INVALID_NUMBER) {
+					OptimisticNode* entry = olcNode(nextPageNo, false);
+					Page* overflowPage = entry == nullptr ? nullptr : entry->page.load(std::memory_order_acquire);
+					if (overflowPage == nullptr) {
+						fetchPageNo = nextPageNo;
+						return false;
+					}
+					const PostingsOverflowPage* overflow = reinterpret_cast<const PostingsOverflowPage*>(overflowPage);
+					int count = std::min<int>(overflow->numRids, PostingsOverflowPage::SIZE);
+					rids.insert(rids.end(), overflow->ridArray, overflow->ridArray + count);
+					nextPageNo = overflow->nextPageNo;
+					if (!olcValidate(pageNo, version))
+						return false;
+				}
+				return true;
+			}
+			if (nextPageNo == Page::INVALID_NUMBER)
+				return true;
+
+			Page* sibPage;
+			std::uint64_t sibVersion;
+			if (!olcReadLock(nextPageNo, sibPage, sibVersion) || !olcValidate(pageNo, version))
+				return false;
+			pageNo = nextPageNo;
+			page = sibPage;
+			version = sibVersion;
+		}
+	};
+
+	while (true) {
+		fetchPageNo = Page::INVALID_NUMBER;
+		if (attempt())
+			return;
+		rids.resize(numRids);
+		if (fetchPageNo != Page::INVALID_NUMBER)
+			olcFetch(fetchPageNo);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupLatched
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::lookupLatched(int key, std::vector<RecordId>& rids)
+{
+	static thread_local std::vector<int> keyBuf;
+	static thread_local std::vector<RecordId> ridBuf;
+	keyBuf.resize(scanKeyBuf.size());
+	ridBuf.resize(scanRidBuf.size());
+
+	std::size_t numRids = rids.size();
+	PageId fetchPageNo;
+	// latchNode() fails on a missing page as on a locked one; the missing one is fetched latch free
+	auto latchFailed = [&](PageId pageNo, Page* page) {
+		if (page == nullptr) fetchPageNo = pageNo;
+		return false;
+	};
+	auto attempt = [&]() -> bool {
+		PageId pageNo = __atomic_load_n(&rootPageNum, __ATOMIC_ACQUIRE);
+		Page* page;
+		if (!latchNode(pageNo, page))
+			return latchFailed(pageNo, page);
+
+		bool leafChildren = false;
+		while (!leafChildren) {
+			const NonLeafNodeInt* node = reinterpret_cast<const NonLeafNodeInt*>(page);
+			bool moveRight = pastHighKey(node, key);
+			leafChildren = node->level == 1 && !moveRight;
+			PageId childPageNo = moveRight ? node->rightSibPageNo : node->pageNoArray[findChildIndex(node, key, false)];
+			Page* childPage;
+			bool latched = latchNode(childPageNo, childPage);
+			unlatchNode(pageNo);
+			if (!latched)
+				return latchFailed(childPageNo, childPage);
+			pageNo = childPageNo;
+			page = childPage;
+		}
+
+		while (true) {
+			bool spilled;
+			PageId nextPageNo = leafLookup(key, page, rids, keyBuf.data(), ridBuf.data(), spilled);
+			if (spilled) {
+				while (nextPageNo != Page::INVALID_NUMBER) {
+					OptimisticNode* entry = olcNode(nextPageNo, false);
+					Page* overflowPage = entry == nullptr ? nullptr : entry->page.load(std::memory_order_acquire);
+					if (overflowPage == nullptr) {
+						unlatchNode(pageNo);
+						return latchFailed(nextPageNo, nullptr);
+					}
+					const PostingsOverflowPage* overflow = reinterpret_cast<const PostingsOverflowPage*>(overflowPage);
+					rids.insert(rids.end(), overflow->ridArray, overflow->ridArray + overflow->numRids);
+					nextPageNo = overflow->nextPageNo;
+				}
+				unlatchNode(pageNo);
+				return true;
+			}
+			if (nextPageNo == Page::INVALID_NUMBER) {
+				unlatchNode(pageNo);
+				return true;
+			}
+
+			Page* sibPage;
+			bool latched = latchNode(nextPageNo, sibPage);
+			unlatchNode(pageNo);
+			if (!latched)
+				return latchFailed(nextPageNo, sibPage);
+			pageNo = nextPageNo;
+			page = sibPage;
+		}
+	};
+
+	while (true) {
+		fetchPageNo = Page::INVALID_NUMBER;
+		if (attempt())
+			return;
+		rids.resize(numRids);
+		if (fetchPageNo != Page::INVALID_NUMBER)
+			olcFetch(fetchPageNo);
+		else
+			std::this_thread::yield();
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex -- node table of optimistic reads
+// -----------------------------------------------------------------------------
+
+OptimisticNode* BTreeIndex::olcNode(PageId pageNo, bool create)
+{
+	if (olcChunks == nullptr || pageNo / OLCCHUNKSIZE >= (PageId) OLCMAXCHUNKS)
+		return nullptr;
+	std::atomic<OptimisticNode*>& slot = olcChunks[pageNo / OLCCHUNKSIZE];
+	OptimisticNode* chunk = slot.load(std::memory_order_acquire);
+	if (chunk == nullptr) {
+		// chunks are only created under olcWriteMutex
+		if (!create)
+			return nullptr;
+		chunk = new OptimisticNode[OLCCHUNKSIZE]();
+		slot.store(chunk, std::memory_order_release);
+	}
+	return chunk + pageNo % OLCCHUNKSIZE;
+}
+
+void BTreeIndex::olcFetch(PageId pageNo)
+{
+	std::lock_guard<std::mutex> lock(olcWriteMutex);
+	Page* page;
+	readPage(pageNo, page);
+	unpinPage(pageNo, false);
+}
+
+void BTreeIndex::lockNode(PageId pageNo)
+{
+	OptimisticNode* node = optimisticReads ? olcNode(pageNo, true) : nullptr;
+	if (node == nullptr)
+		return;
+	node->version.fetch_add(1);
+	while (node->readers.load() != 0)
+		std::this_thread::yield();
+}
+
+void BTreeIndex::unlockNode(PageId pageNo)
+{
+	OptimisticNode* node = optimisticReads ? olcNode(pageNo, true) : nullptr;
+	if (node != nullptr)
+		node->version.fetch_add(1, std::memory_order_release);
+}
+
+bool BTreeIndex::olcReadLock(PageId pageNo, Page*& page, std::uint64_t& version)
+{
+	OptimisticNode* node = olcNode(pageNo, false);
+	page = node == nullptr ? nullptr : node->page.load(std::memory_order_acquire);
+	if (page == nullptr) {
+		olcFetch(pageNo);
+		return false;
+	}
+	while ((version = node->version.load(std::memory_order_acquire)) & 1)
+		std::this_thread::yield();
+	return true;
+}
+
+bool BTreeIndex::olcValidate(PageId pageNo, std::uint64_t version)
+{
+	// the reads of the node before this may not move past the check of its version
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return olcNode(pageNo, false)->version.load(std::memory_order_relaxed) == version;
+}
+
+bool BTreeIndex::latchNode(PageId pageNo, Page*& page)
+{
+	OptimisticNode* node = olcNode(pageNo, false);
+	page = node == nullptr ? nullptr : node->page.load(std::memory_order_acquire);
+	if (page == nullptr)
+		return false;
+	// pairs with lockNode(): either the insert sees the latch or the latch sees the lock
+	node->readers.fetch_add(1);
+	if (node->version.load() & 1) {
+		node->readers.fetch_sub(1);
+		return false;
+	}
+	return true;
+}
+
+void BTreeIndex::unlatchNode(PageId pageNo)
+{
+	olcNode(pageNo, false)->readers.fetch_sub(1, std::memory_order_release);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::checkpoint
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::checkpoint()
+{
+	collectStats();
+	saveMetaState(!building());
+	// write the index out, so that long scans can read its leaves from the file past the buffer pool
+	flushIndexFile();
+	fileInSync = true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::compact
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::compact(int fillPercent)
+{
+	if (scanExecuting)
+		endScan();
+	finishBuild();
+	std::vector<int> keys;
+	std::vector<RecordId> rids;
+	keys.reserve(numTuples);
+	rids.reserve(numTuples);
+	int low = INT32_MIN, high = INT32_MAX;
+	try {
+		startScan(&low, GTE, &high, LTE);
+		int key;
+		RecordId rid;
+		while (true) {
+			scanNextEntry(key, rid);
+			keys.push_back(key);
+			rids.push_back(rid);
+		}
+	} catch (const IndexScanCompletedException &) {
+		endScan();
+	} catch (const NoSuchKeyFoundException &) {
+	}
+	// the entries of the delta are in keys now, those of the buffers were applied by the scan
+	delta.clear();
+
+	Page* metaPage;
+	readPage(headerPageNum, metaPage);
+	IndexMetaInfo meta = *reinterpret_cast<IndexMetaInfo*>(metaPage);
+	unpinPage(headerPageNum, false);
+	flushIndexFile();
+	std::string indexName, compactName;
+	PageId metaPageId = headerPageNum;
+	if (arena != nullptr) {
+		// every node but the meta page goes to the free list, which hands them out again in order
+		for (PageId pageNo = arena->numPages(); pageNo > headerPageNum; pageNo--)
+			arena->release(pageNo);
+		readPage(metaPageId, metaPage);
+	} else {
+		delete asyncReader;
+		asyncReader = nullptr;
+		indexName = file->filename();
+		compactName = indexName + ".compact";
+		delete file;
+		file = nullptr;
+		try {
+			File::remove(compactName);
+		} catch (const FileNotFoundException &) {
+		}
+
+		file = new BlobFile(compactName, true);
+		numIndexPages = 0;
+		allocPage(metaPageId, metaPage);
+		headerPageNum = metaPageId;
+	}
+	rootPageNum = createNonLeafInt(1);
+	PageId leafPageId = createLeafInt();
+	Page* rootPage;
+	readPage(rootPageNum, rootPage);
+	reinterpret_cast<NonLeafNodeInt*>(rootPage)->pageNoArray[0] = leafPageId;
+	unpinPage(rootPageNum, true);
+	meta.rootPageNo = rootPageNum;
+	*reinterpret_cast<IndexMetaInfo*>(metaPage) = meta;
+	unpinPage(metaPageId, true);
+
+	// ascending keys through the hint leaf: no descent but for a split, and every split rightmost,
+	// also inside a run of one key longer than a leaf
+	int savedFillFactor = fillFactor;
+	bool savedInsertHint = insertHint;
+	bool savedBufferInserts = bufferInserts;
+	fillFactor = std::max(50, std::min(100, fillPercent));
+	insertHint = true;
+	insertAppend = true;
+	bufferInserts = false;
+	hintLeafPageNum = Page::INVALID_NUMBER;
+	for (std::size_t i = 0; i < keys.size(); i++)
+		insertIntoTree(keys[i], rids[i]);
+	fillFactor = savedFillFactor;
+	insertHint = savedInsertHint;
+	insertAppend = false;
+	bufferInserts = savedBufferInserts;
+	hintLeafPageNum = Page::INVALID_NUMBER;
+	BTREE_COUNT(compactions, 1);
+
+	if (arena != nullptr) {
+		checkpoint();
+		return;
+	}
+	flushIndexFile();
+	delete file;
+	file = nullptr;
+	// if the rename fails the index file keeps the old tree, and this object the new one
+	bool renamed = std::rename(compactName.c_str(), indexName.c_str()) == 0;
+	file = new BlobFile(renamed ? indexName : compactName, false);
+	checkpoint();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::saveSnapshot
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::saveSnapshot()
+{
+	checkpoint();
+	if (arena == nullptr)
+		return;
+	const std::string snapshotName = indexFileName + ".snapshot";
+	try {
+		File::remove(snapshotName);
+	} catch (const FileNotFoundException &) {
+	}
+	{
+		BlobFile snapshot(snapshotName, true);
+		for (PageId pageNo = 1; pageNo <= arena->numPages(); pageNo++) {
+			PageId snapshotPageNo;
+			snapshot.allocatePage(snapshotPageNo);
+			snapshot.writePage(snapshotPageNo, *arena->page(pageNo));
+		}
+	}
+	if (std::rename(snapshotName.c_str(), indexFileName.c_str()) != 0)
+		File::remove(snapshotName);
+}
+
+void BTreeIndex::saveMetaState(bool complete)
+{
+	Page* metaPage;
+	readPage(headerPageNum, metaPage);
+	IndexMetaInfo* metaData = reinterpret_cast<IndexMetaInfo*>(metaPage);
+	metaData->formatVersion = INDEXFORMATVERSION;
+	metaData->complete = complete;
+	metaData->relationFingerprint = complete ? relationFingerprint(relationFileName) : 0;
+	metaData->numTuples = numTuples;
+	metaData->numPages = indexPages();
+	if (metaComplete && !complete && file != nullptr) {
+		// on disk before the buffer pool can evict any page the index is about to change, so that
+		// an index file left half written is never marked complete
+		file->writePage(headerPageNum, *metaPage);
+	}
+	unpinPage(headerPageNum, true);
+	metaComplete = complete;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::collectStats
+// -----------------------------------------------------------------------------
+
+IndexStats BTreeIndex::collectStats()
+{
+	// the walk only sees the leaves
+	mergeDelta();
+	applyBuffers(INT32_MIN, INT32_MAX);
+	IndexStats stats = IndexStats();
+	statsLeaves.clear();
+	collectNodeStats(rootPageNum, 1, stats);
+	if (stats.numNonLeafPages > 0) stats.avgNonLeafFill /= stats.numNonLeafPages;
+	if (stats.numLeafPages > 0) stats.avgLeafFill /= stats.numLeafPages;
+
+	// bucket b of the equi-depth histogram ends with the entry of rank ceil((b+1) * numEntries / STATSHISTOGRAMSIZE) - 1
+	for (int b = 0; b < STATSHISTOGRAMSIZE && stats.numEntries > 0; b++) {
+		std::int64_t rank = ((b + 1) * (std::int64_t) stats.numEntries + STATSHISTOGRAMSIZE - 1) / STATSHISTOGRAMSIZE - 1;
+		// the last leaf starting at or before rank; of several leaves starting there only the last is not empty
+		std::vector<std::pair<std::int64_t, PageId>>::iterator leaf = std::upper_bound(statsLeaves.begin(), statsLeaves.end(), rank,
+			[](std::int64_t r, const std::pair<std::int64_t, PageId>& l) { return r < l.first; }) - 1;
+		Page* page;
+		readPage(leaf->second, page);
+		stats.histogram.push_back(leafKeyAt(page, rank - leaf->first));
+		unpinPage(leaf->second, false);
+	}
+	statsLeaves.clear();
+	statsLeaves.shrink_to_fit();
+
+	storedStats.numEntries = stats.numEntries;
+	storedStats.numDistinctKeys = stats.numDistinctKeys;
+	storedStats.minKey = stats.minKey;
+	storedStats.maxKey = stats.maxKey;
+	std::fill(storedStats.histogram, storedStats.histogram + STATSHISTOGRAMSIZE, 0);
+	std::copy(stats.histogram.begin(), stats.histogram.end(), storedStats.histogram);
+	Page* metaPage;
+	readPage(headerPageNum, metaPage);
+	reinterpret_cast<IndexMetaInfo*>(metaPage)->stats = storedStats;
+	unpinPage(headerPageNum, true);
+	return stats;
+}
+
+void BTreeIndex::collectNodeStats(PageId pageNo, int depth, IndexStats& stats)
+{
+	Page* page;
+	readPage(pageNo, page);
+	NonLeafNodeInt* node = reinterpret_cast<NonLeafNodeInt*>(page);
+	int numKeys = nodeKeyCount(node, nodeOccupancy);
+	stats.numNonLeafPages++;
+	stats.avgNonLeafFill += (double) numKeys / nodeOccupancy; // summed here, averaged by collectStats
+	stats.height = std::max(stats.height, depth + 1);
+	if ((int) stats.pagesPerLevel.size() < depth + 1) stats.pagesPerLevel.resize(depth + 1);
+	stats.pagesPerLevel[depth-1]++;
+
+	for (int i = 0; i <= numKeys; i++) {
+		PageId childPageNo = node->pageNoArray[i];
+		if (node->level == 0) {
+			collectNodeStats(childPageNo, depth + 1, stats);
+			continue;
+		}
+		Page* child;
+		readPage(childPageNo, child);
+		stats.pagesPerLevel[depth]++;
+		collectLeafStats(childPageNo, child, stats);
+		unpinPage(childPageNo, false);
 	}
+	unpinPage(pageNo, false);
+}
+
+void BTreeIndex::collectLeafStats(PageId pageNo, Page* page, IndexStats& stats)
+{
+	statsLeaves.push_back(std::make_pair((std::int64_t) stats.numEntries, pageNo));
+	stats.numLeafPages++;
 
-	if (match) {
-       outRid = currNode->ridArray[nextEntry];
-	   nextEntry++;
+	const int* keys = nullptr; // keys of every entry, for the plain and compressed formats
+	int n = 0;
+	double fill;
+	if (leafFormat == LEAF_COMPRESSED) {
+		CompressedLeafNodeInt* leaf = reinterpret_cast<CompressedLeafNodeInt*>(page);
+		n = decodeCompressedLeaf(leaf, leafKeyBuf.data(), leafRidBuf.data());
+		keys = leafKeyBuf.data();
+		fill = (double) compressedLeafSize(leafKeyBuf.data(), leafRidBuf.data(), 0, n) / CompressedLeafNodeInt::DATASIZE;
+	} else if (leafFormat == LEAF_POSTINGS) {
+		PostingsLeafNodeInt* leaf = reinterpret_cast<PostingsLeafNodeInt*>(page);
+		const PostingInt* postings = reinterpret_cast<const PostingInt*>(leaf->data);
+		for (int p = 0; p < leaf->numPostings; p++) {
+			if (stats.numEntries == 0) stats.minKey = postings[p].key;
+			stats.numEntries += postings[p].numRids;
+			stats.numDistinctKeys++; // a postings list holds all rids of its key
+			stats.maxKey = postings[p].key;
+			for (PageId overflowPageNo = postings[p].overflowPageNo; overflowPageNo != Page::INVALID_NUMBER; ) {
+				Page* overflowPage;
+				readPage(overflowPageNo, overflowPage);
+				PageId nextPageNo = reinterpret_cast<PostingsOverflowPage*>(overflowPage)->nextPageNo;
+				unpinPage(overflowPageNo, false);
+				overflowPageNo = nextPageNo;
+				stats.numOverflowPages++;
+			}
+		}
+		fill = (double) (leaf->numPostings * sizeof(PostingInt) + leaf->numRids * sizeof(RecordId)) / PostingsLeafNodeInt::DATASIZE;
 	} else {
-           throw IndexScanCompletedException();
+		LeafNodeInt* leaf = reinterpret_cast<LeafNodeInt*>(page);
+		n = nodeKeyCount(leaf);
+		keys = leaf->keyArray;
+		fill = (double) n / INTARRAYLEAFSIZE;
+	}
+
+	for (int i = 0; i < n; i++) {
+		if (stats.numEntries == 0) stats.minKey = keys[i];
+		else if (keys[i] == statsLastKey) { stats.numEntries++; continue; }
+		stats.numEntries++;
+		stats.numDistinctKeys++;
+		statsLastKey = keys[i];
+	}
+	if (n > 0) stats.maxKey = keys[n-1];
+
+	stats.avgLeafFill += fill; // summed here, averaged by collectStats
+	stats.leafFillHistogram[std::min(STATSFILLBUCKETS - 1, (int) (fill * STATSFILLBUCKETS))]++;
+}
+
+int BTreeIndex::leafKeyAt(Page* page, std::int64_t offset)
+{
+	if (leafFormat == LEAF_COMPRESSED) {
+		decodeCompressedLeaf(reinterpret_cast<CompressedLeafNodeInt*>(page), leafKeyBuf.data(), leafRidBuf.data());
+		return leafKeyBuf[offset];
+	}
+	if (leafFormat == LEAF_POSTINGS) {
+		const PostingsLeafNodeInt* leaf = reinterpret_cast<const PostingsLeafNodeInt*>(page);
+		const PostingInt* postings = reinterpret_cast<const PostingInt*>(leaf->data);
+		int p = 0;
+		for (; offset >= postings[p].numRids; p++) offset -= postings[p].numRids;
+		return postings[p].key;
+	}
+	return reinterpret_cast<LeafNodeInt*>(page)->keyArray[offset];
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::estimateScanCount
+// -----------------------------------------------------------------------------
+
+double BTreeIndex::estimateScanCount(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm) const
+{
+	if ((lowOpParm != GT && lowOpParm != GTE) || (highOpParm != LT && highOpParm != LTE))
+		throw BadOpcodesException();
+	std::int64_t low = *((int*) lowValParm);
+	std::int64_t high = *((int*) highValParm);
+	if (low > high)
+		throw BadScanrangeException();
+
+	// keys are integers, so key > low is key >= low + 1 and key < high is key <= high - 1
+	double count = estimateRank(highOpParm == LTE ? high : high - 1) - estimateRank(lowOpParm == GTE ? low - 1 : low);
+	return std::max(0.0, count);
+}
+
+double BTreeIndex::estimateRank(std::int64_t key) const
+{
+	if (storedStats.numEntries == 0 || key < storedStats.minKey)
+		return 0;
+	if (key >= storedStats.maxKey)
+		return storedStats.numEntries;
+
+	// buckets whose upper bound is at most key count fully, the next one in proportion to the
+	// part of its key range up to key
+	const int* bound = std::upper_bound(storedStats.histogram, storedStats.histogram + STATSHISTOGRAMSIZE, (int) key);
+	int b = bound - storedStats.histogram;
+	std::int64_t lowEdge = b == 0 ? (std::int64_t) storedStats.minKey - 1 : storedStats.histogram[b-1];
+	double perBucket = (double) storedStats.numEntries / STATSHISTOGRAMSIZE;
+	return perBucket * (b + (double) (key - lowEdge) / (*bound - lowEdge));
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::getCounters
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Cycle counter of the CPU, or nanoseconds where there is none.
+ */
+static inline std::uint64_t cycleCount()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+void BTreeIndex::resetCounters()
+{
+	counters = IndexCounters();
+}
+
+void BTreeIndex::setTimingSampleRate(int everyN)
+{
+	timingSampleRate = std::max(0, everyN);
+	timingCountdown = timingSampleRate;
+}
+
+std::uint64_t BTreeIndex::timingStart()
+{
+#ifndef BTREE_NO_COUNTERS
+	if (timingSampleRate > 0 && --timingCountdown <= 0) {
+		timingCountdown = timingSampleRate;
+		return cycleCount();
 	}
+#endif
+	return 0;
+}
+
+void BTreeIndex::timingEnd(TimedOperation op, std::uint64_t start)
+{
+	if (start == 0)
+		return;
+	std::uint64_t elapsed = cycleCount() - start;
+	int bucket = 0;
+	for (; elapsed > 0 && bucket < CYCLEBUCKETS - 1; bucket++) elapsed >>= 1;
+	counters.timedOps[op]++;
+	counters.cycles[op][bucket]++;
 }
 
 // -----------------------------------------------------------------------------
@@ -466,52 +2784,47 @@ void BTreeIndex::endScan()
     scanExecuting = false;
 
     if (currentPageNum != Page::INVALID_NUMBER) {
-		std::cout<<currentPageNum<<std::endl;
-        bufMgr->unPinPage(file, currentPageNum, false);
+        releaseScanLeaf(currentPageNum);
 		currentPageNum = Page::INVALID_NUMBER;
 	}
+	if (overflowPageNum != Page::INVALID_NUMBER) {
+		unpinPage(overflowPageNum, false);
+		overflowPageNum = Page::INVALID_NUMBER;
+	}
 }
 
 void BTreeIndex::traverse(Page* page, int pageLevel, const void* keyPtr, PageId &leafID) {
+	BTREE_COUNT(nodesVisited, 1);
 
 	int index;
 
+	if (pastHighKey((NonLeafNodeInt*) page, *(int*) keyPtr)) {
+		// the node split after its parent was read: key is right of it
+		BTREE_COUNT(rightMoves, 1);
+		PageId rightPageNo = ((NonLeafNodeInt*) page)->rightSibPageNo;
+		Page* right;
+		readPage(rightPageNo, right);
+		traverse(right, pageLevel, keyPtr, leafID);
+		unpinPage(rightPageNo, false);
+		return;
+	}
+
     if(pageLevel == 0) {
         int key = *(int*) keyPtr;
 		NonLeafNodeInt* nodeInt = (NonLeafNodeInt*) page;
 
-		for(int i = 0; i < nodeOccupancy; i++) {
-			if(key < nodeInt->keyArray[0]) {
-				index = 0; 
-			}
-			else if(key >= nodeInt->keyArray[i] && !(i == nodeOccupancy - 1 || nodeInt->keyArray[i+1] == INT32_MAX) && key < nodeInt->keyArray[i + 1]) {
-				index = i + 1;
-			}
-			else if(key >= nodeInt->keyArray[i] && (i == nodeOccupancy - 1 || nodeInt->keyArray[i + 1] == INT32_MAX)) {
-				index = i + 1;
-			}
-		}
+		index = findChildIndex(nodeInt, key, false);
 
 		Page* child;
-		bufMgr->readPage(file, ((NonLeafNodeInt*) page)->pageNoArray[index], child);
+		readPage(((NonLeafNodeInt*) page)->pageNoArray[index], child);
 		traverse(child, ((NonLeafNodeInt*) child)->level, keyPtr, leafID);
 
-		bufMgr->unPinPage(file, ((NonLeafNodeInt*) page)->pageNoArray[index], false);
+		unpinPage(((NonLeafNodeInt*) page)->pageNoArray[index], false);
 	} else {
 		int key = *((int*) keyPtr);
 		NonLeafNodeInt* nodeInt = (NonLeafNodeInt*) page;
 
-		for(int i = 0; i < nodeOccupancy; i++) {
-			if(key < nodeInt->keyArray[0]) {
-				index = 0; 
-			}
-			else if(key >= nodeInt->keyArray[i] && !(i == nodeOccupancy - 1 || nodeInt->keyArray[i+1] == INT32_MAX) && key < nodeInt->keyArray[i + 1]) {
-				index = i + 1;
-			}
-			else if(key >= nodeInt->keyArray[i] && (i == nodeOccupancy - 1 || nodeInt->keyArray[i + 1] == INT32_MAX)) {
-				index = i + 1;
-			}
-		}
+		index = findChildIndex(nodeInt, key, false);
         
 		leafID = ((NonLeafNodeInt*) page)->pageNoArray[index];
 	}
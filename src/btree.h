@@ -11,11 +11,21 @@
 #include <string>
 #include "string.h"
 #include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
 
 #include "types.h"
 #include "page.h"
 #include "file.h"
 #include "buffer.h"
+#include "async_io.h"
+#include "node_arena.h"
 
 namespace badgerdb
 {
@@ -41,18 +51,115 @@ enum Operator
 	GT		/* Greater Than */
 };
 
+/**
+ * @brief Key range of a scan, as passed to BTreeIndex::startScan().
+ */
+struct ScanRange
+{
+	int lowVal;
+	Operator lowOp;
+	int highVal;
+	Operator highOp;
+};
+
+/**
+ * @brief Number of INTEGER keys in one 64 byte cache line.
+ */
+const int SUMMARYSTRIDE = 64 / sizeof( int );
+
+/**
+ * @brief An insert waiting in the buffer of a NONLEAF_BUFFERED non-leaf node to be flushed
+ * down to the leaves.
+ */
+struct BufferMessageInt{
+	int key;
+	RecordId rid;
+};
+
+/**
+ * @brief Node layout for INTEGER keys on index pages of PAGE_SIZE bytes.
+ * Every node structure and occupancy constant below is derived from this template. Only the
+ * layouts are parameterized: the index code uses the Page::SIZE instantiation alone, so an index
+ * of another page size needs BadgerDB built with that Page::SIZE.
+ */
+template <std::size_t PAGE_SIZE>
+struct IntNodeLayout{
+  /**
+   * Number of key slots in B+Tree leaf for INTEGER key.
+   */
+	//                                                    sibling ptr     high key            key               rid
+	static constexpr int LEAFSIZE = ( PAGE_SIZE - sizeof( PageId ) - sizeof( int ) ) / ( sizeof( int ) + sizeof( RecordId ) );
+
+  /**
+   * Number of key slots in B+Tree non-leaf for INTEGER key.
+   */
+	//                                                   level, high key   sibling ptr, extra pageNo        key       pageNo
+	static constexpr int NONLEAFSIZE = ( PAGE_SIZE - 2 * sizeof( int ) - 2 * sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
+
+  /**
+   * Number of key slots in a non-leaf node in NONLEAF_SUMMARY format. The tail of the key array
+   * holds one summary entry per cache line of keys.
+   */
+	static constexpr int SUMMARYNONLEAFSIZE = NONLEAFSIZE - ( NONLEAFSIZE + SUMMARYSTRIDE - 1 ) / SUMMARYSTRIDE;
+
+  /**
+   * Number of key slots in a non-leaf node in NONLEAF_BUFFERED format, and number of messages
+   * its buffer holds. The key slot past the last one counts the messages; they fill the rest of
+   * the key array and then the page numbers past the last child.
+   */
+	static constexpr int BUFFEREDNONLEAFSIZE = NONLEAFSIZE / 16;
+	static constexpr int BUFFERKEYMESSAGES = ( NONLEAFSIZE - BUFFEREDNONLEAFSIZE - 1 ) * sizeof( int ) / sizeof( BufferMessageInt );
+	static constexpr int BUFFERMESSAGES = BUFFERKEYMESSAGES + ( NONLEAFSIZE - BUFFEREDNONLEAFSIZE ) * sizeof( PageId ) / sizeof( BufferMessageInt );
+
+  /**
+   * Upper bound on the entries in a LEAF_COMPRESSED leaf: every entry needs at least a 2 byte key
+   * offset and a 2 byte slot number. The real number depends on the keys and rids stored.
+   */
+	//                                                        header                         key offset + slot
+	static constexpr int COMPRESSEDLEAFSIZE = ( PAGE_SIZE - 5 * sizeof( int ) ) / ( 2 * sizeof( std::uint16_t ) );
+
+  /**
+   * Upper bound on the rids stored inside a LEAF_POSTINGS leaf.
+   */
+	//                                                      sibling ptr   high key, counts           rid
+	static constexpr int POSTINGSLEAFSIZE = ( PAGE_SIZE - sizeof( PageId ) - 2 * sizeof( int ) ) / sizeof( RecordId );
+
+  /**
+   * Number of rids in a postings overflow page.
+   */
+	//                                                         next, tail, count           rid
+	static constexpr int POSTINGSOVERFLOWSIZE = ( PAGE_SIZE - 3 * sizeof( PageId ) ) / sizeof( RecordId );
+};
 
 /**
  * @brief Number of key slots in B+Tree leaf for INTEGER key.
  */
-//                                                  sibling ptr             key               rid
-const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
+const  int INTARRAYLEAFSIZE = IntNodeLayout<Page::SIZE>::LEAFSIZE;
 
 /**
  * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
  */
-//                                                     level     extra pageNo                  key       pageNo
-const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
+const  int INTARRAYNONLEAFSIZE = IntNodeLayout<Page::SIZE>::NONLEAFSIZE;
+
+/**
+ * @brief Layout of the non-leaf nodes of an index. Chosen when the index file is created.
+ */
+enum NonLeafFormat
+{
+	NONLEAF_PLAIN = 0,		/* keyArray and pageNoArray only */
+	NONLEAF_SUMMARY = 1,	/* plain layout plus a copy of every SUMMARYSTRIDE-th key, searched first */
+	NONLEAF_BUFFERED = 2	/* fewer keys plus a buffer of inserts flushed to the children in batches */
+};
+
+/**
+ * @brief Layout of the leaf nodes of an index. Chosen when the index file is created.
+ */
+enum LeafFormat
+{
+	LEAF_PLAIN = 0,			/* LeafNodeInt: keyArray and ridArray */
+	LEAF_COMPRESSED = 1,	/* CompressedLeafNodeInt: frame of reference keys and rids grouped by page */
+	LEAF_POSTINGS = 2		/* PostingsLeafNodeInt: each key once, followed by its sorted rids */
+};
 
 // const int INT_MAX = (sizeof(int) == 4) ? INT32_MAX : INT64_MAX; 
 
@@ -88,10 +195,20 @@ public:
 	}
 };
 
+/**
+ * @brief Orders record ids by page number and then slot number, i.e. in heap file order.
+*/
+inline bool ridLess( const RecordId& r1, const RecordId& r2 )
+{
+	if( r1.page_number != r2.page_number )
+		return r1.page_number < r2.page_number;
+	else
+		return r1.slot_number < r2.slot_number;
+}
+
 /**
  * @brief Overloaded operator to compare the key values of two rid-key pairs
- * and if they are the same compares to see if the first pair has
- * a smaller rid.pageNo value.
+ * and if they are the same compares their rids in heap file order.
 */
 template <class T>
 bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
@@ -99,9 +216,66 @@ bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
 	if( r1.key != r2.key )
 		return r1.key < r2.key;
 	else
-		return r1.rid.page_number < r2.rid.page_number;
+		return ridLess( r1.rid, r2.rid );
 }
 
+/**
+ * @brief Number of leaves a scan reads through the buffer pool before it counts as long and
+ * reads further leaves into the scan ring instead, and the number of page buffers in that ring.
+ */
+const int SCANRINGTHRESHOLD = 8;
+const int SCANRINGSIZE = 8;
+
+/**
+ * @brief Number of page reads BTreeIndex::lookupBatch() and BTreeIndex::scanAsync() keep in flight.
+ */
+const int ASYNCQUEUEDEPTH = 64;
+
+/**
+ * @brief Number of lookups BTreeIndex::probeInterleaved() keeps in progress by default.
+ */
+const int PROBEGROUPSIZE = 16;
+
+/**
+ * @brief Number of buckets of the equi-depth key histogram kept in the index statistics.
+ */
+const int STATSHISTOGRAMSIZE = 32;
+
+/**
+ * @brief Number of side-log entries BTreeIndex::finishBuild() applies while writers wait; larger
+ * side-logs are applied in catch-up rounds that writers keep appending during.
+ */
+const int BUILDCATCHUPENTRIES = 1024;
+
+/**
+ * @brief Number of buckets of the leaf fill distribution, each covering a tenth of a page.
+ */
+const int STATSFILLBUCKETS = 10;
+
+/**
+ * @brief Summary of the index statistics stored in the meta page, so that cardinality
+ * estimates do not need a walk of the tree. Refreshed by BTreeIndex::collectStats().
+*/
+struct IndexStatsSummary{
+  /**
+   * Number of index entries (rids) and of distinct keys among them.
+   */
+	std::int64_t numEntries;
+	std::int64_t numDistinctKeys;
+
+  /**
+   * Smallest and largest key. Only meaningful if numEntries is not 0.
+   */
+	int minKey;
+	int maxKey;
+
+  /**
+   * Upper bounds of the equi-depth histogram buckets: about numEntries / STATSHISTOGRAMSIZE
+   * entries have keys in (histogram[b-1], histogram[b]], and histogram[STATSHISTOGRAMSIZE-1] is maxKey.
+   */
+	int histogram[STATSHISTOGRAMSIZE];
+};
+
 /**
  * @brief The meta page, which holds metadata for Index file, is always first page of the btree index file and is cast
  * to the following structure to store or retrieve information from it.
@@ -110,6 +284,12 @@ bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
  * of the root page. Root page starts as page 2 but since a split can occur
  * at the root the root page may get moved up and get a new page no.
 */
+/**
+ * @brief Version of the index file format. Index files of another version are rebuilt from the
+ * relation, or refused if the index is not built from one.
+ */
+const int INDEXFORMATVERSION = 3;
+
 struct IndexMetaInfo{
   /**
    * Name of base relation.
@@ -130,248 +310,1584 @@ struct IndexMetaInfo{
    * Page number of root page of the B+ Tree inside the file index file.
    */
 	PageId rootPageNo;
-};
 
-/*
-Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
-These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
-node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes 
-at this level are just above the leaf nodes. Otherwise set to 0.
-*/
+  /**
+   * Page size the index was built with. An index file can only be opened with the same page size.
+   */
+	int pageSize;
 
-/**
- * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
-*/
-struct NonLeafNodeInt{
   /**
-   * Level of the node in the tree.
+   * Smallest and largest key the index may hold: INT32_MIN and INT32_MAX, or the key range of its
+   * partition of a PartitionedIndex.
    */
-	int level;
+	int lowKey;
+	int highKey;
 
   /**
-   * Stores keys.
+   * Layout of the non-leaf nodes.
    */
-	int keyArray[ INTARRAYNONLEAFSIZE ];
+	NonLeafFormat nonLeafFormat;
 
+  /**
+   * Layout of the leaf nodes.
+   */
+	LeafFormat leafFormat;
 
   /**
-   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
+   * Percentage of a node kept full when it splits at the right (left) end of the tree under
+   * increasing (decreasing) keys. See IndexOptions::fillFactor.
    */
-	PageId pageNoArray[ INTARRAYNONLEAFSIZE + 1 ];
-};
+	int fillFactor;
 
+  /**
+   * Entry counts, key range and key histogram as of the last BTreeIndex::collectStats().
+   */
+	IndexStatsSummary stats;
 
-/**
- * @brief Structure for all leaf nodes when the key is of INTEGER type.
-*/
-struct LeafNodeInt{
   /**
-   * Stores keys.
+   * INDEXFORMATVERSION of the code that created the file.
    */
-	int keyArray[ INTARRAYLEAFSIZE ];
+	int formatVersion;
 
   /**
-   * Stores RecordIds.
+   * Whether the index is consistent with the relation file as of relationFingerprint: set by
+   * BTreeIndex::checkpoint() and the destructor once the build is complete, cleared by the first
+   * insert after them.
    */
-	RecordId ridArray[ INTARRAYLEAFSIZE ];
+	bool complete;
 
   /**
-   * Page number of the leaf on the right side.
-	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   * Hash of the size, modification time, page count and first and last pages of the relation
+   * file when complete was last set. It is of the file on disk: records written through a buffer
+   * pool count once their pages are flushed, and an index opened before then is taken as current.
+   * A change to a middle page that keeps the size and falls within the clock's granularity of the
+   * last write goes unseen.
    */
-	PageId rightSibPageNo;
-};
+	std::uint64_t relationFingerprint;
+
+  /**
+   * Records of the relation indexed, see BTreeIndex::tupleCount().
+   */
+	std::int64_t numTuples;
 
+  /**
+   * Pages of the file, this one included, when the meta page was last saved.
+   */
+	PageId numPages;
+};
 
 /**
- * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
- * relation. This index supports only one scan at a time.
+ * @brief Options for building a new index. The format options only apply when the index file
+ * is created; an existing index file is always opened with the format recorded in its IndexMetaInfo.
 */
-class BTreeIndex {
-
- private:
-
+struct IndexOptions{
   /**
-   * File object for the index file.
+   * Layout of the non-leaf nodes. In NONLEAF_BUFFERED format an insert waits in the buffer of
+   * the root and moves down one level at a time with a batch of inserts for the same child, so
+   * that a random insert costs a small share of a leaf write. Lookups read the buffers on their
+   * path; scans and collectStats() first apply the buffered inserts of their range to the leaves.
+   * With optimisticReads the buffers are applied when the index is opened and inserts go
+   * straight to the leaves.
    */
-	File		*file;
+	NonLeafFormat nonLeafFormat = NONLEAF_PLAIN;
 
   /**
-   * Buffer Manager Instance.
+   * Layout of the leaf nodes.
    */
-	BufMgr	*bufMgr;
+	LeafFormat leafFormat = LEAF_PLAIN;
 
   /**
-   * Page number of meta page.
+   * Percentage of a node kept full when an insert past the last key of the rightmost node (or
+   * before the first key of the leftmost node) splits it. Ever increasing keys then leave full
+   * nodes behind instead of half empty ones. 50 gives the classic split in the middle; other
+   * splits always divide the entries in half.
    */
-	PageId	headerPageNum;
+	int fillFactor = 100;
 
   /**
-   * page number of root page of B+ tree inside index file.
+   * Remember the leaf of the last insert and its key range, and insert following keys in that
+   * range directly into it without a descent from the root. Unlike the options above this one
+   * is not stored in the index file and applies whenever the index is opened.
    */
-	PageId	rootPageNum;
+	bool insertHint = true;
 
   /**
-   * Datatype of attribute over which index is built.
+   * Read the leaves of long scans past SCANRINGTHRESHOLD leaves straight from the index file into
+   * a small ring of page buffers owned by the index, instead of into the buffer pool, so that a
+   * big range scan does not evict the internal nodes and leaves other queries keep hot. Like
+   * insertHint this is not stored in the index file.
    */
-	Datatype	attributeType;
+	bool scanRing = true;
 
   /**
-   * Offset of attribute, over which index is built, inside records. 
+   * Let BTreeIndex::lookupOptimistic() and BTreeIndex::lookupLatched() run on any number of threads
+   * concurrently with inserts. Inserts still run one at a time: a single writer mutex serializes
+   * them, and only lookups proceed in parallel. The index keeps every page it has read pinned in
+   * the buffer pool, which must be able to hold the whole index; the constructor pins every page
+   * of the index and throws BufferExceededException if the pool cannot. Not stored in the index file.
    */
-	int 		attrByteOffset;
+	bool optimisticReads = false;
 
   /**
-   * Number of keys in leaf node, depending upon the type of key.
+   * Buffer up to deltaEntries inserts in an in-memory sorted delta in front of the tree and merge
+   * them into the leaves in key order once the delta is full, so that a burst of random inserts
+   * updates each leaf once per merge instead of once per entry. Scans and lookups read the delta
+   * together with the tree. 0 turns the delta off; so does optimisticReads. Not stored in the
+   * index file: checkpoint() and the destructor merge the delta.
    */
-	int			leafOccupancy;
+	int deltaEntries = 0;
 
   /**
-   * Number of keys in non-leaf node, depending upon the type of key.
+   * Partition of a PartitionedIndex that the index is, -1 if it indexes every key. A partition
+   * holds the keys in [lowKey, highKey], which are stored in the index file and must match when it
+   * is opened again, and the name of its file ends in ".p" and the partition number.
    */
-	int			nodeOccupancy;
+	int partition = -1;
+	int lowKey = INT32_MIN;
+	int highKey = INT32_MAX;
 
+  /**
+   * Insert an entry for every record of the relation when the index is opened. PartitionedIndex
+   * turns this off to scan the relation once and insert into all of its partitions itself.
+   */
+	bool buildFromRelation = true;
 
-	// MEMBERS SPECIFIC TO SCANNING
+  /**
+   * Build a newly created index online instead of in the constructor: the constructor returns at
+   * once, BTreeIndex::buildStep() scans the relation a few heap pages at a time, and inserts made
+   * meanwhile go to a side-log that BTreeIndex::finishBuild() applies. Replaces buildFromRelation.
+   */
+	bool onlineBuild = false;
 
   /**
-   * True if an index scan has been started.
+   * Most heap pages per second an online build reads, 0 for no limit, so that the build leaves
+   * the disk to foreground work.
    */
-	bool		scanExecuting;
+	int buildPagesPerSecond = 0;
 
   /**
-   * Index of next entry to be scanned in current leaf being scanned.
+   * Keep the nodes in a NodeArena of huge pages instead of buffer pool frames, for an index that
+   * is to stay resident. The index file is only read, if it exists, to load the index when it is
+   * opened, and only written by BTreeIndex::saveSnapshot(); the arena holds the pages of the same
+   * format and numbers as the file. Scans read no leaves past the arena into the scan ring, and
+   * the file reads of lookupBatch(), scanAsync() and probeInterleaved() become arena reads.
    */
-	int			nextEntry;
+	bool inMemory = false;
 
   /**
-   * Page number of current page being scanned.
+   * Frames of the buffer manager, which does not report its size, or 0 if not known. When known,
+   * probeInterleaved() keeps no more lookups in progress than half the pool can hold pinned.
    */
-	PageId	currentPageNum;
+	int poolFrames = 0;
+};
 
+/**
+ * @brief Space and shape statistics of an index, as returned by BTreeIndex::collectStats().
+*/
+struct IndexStats{
   /**
-   * Current Page being scanned.
+   * Number of levels, the leaf level included.
    */
-	Page		*currentPageData;
+	int height;
 
   /**
-   * Low INTEGER value for scan.
+   * Number of non-leaf pages.
    */
-	int			lowValInt;
+	int numNonLeafPages;
 
   /**
-   * Low DOUBLE value for scan.
+   * Number of leaf pages.
    */
-	double	lowValDouble;
+	int numLeafPages;
 
   /**
-   * Low STRING value for scan.
+   * Number of postings overflow pages.
    */
-	std::string	lowValString;
+	int numOverflowPages;
 
   /**
-   * High INTEGER value for scan.
+   * Number of pages on each level, the root level first and the leaf level last.
    */
-	int			highValInt;
+	std::vector<int> pagesPerLevel;
 
   /**
-   * High DOUBLE value for scan.
+   * Number of index entries (rids).
    */
-	double	highValDouble;
+	long numEntries;
 
   /**
-   * High STRING value for scan.
+   * Number of distinct keys. numEntries / numDistinctKeys is the average number of duplicates.
    */
-	std::string highValString;
-	
+	long numDistinctKeys;
+
   /**
-   * Low Operator. Can only be GT(>) or GTE(>=).
+   * Smallest and largest key. Only meaningful if numEntries is not 0.
    */
-	Operator	lowOp;
+	int minKey;
+	int maxKey;
 
   /**
-   * High Operator. Can only be LT(<) or LTE(<=).
+   * Average fraction of the key slots of non-leaf pages in use.
    */
-	Operator	highOp;
+	double avgNonLeafFill;
 
-	
- public:
+  /**
+   * Average fraction of the space of leaf pages in use.
+   */
+	double avgLeafFill;
 
   /**
-   * BTreeIndex Constructor. 
-	 * Check to see if the corresponding index file exists. If so, open the file.
-	 * If not, create it and insert entries for every tuple in the base relation using FileScan class.
-   *
-   * @param relationName        Name of file.
-   * @param outIndexName        Return the name of index file.
-   * @param bufMgrIn						Buffer Manager Instance
-   * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
-   * @param attrType						Datatype of attribute over which index is built
+   * Number of leaf pages by fill: bucket b counts leaves filled [b/10, (b+1)/10) of a page,
+   * the last bucket includes full leaves.
    */
-	BTreeIndex(const std::string & relationName, std::string & outIndexName,
-						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
-	
+	int leafFillHistogram[STATSFILLBUCKETS];
+
   /**
-   * BTreeIndex Destructor. 
-	 * End any initialized scan, flush index file, after unpinning any pinned pages, from the buffer manager
-	 * and delete file instance thereby closing the index file.
-	 * Destructor should not throw any exceptions. All exceptions should be caught in here itself. 
-	 * */
-	~BTreeIndex();
+   * Upper bounds of an equi-depth histogram of the keys, see IndexStatsSummary::histogram.
+   * Empty if the index is.
+   */
+	std::vector<int> histogram;
+};
 
+/**
+ * @brief Number of page slots in one chunk of the node table of optimistic reads, and the
+ * maximum number of chunks.
+ */
+const int OLCCHUNKSIZE = 4096;
+const int OLCMAXCHUNKS = 4096;
 
+/**
+ * @brief Entry of an index page in the node table of optimistic reads.
+ */
+struct OptimisticNode
+{
   /**
-   * @brief called when you insert into a node without having to split it. Find the index
-   * where the key goes; two cases: insert at index right away or shift slots and then insert
-   * 
-   * @param node the node where the key is being inserted
-   * @param newKey the key from the lower level and is being passed as a new key (after a split)
-   * @param newPageId the page id of node
-   * */
-  void insertNoSplit(NonLeafNodeInt* nodeId, const int newKey, const PageId newPageId);
-  // void insertionNL(NonLeafNodeInt* nodee, PageId newPageId, int i);
-  
+   * Version of the node, incremented when an insert starts and again when it finishes modifying
+   * the node. Odd while the node is being modified.
+   */
+	std::atomic<std::uint64_t> version;
+
   /**
-   * @brief Create a new leaf node and initializes the new node. 
-   * 
-   * */
-  PageId createLeafInt();
+   * Number of readers of BTreeIndex::lookupLatched() holding a latch on the node. An insert
+   * waits until it drops to 0 before it modifies the node.
+   */
+	std::atomic<std::uint32_t> readers;
 
   /**
-   * @brief Create a new non leaf node and initializes the new node. 
-   * 
-   * @param level the level at which the new non leaf node is at
-   * 
-   * */
-  PageId createNonLeafInt(int level);
+   * Buffer pool frame holding the page, kept pinned; nullptr until the page has been read.
+   */
+	std::atomic<Page*> page;
+};
 
+/**
+ * @brief What the page a lookup of BTreeIndex::lookupBatch() reads next is.
+ */
+enum LookupStage
+{
+	LOOKUP_NONLEAF = 0,
+	LOOKUP_LEAF = 1,
+	LOOKUP_OVERFLOW = 2
+};
 
-  /**
- * @brief called when you found the leaf node where the data is stored. finds index where
- * the key/rid needs to be inserted. makes appropiate insert based on, empty slot, 
- * shift and insert, or split and insert.
- * 
- * @param key key to be inserted
- * @param rid  rid to be inserted
- * @param pageId  the page id of the node we are looking at
- * @return PageId 
+/**
+ * @brief Where the lookups of BTreeIndex::probeInterleaved() read pages from: the buffer pool,
+ * prefetching each node into the CPU cache before they suspend, or the index file through the
+ * asynchronous reader.
  */
-  void insertLeafInt(int &key, const RecordId rid, PageId &pageId);
+enum ProbeSource
+{
+	PROBE_BUFFER_POOL = 0,
+	PROBE_FILE = 1
+};
 
-  /**
- * @brief This method traverses down the tree by following the correct search conditions. 
- * One a leaf node is next to be read it goes into insertLeafInt to insert the key and rid 
- * while checking if the node needs to be split. once you return back to the parent node with
- * the new key check if node needs to split. do recursively
- * 
- * @param key key to be inserted
- * @param rid  rid to be inserted
- * @param pageId  the page id of the node we are looking at
- * @return PageId 
+/**
+ * @brief Coroutine of one lookup of BTreeIndex::probeInterleaved(), defined in probe.cpp.
  */
-  void insertNonLeafInt(int &key, const RecordId rid, PageId &pageId);
+struct ProbeTask;
+
+/**
+ * @brief Operations whose cost in cycles BTreeIndex::getCounters() reports as histograms.
+ */
+enum TimedOperation
+{
+	INSERT_OP = 0,
+	STARTSCAN_OP = 1,
+	SCANNEXT_OP = 2,
+	NUMTIMEDOPS = 3
+};
+
+/**
+ * @brief Number of buckets of the cycle histograms. Bucket b counts operations that took
+ * [2^(b-1), 2^b) cycles; the last bucket also counts anything slower.
+ */
+const int CYCLEBUCKETS = 32;
+
+/**
+ * @brief Snapshot of the performance counters of an index, as returned by
+ * BTreeIndex::getCounters(). The counters are compiled out, and stay 0, when the index is
+ * built with BTREE_NO_COUNTERS defined.
+*/
+struct IndexCounters{
+  /**
+   * Descents from the root: inserts not served by the insert hint, and scan starts.
+   */
+	std::uint64_t descents;
+
+  /**
+   * Index pages read during descents, leaves included.
+   */
+	std::uint64_t nodesVisited;
+
+  /**
+   * Inserts that went straight into the hint leaf.
+   */
+	std::uint64_t hintHits;
+
+  /**
+   * Node splits.
+   */
+	std::uint64_t leafSplits;
+	std::uint64_t nonLeafSplits;
+
+  /**
+   * Index pages pinned, and how many of those pins had to read the page from disk.
+   */
+	std::uint64_t pins;
+	std::uint64_t bufferMisses;
+
+  /**
+   * Moves of a scan to the right sibling leaf, and rids returned by scans.
+   */
+	std::uint64_t siblingHops;
+	std::uint64_t scanEntries;
+
+  /**
+   * Leaves of long scans read into the scan ring rather than pinned in the buffer pool.
+   */
+	std::uint64_t scanRingReads;
+
+  /**
+   * Pages read by lookupBatch() and scanAsync() through the asynchronous reader.
+   */
+	std::uint64_t asyncReads;
+
+  /**
+   * Moves of a descent to the right sibling of a node that split after its parent was read.
+   */
+	std::uint64_t rightMoves;
+
+  /**
+   * Descents from the root of BTreeIndex::scanSkipTo() to a leaf past the next one.
+   */
+	std::uint64_t skipDescents;
+
+  /**
+   * Heap pages an online build has scanned, side-log entries it has applied, and of those the
+   * ones applied in the last catch-up round, while writers waited.
+   */
+	std::uint64_t buildPages;
+	std::uint64_t sideLogApplied;
+	std::uint64_t finalCatchUpEntries;
+
+  /**
+   * Calls of compact().
+   */
+	std::uint64_t compactions;
+
+  /**
+   * Merges of the delta into the tree, and the entries they merged.
+   */
+	std::uint64_t deltaMerges;
+	std::uint64_t deltaEntriesMerged;
+
+  /**
+   * Batches flushed from the buffer of a NONLEAF_BUFFERED node to a child, and the inserts they
+   * moved. Inserts applied straight to the leaves ahead of a scan or collectStats() count too.
+   */
+	std::uint64_t bufferFlushes;
+	std::uint64_t bufferMessagesFlushed;
+
+  /**
+   * Number of timed operations and histograms of their cycles, per TimedOperation. Only every
+   * n-th operation is timed, see BTreeIndex::setTimingSampleRate().
+   */
+	std::uint64_t timedOps[NUMTIMEDOPS];
+	std::uint64_t cycles[NUMTIMEDOPS][CYCLEBUCKETS];
+};
+
+#ifndef BTREE_NO_COUNTERS
+#define BTREE_COUNT(counter, n) (counters.counter += (n))
+#else
+#define BTREE_COUNT(counter, n) ((void) 0)
+#endif
+
+/*
+Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
+These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
+node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes 
+at this level are just above the leaf nodes. Otherwise set to 0.
+
+Every node also carries a high key and a link to its right sibling on the same level, as in a
+B-link tree. A split sets the high key of the left node to the separator it passes up and links
+the left node to the new one, so that a search for a key past the high key of a node it reached
+through a parent read before the split moves right instead of starting over.
+*/
+
+/**
+ * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+*/
+template <std::size_t PAGE_SIZE>
+struct NonLeafNodeIntT{
+  /**
+   * Number of key slots in this layout.
+   */
+	static constexpr int SIZE = IntNodeLayout<PAGE_SIZE>::NONLEAFSIZE;
+
+  /**
+   * Level of the node in the tree.
+   */
+	int level;
+
+  /**
+   * Largest key the subtree of this node may hold; keys past it are right of rightSibPageNo.
+   * INT32_MAX for the rightmost node of its level.
+   */
+	int highKey;
+
+  /**
+   * Page number of the node on the right side on the same level, Page::INVALID_NUMBER for the
+   * rightmost node.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Stores keys.
+   */
+	int keyArray[ SIZE ];
+
+
+  /**
+   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
+   */
+	PageId pageNoArray[ SIZE + 1 ];
+};
+
+
+/**
+ * @brief Structure for all leaf nodes when the key is of INTEGER type.
+*/
+template <std::size_t PAGE_SIZE>
+struct LeafNodeIntT{
+  /**
+   * Number of key slots in this layout.
+   */
+	static constexpr int SIZE = IntNodeLayout<PAGE_SIZE>::LEAFSIZE;
+
+  /**
+   * Stores keys.
+   */
+	int keyArray[ SIZE ];
+
+  /**
+   * Stores RecordIds.
+   */
+	RecordId ridArray[ SIZE ];
+
+  /**
+   * Page number of the leaf on the right side.
+	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Largest key the leaf may hold: the separator passed up when it split, INT32_MAX for the
+   * rightmost leaf. The leaf on the right holds no smaller key.
+   */
+	int highKey;
+};
+
+/**
+ * @brief Run of consecutive entries of a compressed leaf whose rids are on the same page.
+ */
+struct RidRun{
+  /**
+   * Page number shared by the rids of the run.
+   */
+	PageId pageNo;
+
+  /**
+   * Number of entries in the run.
+   */
+	std::uint32_t length;
+};
+
+/**
+ * @brief Structure for leaf nodes in LEAF_COMPRESSED format when the key is of INTEGER type.
+ * data holds, in order, numRuns RidRuns, numEntries key offsets from baseKey of keyBytes (2 or 4)
+ * bytes each, and numEntries 2 byte slot numbers. Entries are in key order, so a leaf built from
+ * mostly increasing keys and rids needs little more than 4 bytes per entry.
+*/
+template <std::size_t PAGE_SIZE>
+struct CompressedLeafNodeIntT{
+  /**
+   * Bytes available for runs, key offsets and slot numbers.
+   */
+	static constexpr int DATASIZE = PAGE_SIZE - 5 * sizeof( int );
+
+  /**
+   * Page number of the leaf on the right side.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Smallest key in the leaf. Keys are stored as unsigned offsets from it.
+   */
+	int baseKey;
+
+  /**
+   * Largest key the leaf may hold, as LeafNodeIntT::highKey.
+   */
+	int highKey;
+
+  /**
+   * Number of entries in the leaf.
+   */
+	std::uint16_t numEntries;
+
+  /**
+   * Number of RidRuns at the start of data.
+   */
+	std::uint16_t numRuns;
+
+  /**
+   * Size in bytes of each key offset.
+   */
+	std::uint16_t keyBytes;
+
+  /**
+   * Padding, keeps data 4 byte aligned.
+   */
+	std::uint16_t unused;
+
+  /**
+   * Runs, key offsets and slot numbers.
+   */
+	char data[ DATASIZE ];
+};
+
+/**
+ * @brief Postings list header in a LEAF_POSTINGS leaf: one per distinct key.
+ */
+struct PostingInt{
+  /**
+   * The key.
+   */
+	int key;
+
+  /**
+   * Number of rids with this key.
+   */
+	std::uint32_t numRids;
+
+  /**
+   * First overflow page holding the rids once the list has spilled out of the leaf,
+   * Page::INVALID_NUMBER while the rids are stored in the leaf.
+   */
+	PageId overflowPageNo;
+};
+
+/**
+ * @brief Structure for leaf nodes in LEAF_POSTINGS format when the key is of INTEGER type.
+ * data holds numPostings PostingInts in key order followed by the numRids in-leaf rids of those
+ * postings, in the same order and each list sorted with ridLess(). All rids of a key live in
+ * one leaf, so a run of duplicates never spans leaves.
+*/
+template <std::size_t PAGE_SIZE>
+struct PostingsLeafNodeIntT{
+  /**
+   * Bytes available for postings and rids.
+   */
+	static constexpr int DATASIZE = PAGE_SIZE - sizeof( PageId ) - 2 * sizeof( int );
+
+  /**
+   * Page number of the leaf on the right side.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Largest key the leaf may hold, as LeafNodeIntT::highKey.
+   */
+	int highKey;
+
+  /**
+   * Number of PostingInts at the start of data.
+   */
+	std::uint16_t numPostings;
+
+  /**
+   * Number of rids stored after the postings.
+   */
+	std::uint16_t numRids;
+
+  /**
+   * Postings and rids.
+   */
+	char data[ DATASIZE ];
+};
+
+/**
+ * @brief Overflow page of a postings list that has spilled out of its leaf. The pages of a list
+ * form a chain that keeps the rids sorted with ridLess().
+*/
+template <std::size_t PAGE_SIZE>
+struct PostingsOverflowPageT{
+  /**
+   * Number of rid slots in this layout.
+   */
+	static constexpr int SIZE = IntNodeLayout<PAGE_SIZE>::POSTINGSOVERFLOWSIZE;
+
+  /**
+   * Next page of the chain.
+   */
+	PageId nextPageNo;
+
+  /**
+   * Last page of the chain. Only kept up to date on the first page.
+   */
+	PageId tailPageNo;
+
+  /**
+   * Number of rids on this page.
+   */
+	std::uint32_t numRids;
+
+  /**
+   * Stores RecordIds.
+   */
+	RecordId ridArray[ SIZE ];
+};
+
+/**
+ * @brief Node structures for the page size the buffer manager is built with, the only ones the
+ * index code works on.
+ */
+typedef NonLeafNodeIntT<Page::SIZE> NonLeafNodeInt;
+typedef LeafNodeIntT<Page::SIZE> LeafNodeInt;
+typedef CompressedLeafNodeIntT<Page::SIZE> CompressedLeafNodeInt;
+typedef PostingsLeafNodeIntT<Page::SIZE> PostingsLeafNodeInt;
+typedef PostingsOverflowPageT<Page::SIZE> PostingsOverflowPage;
+
+/**
+ * @brief Upper bound on the entries of a leaf in either format.
+ */
+const int INTARRAYCOMPRESSEDLEAFSIZE = IntNodeLayout<Page::SIZE>::COMPRESSEDLEAFSIZE;
+
+/**
+ * @brief Upper bound on the rids stored inside a postings leaf.
+ */
+const int INTARRAYPOSTINGSLEAFSIZE = IntNodeLayout<Page::SIZE>::POSTINGSLEAFSIZE;
+
+/**
+ * @brief Longest postings list kept inside a leaf. A longer list moves to overflow pages.
+ */
+const int POSTINGSINLINESIZE = 64;
+
+/**
+ * @brief Number of key slots, and of buffered inserts, of a NONLEAF_BUFFERED non-leaf node.
+ */
+const int INTARRAYBUFFEREDNONLEAFSIZE = IntNodeLayout<Page::SIZE>::BUFFEREDNONLEAFSIZE;
+const int NONLEAFBUFFERSIZE = IntNodeLayout<Page::SIZE>::BUFFERMESSAGES;
+
+static_assert( sizeof( NonLeafNodeInt ) <= Page::SIZE, "non-leaf node does not fit in a page" );
+static_assert( sizeof( LeafNodeInt ) <= Page::SIZE, "leaf node does not fit in a page" );
+static_assert( sizeof( CompressedLeafNodeInt ) <= Page::SIZE, "compressed leaf node does not fit in a page" );
+static_assert( sizeof( PostingsLeafNodeInt ) <= Page::SIZE, "postings leaf node does not fit in a page" );
+static_assert( sizeof( PostingsOverflowPage ) <= Page::SIZE, "postings overflow page does not fit in a page" );
+
+/**
+ * @brief Number of keys in use in a node with capacity key slots. Unused key slots hold
+ * INT32_MAX and always follow the used ones, so this is a binary search for the first padding slot.
+ */
+template <class Node>
+inline int nodeKeyCount( const Node* node, int capacity = Node::SIZE )
+{
+	return std::lower_bound( node->keyArray, node->keyArray + capacity, INT32_MAX ) - node->keyArray;
+}
+
+/**
+ * @brief Index of the child of a non-leaf node to follow for key. With upper set this is the
+ * number of separator keys less than or equal to key (the scan descent), otherwise the number
+ * of separator keys less than key (the insert descent).
+ */
+template <class Node>
+inline int nonLeafChildIndex( const Node* node, int key, bool upper = true, int capacity = Node::SIZE )
+{
+	const int* last = node->keyArray + nodeKeyCount( node, capacity );
+	return ( upper ? std::upper_bound( node->keyArray, last, key )
+			: std::lower_bound( node->keyArray, last, key ) ) - node->keyArray;
+}
+
+/**
+ * @brief nonLeafChildIndex() for a NONLEAF_SUMMARY node. keyArray[capacity + b] holds
+ * keyArray[b * SUMMARYSTRIDE], so the search reads the compact summary and then a single
+ * cache line of keys instead of probing across the whole page.
+ */
+template <class Node>
+inline int summaryChildIndex( const Node* node, int key, bool upper, int capacity )
+{
+	const int* summary = node->keyArray + capacity;
+	const int* summaryEnd = summary + ( capacity + SUMMARYSTRIDE - 1 ) / SUMMARYSTRIDE;
+	int block = ( upper ? std::upper_bound( summary, summaryEnd, key )
+			: std::lower_bound( summary, summaryEnd, key ) ) - summary;
+	if( block == 0 )
+		return 0;
+
+	const int* first = node->keyArray + ( block - 1 ) * SUMMARYSTRIDE;
+	const int* last = node->keyArray + std::min( capacity, block * SUMMARYSTRIDE );
+	return ( upper ? std::upper_bound( first, last, key )
+			: std::lower_bound( first, last, key ) ) - node->keyArray;
+}
+
+/**
+ * @brief Index of the first slot of a leaf whose key is not less than key.
+ * Equals nodeKeyCount() when every key in the leaf is smaller.
+ */
+template <class Node>
+inline int leafLowerBound( const Node* node, int key )
+{
+	return std::lower_bound( node->keyArray, node->keyArray + nodeKeyCount( node ), key ) - node->keyArray;
+}
+
+/**
+ * @brief True if key lies past the high key of a node that has a right sibling, so that a
+ * search for it has to move right. Works for every node structure above.
+ */
+template <class Node>
+inline bool pastHighKey( const Node* node, int key )
+{
+	return node->rightSibPageNo != Page::INVALID_NUMBER && key > node->highKey;
+}
+
+
+/**
+ * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
+ * relation. This index supports only one scan at a time.
+*/
+class FileScan;
+
+class BTreeIndex {
+
+ private:
+
+  /**
+   * File object for the index file. Null for an in-memory index, see IndexOptions::inMemory.
+   */
+	File		*file;
+
+  /**
+   * Nodes of an in-memory index, null for an index in the buffer pool.
+   */
+	NodeArena	*arena;
+
+  /**
+   * Name of the index file.
+   */
+	std::string	indexFileName;
+
+  /**
+   * Pages allocated in the index file, the meta page included. An in-memory index counts the
+   * pages of its arena instead.
+   */
+	PageId		numIndexPages;
+
+  /**
+   * Buffer Manager Instance.
+   */
+	BufMgr	*bufMgr;
+
+  /**
+   * Page number of meta page.
+   */
+	PageId	headerPageNum;
+
+  /**
+   * page number of root page of B+ tree inside index file.
+   */
+	PageId	rootPageNum;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+	Datatype	attributeType;
+
+  /**
+   * Offset of attribute, over which index is built, inside records. 
+   */
+	int 		attrByteOffset;
+
+  /**
+   * Number of keys in leaf node, depending upon the type of key.
+   */
+	int			leafOccupancy;
+
+  /**
+   * Number of keys in non-leaf node, depending upon the type of key.
+   */
+	int			nodeOccupancy;
+
+  /**
+   * Layout of the non-leaf nodes, read from the meta page.
+   */
+	NonLeafFormat	nonLeafFormat;
+
+  /**
+   * Layout of the leaf nodes, read from the meta page.
+   */
+	LeafFormat	leafFormat;
+
+  /**
+   * Percentage of a node kept full by a split at the right or left end of the tree.
+   */
+	int			fillFactor;
+
+  /**
+   * True while the insert in progress follows the rightmost (leftmost) child at every level
+   * visited so far. Used to recognise appends to the end (start) of the key range.
+   */
+	bool		insertRightmost;
+	bool		insertLeftmost;
+
+  /**
+   * Fence of the keys routed into the subtree the insert in progress has descended into:
+   * (low, high] under the insert descent, [low, high) for LEAF_POSTINGS. The int64 sentinels
+   * INT64_MIN and INT64_MAX stand for an open end.
+   */
+	std::int64_t	insertLowFence;
+	std::int64_t	insertHighFence;
+
+  /**
+   * Leaf the last insert went into without splitting it, with its fence. insertEntryInt() goes
+   * straight to this leaf for keys inside the fence as long as it has room for them.
+   * Page::INVALID_NUMBER when there is no hint or insertHint is off.
+   */
+	PageId		hintLeafPageNum;
+	std::int64_t	hintLowFence;
+	std::int64_t	hintHighFence;
+
+  /**
+   * Whether insertEntryInt() uses the hint leaf. See IndexOptions::insertHint.
+   */
+	bool		insertHint;
+
+  /**
+   * True while compact() inserts the entries of the index in key order: each goes after every
+   * entry of the rightmost leaf, with no fence check and no search for its place.
+   */
+	bool		insertAppend;
+
+  /**
+   * Whether long scans read leaves into scanRing, see IndexOptions::scanRing.
+   */
+	bool		useScanRing;
+
+  /**
+   * Inserts not yet merged into the tree, in key order and, for equal keys, in insert order.
+   * Merged once it holds deltaCapacity entries and no scan is executing; deltaCapacity is 0 if
+   * the delta is off.
+   */
+	std::multimap<int, RecordId>	delta;
+	int		deltaCapacity;
+
+  /**
+   * Online build: the scan of the relation, null once it has ended, the offset of the key in its
+   * records, and a record the last buildStep() read from the next page but did not insert.
+   */
+	FileScan*	buildScan;
+	int			buildAttrOffset;
+	bool		buildPending;
+	int			buildPendingKey;
+	RecordId	buildPendingRid;
+	PageId		buildPageNo;
+
+  /**
+   * Throttle of the online build: pages per second allowed, 0 for no limit, pages read so far and
+   * the time the scan started.
+   */
+	int			buildPagesPerSecond;
+	std::int64_t	buildReadPages;
+	std::chrono::steady_clock::time_point	buildStartTime;
+
+  /**
+   * True from the constructor of an online build until finishBuild() has applied the side-log.
+   * While it is, insertEntryInt() appends to sideLog under sideLogMutex instead of inserting.
+   */
+	std::atomic<bool>	onlineBuilding;
+
+  /**
+   * Name of the relation file, whose fingerprint the meta page records.
+   */
+	std::string	relationFileName;
+
+  /**
+   * Records the index holds entries for: those the build inserted and those inserted since.
+   */
+	std::int64_t	numTuples;
+
+  /**
+   * Whether the meta page marks the index complete. The first insert after it was marked clears
+   * the mark, so that an index a crash leaves half written is rebuilt when opened.
+   */
+	bool		metaComplete;
+	std::mutex	sideLogMutex;
+	std::vector<std::pair<int, RecordId>>	sideLog;
+
+  /**
+   * Whether inserts go into the buffer of the root rather than down to a leaf: true for
+   * NONLEAF_BUFFERED indexes unless optimisticReads is on, and false while applyBuffers() runs.
+   */
+	bool		bufferInserts;
+
+  /**
+   * Page buffers that the leaves of long scans are read into round-robin; scanRingNext is the
+   * next one to use.
+   */
+	std::vector<Page>	scanRing;
+	int			scanRingNext;
+
+  /**
+   * True while the index file holds every change to the index, so that pages can be read from
+   * the file directly. Inserts clear it.
+   */
+	bool		fileInSync;
+
+  /**
+   * Number of leaves the current scan has read, and whether its current leaf is in the scan ring
+   * rather than pinned in the buffer pool.
+   */
+	int			scanLeavesRead;
+	bool		currentPageInRing;
+
+  /**
+   * Performance counters, see getCounters().
+   */
+	IndexCounters	counters;
+
+  /**
+   * Time one in timingSampleRate operations, 0 for none; timingCountdown operations are left
+   * until the next timed one.
+   */
+	int			timingSampleRate;
+	int			timingCountdown;
+
+  /**
+   * Copy of the statistics summary in the meta page.
+   */
+	IndexStatsSummary	storedStats;
+
+  /**
+   * Rank of the first entry (counting from the smallest key) and page number of every leaf, in key
+   * order, recorded by a collectStats() walk to find the histogram bounds afterwards.
+   */
+	std::vector<std::pair<std::int64_t, PageId>>	statsLeaves;
+
+  /**
+   * Largest key of the leaves visited so far by a collectStats() walk.
+   */
+	int			statsLastKey;
+
+  /**
+   * Decoded entries of a compressed leaf being inserted into. One slot more than a leaf can
+   * hold, for the entry that causes a split.
+   */
+	std::vector<int>	leafKeyBuf;
+	std::vector<RecordId>	leafRidBuf;
+
+  /**
+   * Decoded postings of a postings leaf being inserted into; its rids go to leafRidBuf.
+   */
+	std::vector<PostingInt>	leafPostingBuf;
+
+  /**
+   * Reader of lookupBatch() and scanAsync(), opened on first use, and the page buffers it reads
+   * into: ASYNCQUEUEDEPTH for a window of reads plus one for overflow pages.
+   */
+	AsyncPageReader	*asyncReader;
+	std::vector<Page>	asyncPages;
+
+  /**
+   * Decoded entries of the compressed or postings leaf being looked at by lookupBatch(),
+   * scanAsync() or probeInterleaved().
+   */
+	std::vector<int>	asyncKeyBuf;
+	std::vector<RecordId>	asyncRidBuf;
+
+  /**
+   * Whether lookups may run concurrently with inserts, see IndexOptions::optimisticReads.
+   */
+	bool		optimisticReads;
+
+  /**
+   * Frames of bufMgr, 0 if not known, see IndexOptions::poolFrames.
+   */
+	int		poolFrames;
+
+  /**
+   * Node table of optimistic reads: chunk c holds the OptimisticNode of pages
+   * [c * OLCCHUNKSIZE, (c + 1) * OLCCHUNKSIZE). OLCMAXCHUNKS chunk pointers, nullptr until the
+   * chunk is needed; the array itself is nullptr unless optimisticReads is on.
+   */
+	std::atomic<OptimisticNode*>	*olcChunks;
+
+  /**
+   * Serializes inserts, and the buffer manager calls of concurrent lookups, while optimisticReads is on.
+   */
+	std::mutex	olcWriteMutex;
+
+
+	// MEMBERS SPECIFIC TO SCANNING
+
+  /**
+   * True if an index scan has been started.
+   */
+	bool		scanExecuting;
+
+  /**
+   * Index of next entry to be scanned in current leaf being scanned.
+   */
+	int			nextEntry;
+
+  /**
+   * Page number of current page being scanned.
+   */
+	PageId	currentPageNum;
+
+  /**
+   * Current Page being scanned.
+   */
+	Page		*currentPageData;
+
+  /**
+   * Keys, rids and entry count of the leaf being scanned. They point into the pinned page for
+   * LEAF_PLAIN leaves and into scanKeyBuf/scanRidBuf for decoded LEAF_COMPRESSED and
+   * LEAF_POSTINGS leaves. A postings list that has spilled to overflow pages is a single
+   * entry whose rid has slot number Page::INVALID_SLOT and the first overflow page as page number.
+   */
+	const int*	scanKeys;
+	const RecordId*	scanRids;
+	int			scanCount;
+
+  /**
+   * Next delta entry the scan returns, and the first one past its range. Entries of the delta
+   * are returned after the entries of the tree with the same key.
+   */
+	std::multimap<int, RecordId>::const_iterator	scanDeltaNext;
+	std::multimap<int, RecordId>::const_iterator	scanDeltaEnd;
+
+  /**
+   * Right sibling of the leaf being scanned.
+   */
+	PageId	scanRightSibPageNo;
+
+  /**
+   * Decoded entries of the compressed leaf being scanned.
+   */
+	std::vector<int>	scanKeyBuf;
+	std::vector<RecordId>	scanRidBuf;
+
+  /**
+   * Overflow page being scanned when the scan is inside a spilled postings list,
+   * else Page::INVALID_NUMBER.
+   */
+	PageId	overflowPageNum;
+
+  /**
+   * Pinned overflow page being scanned.
+   */
+	Page		*overflowPageData;
+
+  /**
+   * Index of the next rid to return from the overflow page.
+   */
+	int			overflowEntry;
+
+  /**
+   * Low INTEGER value for scan.
+   */
+	int			lowValInt;
+
+  /**
+   * Low DOUBLE value for scan.
+   */
+	double	lowValDouble;
+
+  /**
+   * Low STRING value for scan.
+   */
+	std::string	lowValString;
+
+  /**
+   * High INTEGER value for scan.
+   */
+	int			highValInt;
+
+  /**
+   * High DOUBLE value for scan.
+   */
+	double	highValDouble;
+
+  /**
+   * High STRING value for scan.
+   */
+	std::string highValString;
+	
+  /**
+   * Low Operator. Can only be GT(>) or GTE(>=).
+   */
+	Operator	lowOp;
+
+  /**
+   * High Operator. Can only be LT(<) or LTE(<=).
+   */
+	Operator	highOp;
+
+  /**
+   * Ranges of a scan started with startMultiScan(), empty for startScan(), and the one being
+   * scanned. The members above hold the current range.
+   */
+	std::vector<ScanRange> scanRanges;
+	std::size_t scanRangeIndex;
+
+	
+ public:
+
+  /**
+   * BTreeIndex Constructor. 
+	 * Check to see if the corresponding index file exists. If so, open the file.
+	 * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+	 * An existing index built from the relation is opened by reading its meta page alone if the
+	 * meta page marks it complete for the relation file as it is now; otherwise it is rebuilt.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn						Buffer Manager Instance
+   * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
+   * @param attrType						Datatype of attribute over which index is built
+   * @param options						Format options used if the index file has to be created
+   * @throws BadIndexInfoException If attrType is not INTEGER, or an existing index file does not
+   * match the arguments
+   * @throws BufferExceededException If options.optimisticReads is set and the buffer pool cannot
+   * hold the whole index
+   */
+	BTreeIndex(const std::string & relationName, std::string & outIndexName,
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const IndexOptions & options = IndexOptions());
+	
+  /**
+   * BTreeIndex Destructor. 
+	 * End any initialized scan, flush index file, after unpinning any pinned pages, from the buffer manager
+	 * and delete file instance thereby closing the index file.
+	 * Destructor should not throw any exceptions. All exceptions should be caught in here itself. 
+	 * */
+	~BTreeIndex();
+
+
+  /**
+   * @brief called when you insert into a node without having to split it. The new key and page go
+   * right after child i, the one that split, which a search for the key can miss among equal
+   * separators; two cases: insert at index right away or shift slots and then insert
+   * 
+   * @param node the node where the key is being inserted
+   * @param i index of the child that split
+   * @param newKey the key from the lower level and is being passed as a new key (after a split)
+   * @param newPageId the page id of node
+   * */
+  void insertNoSplit(NonLeafNodeInt* nodeId, int i, const int newKey, const PageId newPageId);
+
+  /**
+   * @brief Index of the child to follow for key in a non-leaf node, using the key summary
+   * when the index is in NONLEAF_SUMMARY format.
+   *
+   * @param node the non-leaf node being searched
+   * @param key the search key
+   * @param upper true to follow equal keys to the right (scans), false to the left (inserts)
+   * */
+  int findChildIndex(const NonLeafNodeInt* node, int key, bool upper);
+
+  /**
+   * @brief Rebuild the key summary of a NONLEAF_SUMMARY node after its keys changed at or
+   * after index from. Does nothing for NONLEAF_PLAIN nodes.
+   * */
+  void updateSummary(NonLeafNodeInt* node, int from);
+  // void insertionNL(NonLeafNodeInt* nodee, PageId newPageId, int i);
+  
+  /**
+   * @brief Create a new leaf node and initializes the new node. 
+   * 
+   * */
+  PageId createLeafInt();
+
+  /**
+   * @brief Create a new non leaf node and initializes the new node. 
+   * 
+   * @param level the level at which the new non leaf node is at
+   * 
+   * */
+  PageId createNonLeafInt(int level);
+
+
+  /**
+ * @brief called when you found the leaf node where the data is stored. finds index where
+ * the key/rid needs to be inserted. makes appropiate insert based on, empty slot, 
+ * shift and insert, or split and insert.
+ * 
+ * @param key key to be inserted
+ * @param rid  rid to be inserted
+ * @param pageId  the page id of the node we are looking at
+ * @param page  the leaf if the caller already pinned it, else nullptr
+ * @return PageId 
+ */
+  void insertLeafInt(int &key, const RecordId rid, PageId &pageId, Page* page = nullptr);
+
+  /**
+   * @brief insertLeafInt() for LEAF_COMPRESSED leaves. Decodes the leaf, inserts the entry and
+   * re-encodes it, splitting it in two when the entries no longer fit in one page.
+   *
+   * @param key key to be inserted; set to the first key of the new right leaf on a split
+   * @param rid rid to be inserted
+   * @param pageId the leaf page; set to the new right leaf on a split, else Page::INVALID_NUMBER
+   * @param page the pinned leaf page, unpinned on return
+   */
+  void insertCompressedLeafInt(int &key, const RecordId rid, PageId &pageId, Page* page);
+
+  /**
+   * @brief insertLeafInt() for LEAF_POSTINGS leaves. Adds rid to the postings list of key,
+   * creating the list if needed and moving it to overflow pages once it is longer than
+   * POSTINGSINLINESIZE. Splits the leaf between two postings lists when it is full.
+   *
+   * @param key key to be inserted; set to the first key of the new right leaf on a split
+   * @param rid rid to be inserted
+   * @param pageId the leaf page; set to the new right leaf on a split, else Page::INVALID_NUMBER
+   * @param page the pinned leaf page, unpinned on return
+   */
+  void insertPostingsLeafInt(int &key, const RecordId rid, PageId &pageId, Page* page);
+
+  /**
+   * @brief Create a chain of overflow pages holding n sorted rids. Returns its first page.
+   */
+  PageId createOverflowChain(const RecordId* rids, int n);
+
+  /**
+   * @brief Insert rid into the sorted overflow chain starting at headPageNo. Appending
+   * after the last rid only touches the first and last page of the chain.
+   */
+  void insertOverflowRid(PageId headPageNo, const RecordId rid);
+
+  /**
+   * @brief Number of entries the left node keeps when total entries, one more than fit, are
+   * split. pos is the position of the new entry. Splits of the rightmost (leftmost) node at its
+   * end (start) keep fillFactor percent of capacity in the left (right) node, others split in half.
+   */
+  int splitPoint(int total, int capacity, int pos, bool rightmost, bool leftmost) const;
+
+  /**
+   * @brief bufMgr->readPage() for pages of the index file, counting pins and buffer misses. With
+   * optimisticReads on, also enters the page into the node table.
+   */
+  void readPage(PageId pageNo, Page*& page);
 
-  // PageId* insert(PageId curr, bool nonLeaf, const void *key, const RecordId rid);
+  /**
+   * @brief bufMgr->unPinPage() and bufMgr->allocPage() for pages of the index file, or nothing
+   * and NodeArena::allocate() for an in-memory index.
+   */
+  void unpinPage(PageId pageNo, bool dirty);
+  void allocPage(PageId& pageNo, Page*& page);
+
+  /**
+   * @brief Pages of the index file or arena, the meta page included.
+   */
+  PageId indexPages() const { return arena != nullptr ? arena->numPages() : numIndexPages; }
+
+  /**
+   * @brief bufMgr->flushFile() for the index file. Drops the pins of the node table first.
+   */
+  void flushIndexFile();
+
+  /**
+   * @brief Entry of pageNo in the node table, allocating its chunk if create is set. nullptr if
+   * the chunk does not exist or pageNo lies past OLCMAXCHUNKS chunks.
+   */
+  OptimisticNode* olcNode(PageId pageNo, bool create);
+
+  /**
+   * @brief Read page pageNo for a concurrent lookup that found it missing from the node table,
+   * which enters it there.
+   */
+  void olcFetch(PageId pageNo);
+
+  /**
+   * @brief Lock a node an insert is about to modify: concurrent lookups of the node restart or
+   * wait until unlockNode(). Waits for latched readers to leave the node. No-op unless optimisticReads is on.
+   */
+  void lockNode(PageId pageNo);
+
+  /**
+   * @brief Unlock a node locked by lockNode(), publishing a new version of it.
+   */
+  void unlockNode(PageId pageNo);
+
+  /**
+   * @brief Start an optimistic read of node pageNo: its frame and version, waiting while it is
+   * locked. Returns false if the page has to be fetched first; the lookup restarts then.
+   */
+  bool olcReadLock(PageId pageNo, Page*& page, std::uint64_t& version);
+
+  /**
+   * @brief True if node pageNo still has version, so that what was read of it since
+   * olcReadLock() is consistent.
+   */
+  bool olcValidate(PageId pageNo, std::uint64_t version);
+
+  /**
+   * @brief Take a reader latch on node pageNo for lookupLatched(). Returns false without waiting
+   * if the node is locked by an insert or has to be fetched first.
+   */
+  bool latchNode(PageId pageNo, Page*& page);
+
+  /**
+   * @brief Release a reader latch taken by latchNode().
+   */
+  void unlatchNode(PageId pageNo);
+
+  /**
+   * @brief Read the next leaf of a scan: pinned in the buffer pool for the first
+   * SCANRINGTHRESHOLD leaves, into the scan ring after that. Sets currentPageInRing.
+   */
+  void readScanLeaf(PageId pageNo, Page*& page);
+
+  /**
+   * @brief Release a leaf read by readScanLeaf(): unpin it unless it is in the scan ring.
+   */
+  void releaseScanLeaf(PageId pageNo);
+
+  /**
+   * @brief Start timing an operation if it is sampled. Returns the cycle counter, or 0 if the
+   * operation is not timed.
+   */
+  std::uint64_t timingStart();
+
+  /**
+   * @brief Add the cycles since start, as returned by timingStart(), to the histogram of op.
+   */
+  void timingEnd(TimedOperation op, std::uint64_t start);
+
+  /**
+   * @brief Insert into the hint leaf if key lies inside its fence and the leaf has room for the
+   * entry without splitting. Returns false, inserting nothing, otherwise.
+   */
+  bool insertIntoHintLeaf(int key, const RecordId rid);
+
+  /**
+   * @brief Insert the entry into the tree itself: into the hint leaf if it can, else by a descent
+   * from the root. insertEntryInt() minus the delta.
+   */
+  void insertIntoTree(const int key, const RecordId rid);
+
+  /**
+   * @brief Insert the entry into the delta or the tree: insertEntryInt() minus the side-log of
+   * an online build.
+   */
+  void insertIntoIndex(const int key, const RecordId rid);
+
+  /**
+   * @brief Insert the entries of a side-log that the scan of the online build has not inserted
+   * already.
+   */
+  void applySideLog(const std::vector<std::pair<int, RecordId>>& entries);
+
+  /**
+   * @brief Record in the meta page the format version, the tuple count, and whether the index is
+   * complete as of the current fingerprint of the relation file. Clearing the complete mark writes
+   * the meta page through to the index file at once.
+   */
+  void saveMetaState(bool complete);
+
+  /**
+   * @brief Throw PagePinnedException if a scan is executing and inserts go into the tree.
+   */
+  void checkScanIdle() const;
+
+  /**
+   * @brief The entries of the delta with keys in the range given by lowVal, lowOp, highVal and
+   * highOp: [begin, end).
+   */
+  void deltaRange(int lowVal, Operator lowOp, int highVal, Operator highOp,
+                  std::multimap<int, RecordId>::const_iterator& begin,
+                  std::multimap<int, RecordId>::const_iterator& end) const;
+
+  /**
+   * @brief Append the rids of key in the delta to rids.
+   */
+  void deltaLookup(int key, std::vector<RecordId>& rids) const;
+
+  /**
+   * @brief True if one more entry with the given key surely fits into the pinned leaf page.
+   */
+  bool leafHasRoom(const Page* page, int key) const;
+
+  /**
+   * @brief Add the pages and entries below non-leaf node pageNo to stats.
+   *
+   * @param pageNo the non-leaf node
+   * @param depth number of levels above pageNo, the root is at depth 1
+   * @param stats statistics being accumulated
+   */
+  void collectNodeStats(PageId pageNo, int depth, IndexStats& stats);
+
+  /**
+   * @brief Add the pinned leaf page pageNo to stats and statsLeaves.
+   */
+  void collectLeafStats(PageId pageNo, Page* page, IndexStats& stats);
+
+  /**
+   * @brief Key of the entry at position offset of the pinned leaf page, counting every rid.
+   */
+  int leafKeyAt(Page* page, std::int64_t offset);
+
+  /**
+   * @brief Estimated number of entries with keys less than or equal to key, from the stats summary.
+   */
+  double estimateRank(std::int64_t key) const;
+
+  /**
+   * @brief Point scanKeys/scanRids/scanCount/scanRightSibPageNo at the entries of a pinned
+   * leaf page, decoding it first if the index uses compressed leaves.
+   */
+  void loadScanLeaf(Page* page);
+
+  /**
+   * @brief Move the scan to the right sibling of its current leaf.
+   */
+  void scanNextLeaf();
+
+  /**
+   * @brief Key of the entry the scan returns next, moving it to the next leaf as needed. Returns
+   * false if no entry is left in the range.
+   */
+  bool scanPeekKey(int& key);
+
+  /**
+   * @brief Make scanRanges[i] the range of the scan and skip to its first entry.
+   */
+  void enterScanRange(std::size_t i);
+
+  /**
+   * @brief Entries of a leaf page: points keys/rids at the page for LEAF_PLAIN leaves, else
+   * decodes them into keyBuf/ridBuf, which must have room for a full leaf. Spilled postings lists
+   * are single entries as for scanKeys/scanRids. Returns the number of entries.
+   */
+  int decodeLeaf(Page* page, const int*& keys, const RecordId*& rids, PageId& rightSibPageNo,
+                 int* keyBuf, RecordId* ridBuf) const;
+
+  /**
+   * @brief Flush the index file if inserts changed it since it was last in sync, and open the
+   * asynchronous reader on first use.
+   */
+  void prepareAsync();
+
+  /**
+   * @brief Read pages pageNos[first, first + count), count at most ASYNCQUEUEDEPTH, into
+   * asyncPages[0, count) through the asynchronous reader.
+   */
+  void readPagesAsync(const std::vector<PageId>& pageNos, std::size_t first, std::size_t count);
+
+  /**
+   * @brief Append the rids of the overflow chain starting at headPageNo to outRids.
+   */
+  void readOverflowAsync(PageId headPageNo, std::vector<RecordId>& outRids);
+
+  /**
+   * @brief High key of the leaf page, in the leaf format of the index.
+   */
+  int leafHighKey(const Page* page) const;
+
+  /**
+   * @brief Append the rids of key in the leaf page to rids, decoding the leaf into keyBuf/ridBuf
+   * unless it is LEAF_PLAIN. Returns the page to read next: the first overflow page if key has a
+   * spilled postings list (setting spilled), the right sibling if key is not below the high key
+   * of the leaf, so that its run may go on there, else Page::INVALID_NUMBER. Only reads the page, so concurrent lookups can use it.
+   */
+  PageId leafLookup(int key, Page* page, std::vector<RecordId>& rids, int* keyBuf, RecordId* ridBuf,
+                    bool& spilled) const;
+
+  /**
+   * @brief One step of a lookup of lookupBatch(): append the rids of key found on page, which
+   * is of the kind stage says, and return the page to read next, Page::INVALID_NUMBER when the
+   * lookup is complete. Updates stage to the kind of that page.
+   */
+  PageId advanceLookup(int key, Page* page, LookupStage& stage, std::vector<RecordId>& rids);
+
+  /**
+   * @brief Lookup of probeInterleaved(): appends the rids of key to rids, suspending at every page
+   * once it has prefetched the page or, for PROBE_FILE, submitted its read into buffer.
+   */
+  ProbeTask probe(int key, std::vector<RecordId>& rids, ProbeSource source, Page* buffer);
+
+  /**
+   * @brief Prefetch into the CPU cache the lines of a node that advanceLookup() reads first.
+   */
+  void prefetchNode(const Page* page, LookupStage stage) const;
+
+  /**
+ * @brief This method traverses down the tree by following the correct search conditions. 
+ * One a leaf node is next to be read it goes into insertLeafInt to insert the key and rid 
+ * while checking if the node needs to be split. once you return back to the parent node with
+ * the new key check if node needs to split. do recursively
+ * 
+ * @param key key to be inserted
+ * @param rid  rid to be inserted
+ * @param pageId  the page id of the node we are looking at
+ * @return PageId 
+ */
+  void insertNonLeafInt(int &key, const RecordId rid, PageId &pageId);
+
+  /**
+   * @brief insertNonLeafInt() for NONLEAF_BUFFERED nodes while bufferInserts is on. Appends the
+   * entry to the buffer of the node. A full buffer first flushes the entries of the child that has
+   * the most of them into that child, in key order, which may split the child and this node.
+   *
+   * @param key key to be inserted; set to the separator passed up on a split
+   * @param rid rid to be inserted
+   * @param pageId the node; set to the new right node on a split, else Page::INVALID_NUMBER
+   */
+  void insertBufferedNonLeafInt(int &key, const RecordId rid, PageId &pageId);
+
+  /**
+   * @brief Split a full non-leaf node, inserting key and newPageId as separator i and child i + 1
+   * on the way, and move the buffered entries of the new right node there. The caller unpins node.
+   *
+   * @param key the separator to insert; set to the separator passed up
+   * @param newPageId the child to insert; set to the new right node
+   */
+  void splitNonLeafInt(NonLeafNodeInt* node, int i, int &key, PageId &newPageId, bool rightmost, bool leftmost);
+
+  /**
+   * @brief Insert the buffered entries with keys in [low, high] straight into the leaves, so that
+   * scans of that range read them there. Does nothing unless the index is NONLEAF_BUFFERED.
+   */
+  void applyBuffers(int low, int high);
+
+  /**
+   * @brief Take the buffered entries with keys in [low, high] out of non-leaf node pageNo and the
+   * nodes below it, appending them to messages.
+   */
+  void takeBufferedRange(PageId pageNo, int low, int high, std::vector<BufferMessageInt>& messages);
+
+  /**
+   * @brief Append the rids of key buffered in a NONLEAF_BUFFERED node to rids.
+   */
+  void bufferLookup(const NonLeafNodeInt* node, int key, std::vector<RecordId>& rids) const;
+
+  // PageId* insert(PageId curr, bool nonLeaf, const void *key, const RecordId rid);
   /**
 	 * Insert a new entry using the pair <value,rid>. 
 	 * Start from root to recursively find out the leaf to insert the entry in. The insertion may cause splitting of leaf node.
@@ -380,9 +1896,49 @@ class BTreeIndex {
 	 * Make sure to unpin pages as soon as you can.
    * @param key			Key to insert, pointer to integer/double/char string
    * @param rid			Record ID of a record whose entry is getting inserted into the index.
+   * @throws PagePinnedException If a scan is executing and the entry would go into the tree rather
+   * than the delta or the side-log of an online build: the scan would miss or repeat entries the
+   * insert moves
 	**/
 	void insertEntryInt(const int key, const RecordId rid);
 
+  /**
+   * Scan up to maxPages further heap pages of the relation for an online build, see
+   * IndexOptions::onlineBuild, and insert their records. Sleeps as needed to keep to
+   * IndexOptions::buildPagesPerSecond. Scans and lookups meanwhile see the index as built so far.
+   * @param maxPages	Number of heap pages to scan
+   * @return False once the whole relation has been scanned
+   * @throws PagePinnedException If a scan is executing and the index has no delta, as for insertEntryInt()
+	**/
+	bool buildStep(int maxPages);
+
+  /**
+	 * Complete an online build: scan the rest of the relation, then apply the side-log of the
+	 * inserts made during the build. Rounds of catch-up take what the side-log holds and apply it
+	 * while writers go on appending; once at most BUILDCATCHUPENTRIES are left, writers wait for
+	 * those to be applied and then insert into the index directly. Records the scan found and the
+	 * side-log holds too are inserted once. Does nothing if no online build is running.
+   * @throws PagePinnedException If a scan is executing and the index has no delta, as for insertEntryInt()
+	**/
+	void finishBuild();
+
+  /**
+	 * True while an online build has not completed.
+	**/
+	bool building() const { return onlineBuilding.load(std::memory_order_acquire); }
+
+  /**
+	 * Number of records the index holds entries for, kept in the meta page so that an opened index
+	 * knows it without a scan.
+	**/
+	std::int64_t tupleCount() const { return numTuples; }
+
+  /**
+   * @brief Merge the delta into the tree, see IndexOptions::deltaEntries. Called when the delta
+   * is full and before the tree is read past the buffer pool or written out.
+   */
+  void mergeDelta();
+
 
   /**
 	 * Begin a filtered scan of the index.  For instance, if the method is called 
@@ -401,6 +1957,28 @@ class BTreeIndex {
 	**/
 	void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
 
+  /**
+	 * Begin a scan of several key ranges in one cursor: scanNext(), scanNextBatch() and
+	 * scanNextEntry() return the entries of the first range, then those of the next one and so on.
+	 * Between ranges the scan moves on along the leaf chain when the next range starts in the
+	 * current or the next leaf, and descends from the root only when it is further away, as
+	 * scanSkipTo().
+   * @param ranges	Ranges sorted by key that do not overlap
+   * @throws  BadOpcodesException If the operators of a range do not contain one of their expected values
+   * @throws  BadScanrangeException If ranges is empty, a range has lowVal > highVal, or a range
+   * starts before the end of the previous one
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree in any of the ranges.
+	**/
+	void startMultiScan(const std::vector<ScanRange>& ranges);
+
+  /**
+	 * Begin a scan of the entries of a list of keys, as a startMultiScan() of one range per key.
+   * @param keys	Keys to scan, in any order and with repeats
+   * @throws  BadScanrangeException If keys is empty
+	 * @throws  NoSuchKeyFoundException If none of the keys is in the B+ tree.
+	**/
+	void startInListScan(std::vector<int> keys);
+
 
   /**
 	 * Fetch the record id of the next index entry that matches the scan.
@@ -411,13 +1989,205 @@ class BTreeIndex {
 	**/
 	void scanNext(RecordId& outRid);  // returned record id
 
+  /**
+	 * Fetch the record ids of up to maxRids next index entries that match the scan. Runs of entries,
+	 * such as the rids of a duplicate key, are copied in bulk rather than one scanNext() call each.
+   * @param outRids	Array of at least maxRids RecordIds the matching record ids are written to
+   * @param maxRids	Maximum number of record ids to return
+   * @return Number of record ids written, at least one
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	int scanNextBatch(RecordId* outRids, int maxRids);
+
+  /**
+	 * Fetch the next index entry that matches the scan together with its key.
+   * @param outKey	Key of the entry
+   * @param outRid	RecordId of the entry
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	void scanNextEntry(int& outKey, RecordId& outRid);
+
+  /**
+	 * Move the scan forward to its first remaining entry with a key of at least key, skipping the
+	 * entries before it. The skip gallops through the current leaf or, when key is past it, the
+	 * next leaf, and past that descends from the root to the leaf of key instead of walking the
+	 * leaves in between.
+	 * Does nothing if the next entry of the scan already has a key of at least key.
+   * @param key	Key to skip to
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	void scanSkipTo(int key);
+
+  /**
+   * @brief True if key lies inside the range of the current scan.
+   */
+  bool keyInScanRange(int key) const;
+
 
   /**
 	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
 	 * @throws ScanNotInitializedException If no scan has been initialized.
 	**/
 	void endScan();
+
+  /**
+   * @brief Look up many keys at once. The lookups descend the tree together, a level at a time,
+   * and every round reads the distinct pages they need next with up to ASYNCQUEUEDEPTH reads in
+   * flight, so that on a cold cache the reads of different keys overlap instead of queueing one
+   * behind the other. Pages are read from the index file past the buffer pool.
+   *
+   * @param keys		Keys to look up
+   * @param results	Set to one vector per key holding the record ids of its entries, empty for a missing key
+   * @throws PagePinnedException If a scan is executing while the index has unflushed inserts
+   */
+  void lookupBatch(const std::vector<int>& keys, std::vector<std::vector<RecordId>>& results);
+
+  /**
+   * @brief Range scan reading the index asynchronously: the nodes that overlap the range are
+   * read a level at a time and the leaves in windows of ASYNCQUEUEDEPTH, each window with all its
+   * reads in flight at once. Returns the same record ids, in the same order, as
+   * startScan()/scanNext() with these arguments, but does not disturb a scan that is executing.
+   *
+   * @param lowVal	Low value of range, pointer to integer
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer
+   * @param highOp	High operator (LT/LTE)
+   * @param outRids	The matching record ids are appended here
+   * @return Number of record ids appended, 0 if no key satisfies the scan criteria
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+   * @throws PagePinnedException If a scan is executing while the index has unflushed inserts
+   */
+  std::size_t scanAsync(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp,
+                        std::vector<RecordId>& outRids);
+
+  /**
+   * @brief Look up many keys, interleaving groupSize lookups at a time on this thread. Each lookup
+   * is a coroutine that prefetches (PROBE_BUFFER_POOL) or starts reading (PROBE_FILE) the node it
+   * needs next and then suspends, and the lookups of the group are resumed round-robin, so that
+   * the misses of groupSize lookups overlap. Needs C++20; built as C++17 the lookups run one
+   * after another.
+   *
+   * @param keys		Keys to look up
+   * @param results	Set to one vector per key holding the record ids of its entries, empty for a missing key
+   * @param source		Where to read pages from
+   * @param groupSize	Lookups in progress at once, at most ASYNCQUEUEDEPTH and, for PROBE_BUFFER_POOL,
+   * at most what half of IndexOptions::poolFrames can hold pinned
+   * @throws PagePinnedException If source is PROBE_FILE and a scan is executing while the index
+   * has unflushed inserts
+   */
+  void probeInterleaved(const std::vector<int>& keys, std::vector<std::vector<RecordId>>& results,
+                        ProbeSource source = PROBE_BUFFER_POOL, int groupSize = PROBEGROUPSIZE);
+
+  /**
+   * @brief Look up key without writing to any memory shared with other threads: the lookup reads
+   * the version of each node before and after reading the node and starts over from the root if
+   * an insert changed the node in between. With IndexOptions::optimisticReads on, any number of
+   * threads may call this concurrently with each other and with insertEntryInt().
+   *
+   * @param key	Key to look up
+   * @param rids	The record ids of its entries are appended here
+   */
+  void lookupOptimistic(int key, std::vector<RecordId>& rids);
+
+  /**
+   * @brief lookupOptimistic() with latch coupling instead: the lookup holds a reader latch on each
+   * node it reads and on the next before releasing the previous one. Same concurrency as
+   * lookupOptimistic(), meant as its baseline.
+   *
+   * @param key	Key to look up
+   * @param rids	The record ids of its entries are appended here
+   */
+  void lookupLatched(int key, std::vector<RecordId>& rids);
+
+  /**
+   * @brief True if lookupBatch() and scanAsync() have read through io_uring, false if through the
+   * thread pool it falls back to or if they have not been called yet.
+   */
+  bool asyncUsesIoUring() const { return asyncReader != nullptr && asyncReader->usesIoUring(); }
 	
+  /**
+   * @brief Walk the whole tree and return its shape, space utilization and key distribution.
+   * Also stores the summary in the meta page for estimateScanCount(). checkpoint() calls this.
+   */
+  IndexStats collectStats();
+
+  /**
+   * @brief Store fresh statistics in the meta page, see collectStats(), and write every page of the
+   * index to its file. The constructor calls this once the index is built.
+   *
+   * @throws PagePinnedException If a scan is executing
+   */
+  void checkpoint();
+
+  /**
+   * @brief Rewrite the index into a new file with its leaves in key order, filled to fillPercent
+   * of their capacity, then put the new file in place of the old one and checkpoint() it. Leaves
+   * scattered through the file by splits become one ascending run of pages, so that a range scan
+   * reads the file front to back; the internal levels are rebuilt over them.
+   *
+   * The entries are read in key order and inserted in that order into an empty tree in a file
+   * beside the index file: every split is at the right end of the tree, keeping fillPercent
+   * percent of the node, and each new leaf is the next page of the file. The new file names its
+   * root in its meta page and is renamed over the index file, so the index file always holds
+   * either the old tree or the new one. An in-memory index is rewritten in place instead, its
+   * nodes handed out again in page order from the free list of its arena. Ends any scan and
+   * completes any online build first; must not run concurrently with lookups.
+   *
+   * @param fillPercent	Fill of the rewritten nodes, 50 to 100
+   */
+  void compact(int fillPercent = 100);
+
+  /**
+   * @brief checkpoint() and, for an in-memory index, write its pages to the index file, which an
+   * index in the buffer pool or in memory can then open without a rebuild. The pages are written
+   * to a file beside the index file that is renamed over it, so that the index file always holds
+   * a whole snapshot.
+   *
+   * @throws PagePinnedException If a scan is executing on an index in the buffer pool
+   */
+  void saveSnapshot();
+
+  /**
+   * @brief True if the nodes are in memory, see IndexOptions::inMemory.
+   */
+  bool inMemory() const { return arena != nullptr; }
+
+  /**
+   * @brief Estimated number of entries a scan with these arguments returns, computed from the key
+   * histogram in the meta page without reading the tree.
+   *
+   * @param lowVal Low value of range, pointer to integer / double / char string
+   * @param lowOp Low operator (GT/GTE)
+   * @param highVal High value of range, pointer to integer / double / char string
+   * @param highOp High operator (LT/LTE)
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   */
+  double estimateScanCount(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp) const;
+
+  /**
+   * @brief Summary of the statistics as of the last collectStats(), as stored in the meta page.
+   */
+  const IndexStatsSummary& statsSummary() const { return storedStats; }
+
+  /**
+   * @brief Snapshot of the performance counters since the index was opened or resetCounters().
+   */
+  IndexCounters getCounters() const { return counters; }
+
+  /**
+   * @brief Set all performance counters to 0.
+   */
+  void resetCounters();
+
+  /**
+   * @brief Time one in everyN inserts, scan starts and scanNext()/scanNextBatch() calls into the
+   * cycle histograms of the counters. 0, the default, times nothing.
+   */
+  void setTimingSampleRate(int everyN);
+
   void traverse(Page* page, int pageLevel, const void* keyPtr, PageId &leafID);
 };
 
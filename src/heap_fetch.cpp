@@ -0,0 +1,185 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "heap_fetch.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/scan_not_initialized_exception.h"
+
+namespace badgerdb
+{
+
+/**
+ * Ask the operating system to read ahead the sorted heap pages [begin, end). Pages lie one after
+ * the other in the file past a small header, so each run of consecutive pages is advised as one
+ * byte range, widened by a page to cover the header.
+ */
+static void adviseHeapPages(int fd, const PageId* begin, const PageId* end)
+{
+	if (fd < 0)
+		return;
+	while (begin != end) {
+		const PageId* run = begin + 1;
+		while (run != end && *run == run[-1] + 1)
+			run++;
+		off_t offset = (off_t) (*begin - 1) * Page::SIZE;
+		off_t length = (off_t) (run[-1] - *begin + 2) * Page::SIZE;
+		posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED);
+		begin = run;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// HeapFetcher::HeapFetcher -- Constructor
+// -----------------------------------------------------------------------------
+
+HeapFetcher::HeapFetcher(BTreeIndex& indexIn, File* relationIn, BufMgr* bufMgrIn, bool keyOrderIn, int batchSizeIn)
+	: index(&indexIn), relation(relationIn), bufMgr(bufMgrIn), keyOrder(keyOrderIn), batchSize(std::max(1, batchSizeIn)),
+	  scanExecuting(false), scanDrained(false), batchPos(0), numPagesRead(0)
+{
+	adviceFd = open(relation->filename().c_str(), O_RDONLY);
+}
+
+// -----------------------------------------------------------------------------
+// HeapFetcher::~HeapFetcher -- destructor
+// -----------------------------------------------------------------------------
+
+HeapFetcher::~HeapFetcher()
+{
+	if (scanExecuting && !scanDrained) {
+		try {
+			index->endScan();
+		} catch (...) {
+		}
+	}
+	if (adviceFd >= 0)
+		close(adviceFd);
+}
+
+// -----------------------------------------------------------------------------
+// HeapFetcher::startScan
+// -----------------------------------------------------------------------------
+
+void HeapFetcher::startScan(const ScanRange& range)
+{
+	if (scanExecuting && !scanDrained)
+		index->endScan();
+	scanExecuting = false;
+	batchRids.clear();
+	batchRecords.clear();
+	batchPos = 0;
+	index->startScan(&range.lowVal, range.lowOp, &range.highVal, range.highOp);
+	scanExecuting = true;
+	scanDrained = false;
+}
+
+// -----------------------------------------------------------------------------
+// HeapFetcher::next
+// -----------------------------------------------------------------------------
+
+bool HeapFetcher::next(RecordId& outRid, std::string& outRecord)
+{
+	if (!scanExecuting)
+		throw ScanNotInitializedException();
+	if (batchPos == batchRids.size() && !fillBatch())
+		return false;
+	outRid = batchRids[batchPos];
+	outRecord.swap(batchRecords[batchPos]);
+	batchPos++;
+	return true;
+}
+
+bool HeapFetcher::fillBatch()
+{
+	std::vector<RecordId> rids(batchSize);
+	int n = 0;
+	try {
+		while (!scanDrained && n < batchSize)
+			n += index->scanNextBatch(rids.data() + n, batchSize - n);
+	} catch (const IndexScanCompletedException &) {
+		index->endScan();
+		scanDrained = true;
+	}
+	rids.resize(n);
+	batchPos = 0;
+	batchRids.clear();
+	batchRecords.clear();
+	if (n == 0)
+		return false;
+
+	// positions of the rids in heap order
+	std::vector<std::uint32_t> order(n);
+	for (int i = 0; i < n; i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&rids](std::uint32_t a, std::uint32_t b) {
+		return ridLess(rids[a], rids[b]) || (rids[a] == rids[b] && a < b);
+	});
+	std::vector<PageId> pages;
+	for (std::uint32_t i : order)
+		if (pages.empty() || pages.back() != rids[i].page_number)
+			pages.push_back(rids[i].page_number);
+	adviseHeapPages(adviceFd, pages.data(), pages.data() + pages.size());
+
+	batchRids.resize(n);
+	batchRecords.resize(n);
+	for (int k = 0; k < n; ) {
+		PageId pageNo = rids[order[k]].page_number;
+		Page* page;
+		bufMgr->readPage(relation, pageNo, page);
+		numPagesRead++;
+		try {
+			for (; k < n && rids[order[k]].page_number == pageNo; k++) {
+				// key order puts each record back at the position of its rid in the scan
+				int slot = keyOrder ? order[k] : k;
+				batchRids[slot] = rids[order[k]];
+				batchRecords[slot] = page->getRecord(rids[order[k]]);
+			}
+		} catch (...) {
+			// the rest of the batch is dropped, the scan goes on with the next one
+			bufMgr->unPinPage(relation, pageNo, false);
+			batchRids.clear();
+			batchRecords.clear();
+			throw;
+		}
+		bufMgr->unPinPage(relation, pageNo, false);
+	}
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// fetchRecords
+// -----------------------------------------------------------------------------
+
+void fetchRecords(const RidBitmap& bitmap, File* relation, BufMgr* bufMgr, std::vector<std::string>& outRecords)
+{
+	outRecords.clear();
+	outRecords.reserve(bitmap.cardinality());
+	std::vector<SlotId> slots;
+	for (std::size_t i = 0; i < bitmap.numPages(); i++) {
+		RecordId rid;
+		rid.page_number = bitmap.page(i);
+		bitmap.pageSlots(i, slots);
+		Page* page;
+		bufMgr->readPage(relation, rid.page_number, page);
+		try {
+			for (SlotId slot : slots) {
+				rid.slot_number = slot;
+				outRecords.push_back(page->getRecord(rid));
+			}
+		} catch (...) {
+			bufMgr->unPinPage(relation, rid.page_number, false);
+			throw;
+		}
+		bufMgr->unPinPage(relation, rid.page_number, false);
+	}
+}
+
+}
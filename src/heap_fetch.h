@@ -0,0 +1,120 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+#include "rid_bitmap.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Default number of rids a HeapFetcher takes from the index scan per batch.
+ */
+const int HEAPFETCHBATCH = 65536;
+
+/**
+ * @brief Fetches the records an index scan matches from the relation. The rids of the scan are
+ * taken a batch at a time and grouped by heap page, the pages of the batch are announced to the
+ * operating system for read-ahead, and each page is then read through the buffer manager once
+ * for all records the batch has on it, in page order.
+ *
+ * Records come out in heap order within each batch, or in the key order of the scan if asked
+ * for. Like BTreeIndex the fetcher runs one scan at a time, and it holds the scan of its index.
+ */
+class HeapFetcher {
+ public:
+  /**
+   * @brief Fetcher of records of relation, read through bufMgr, for scans of index.
+   *
+   * @param index		Index over relation
+   * @param relation	File of the relation
+   * @param bufMgr		Buffer manager to read the pages of relation through
+   * @param keyOrder	Return records in the key order of the scan rather than in heap order
+   * @param batchSize	Number of rids grouped by page at a time
+   */
+  HeapFetcher(BTreeIndex& index, File* relation, BufMgr* bufMgr, bool keyOrder = false, int batchSize = HEAPFETCHBATCH);
+
+  /**
+   * @brief Ends any scan. Destructor should not throw any exceptions.
+   */
+  ~HeapFetcher();
+
+  /**
+   * @brief Begin fetching the records of the entries of the index in range.
+   *
+   * @throws  BadOpcodesException If the operators of range do not contain one of their expected values
+   * @throws  BadScanrangeException If range.lowVal > range.highVal
+   * @throws  NoSuchKeyFoundException If there is no key in the index in range.
+   */
+  void startScan(const ScanRange& range);
+
+  /**
+   * @brief Fetch the next record.
+   *
+   * @param outRid		Set to the record id of the record
+   * @param outRecord	Set to the bytes of the record
+   * @return False, with the outputs unchanged, once all records have been returned
+   * @throws ScanNotInitializedException If no scan has been started.
+   * @throws InvalidRecordException If a rid of the batch names no record of the relation. The
+   * records of that batch not yet returned are dropped, and the next call goes on with the next batch.
+   */
+  bool next(RecordId& outRid, std::string& outRecord);
+
+  /**
+   * @brief Heap pages read, once per batch that has a record on them, since the fetcher was created.
+   */
+  std::uint64_t pagesRead() const { return numPagesRead; }
+
+ private:
+  /**
+   * Take the next batch of rids from the scan and read their records. Returns false if the scan
+   * has no rids left.
+   */
+  bool fillBatch();
+
+  BTreeIndex* index;
+  File* relation;
+  BufMgr* bufMgr;
+  bool keyOrder;
+  int batchSize;
+
+  /**
+   * Read-only descriptor of the relation file for read-ahead advice, -1 if it could not be opened.
+   */
+  int adviceFd;
+
+  /**
+   * True while a scan runs, and once the index scan has returned its last rid.
+   */
+  bool scanExecuting;
+  bool scanDrained;
+
+  /**
+   * Rids and records of the current batch in output order, and the next one to return.
+   */
+  std::vector<RecordId> batchRids;
+  std::vector<std::string> batchRecords;
+  std::size_t batchPos;
+
+  std::uint64_t numPagesRead;
+};
+
+/**
+ * @brief Records of the rids of bitmap, read through bufMgr in heap order with each page read
+ * once.
+ *
+ * @throws InvalidRecordException If a rid of bitmap names no record of the relation
+ */
+void fetchRecords(const RidBitmap& bitmap, File* relation, BufMgr* bufMgr, std::vector<std::string>& outRecords);
+
+}
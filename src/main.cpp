@@ -5,8 +5,19 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
 #include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "btree.h"
+#include "partitioned_index.h"
+#include "merge_join.h"
+#include "rid_bitmap.h"
+#include "heap_fetch.h"
 #include "page.h"
 #include "filescan.h"
 #include "page_iterator.h"
@@ -19,6 +30,11 @@
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/invalid_record_exception.h"
+#include "exceptions/page_pinned_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
 
 #define checkPassFail(a, b) 																				\
 {																																		\
@@ -66,9 +82,9 @@ BufMgr * bufMgr = new BufMgr(100);
 void createRelationForward();
 void createRelationBackward();
 void createRelationRandom();
-void intTests();
+void intTests(const IndexOptions &options = IndexOptions());
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
-void indexTests();
+void indexTests(const IndexOptions &options = IndexOptions());
 void test1();
 void test2();
 void test3();
@@ -76,6 +92,33 @@ void test4();
 void test5();
 void test6();
 void test6Helper();
+void test7();
+void test8();
+void test9();
+void test9Helper();
+void test10();
+void test11();
+void test12();
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
+void test25();
+void test26();
+void test27();
+void test28();
+void test29();
+int partitionedScan(PartitionedIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+std::vector<RecordId> collectScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int intScanBatch(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
 void test5Helper();
 void errorTests();
 void deleteRelation();
@@ -145,6 +188,29 @@ int main(int argc, char **argv)
   test4();
   test5();
   test6();
+  test7();
+  test8();
+  test9();
+  test10();
+  test11();
+  test12();
+  test13();
+  test14();
+  test15();
+  test16();
+  test17();
+  test18();
+  test19();
+  test20();
+  test21();
+  test22();
+  test23();
+  test24();
+  test25();
+  test26();
+  test27();
+  test28();
+  test29();
 	errorTests();
 
 	delete bufMgr;
@@ -191,15 +257,18 @@ void test4()
 	std::cout << "---------------------" << std::endl;
 	std::cout << "Custome Test 1" << std::endl;
 	createRelationForward();
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
-  try{
-    checkPassFail(intScan(&index,-500,GTE,-200,LTE), 0);
-    checkPassFail(intScan(&index,-500,GTE,2000,LTE), 2001);
-  }catch(std::exception &e){
-    std::cout << "test failed" << std::endl;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    try{
+      checkPassFail(intScan(&index,-500,GTE,-200,LTE), 0);
+      checkPassFail(intScan(&index,-500,GTE,2000,LTE), 2001);
+    }catch(std::exception &e){
+      std::cout << "test failed" << std::endl;
+    }
   }
   std::cout << "test passed" << std::endl;
   deleteRelation();
+  File::remove(intIndexName);
 }
 
 void test5()
@@ -215,6 +284,7 @@ void test5()
   }
   std::cout << "test passed" << std::endl;
   deleteRelation();
+  File::remove(intIndexName);
 }
 
 void test6()
@@ -230,6 +300,1454 @@ void test6()
   std::cout << "test passed" << std::endl;
   deleteRelation();
 }
+void test7()
+{
+  // testing the non-leaf key summary format on a tree with a wide root
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 4: non-leaf key summary format" << std::endl;
+  test5Helper();
+  {
+    IndexOptions options;
+    options.nonLeafFormat = NONLEAF_SUMMARY;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+    checkPassFail(intScan(&index,25,GT,40,LT), 14);
+    checkPassFail(intScan(&index,150000,GTE,150999,LTE), 1000);
+    checkPassFail(intScan(&index,199990,GT,300000,LT), 9);
+  }
+  std::cout << "test passed" << std::endl;
+  deleteRelation();
+  File::remove(intIndexName);
+}
+
+void test8()
+{
+  // testing compressed leaves with forward, backward and random insertion orders
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 5: compressed leaf format" << std::endl;
+  IndexOptions options;
+  options.leafFormat = LEAF_COMPRESSED;
+	createRelationForward();
+	indexTests(options);
+	deleteRelation();
+	createRelationBackward();
+	indexTests(options);
+	deleteRelation();
+	createRelationRandom();
+	indexTests(options);
+	deleteRelation();
+
+  test5Helper();
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+    checkPassFail(intScan(&index,-500,GTE,-200,LTE), 0);
+    checkPassFail(intScan(&index,150000,GTE,150999,LTE), 1000);
+    checkPassFail(intScan(&index,100000,GT,200000,LT), 99999);
+  }
+  std::cout << "test passed" << std::endl;
+  deleteRelation();
+  File::remove(intIndexName);
+}
+
+void test9()
+{
+  // testing heavy duplicates (7 distinct keys) in every leaf format
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 6: duplicate keys" << std::endl;
+  test9Helper();
+  LeafFormat formats[] = { LEAF_PLAIN, LEAF_COMPRESSED, LEAF_POSTINGS };
+  for (LeafFormat format : formats)
+  {
+    IndexOptions options;
+    options.leafFormat = format;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+    checkPassFail(intScan(&index,0,GTE,0,LTE), 2858);
+    checkPassFail(intScan(&index,2,GTE,4,LTE), 8571);
+    checkPassFail(intScan(&index,0,GT,7,LT), 17142);
+    checkPassFail(intScan(&index,6,GT,100,LT), 0);
+    checkPassFail(intScanBatch(&index,2,GTE,4,LTE), 8571);
+    checkPassFail(intScanBatch(&index,-5,GT,100,LT), 20000);
+    File::remove(intIndexName);
+  }
+  std::cout << "test passed" << std::endl;
+  deleteRelation();
+}
+
+void test10()
+{
+  // testing leaf utilization of monotonic ingest under the default and the classic split policy
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 7: append split policy" << std::endl;
+  test5Helper();
+  LeafFormat formats[] = { LEAF_PLAIN, LEAF_COMPRESSED, LEAF_POSTINGS };
+  for (LeafFormat format : formats)
+  {
+    IndexOptions options;
+    options.leafFormat = format;
+    {
+      BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+      IndexStats stats = index.collectStats();
+      checkPassFail(stats.numEntries, 200000);
+      checkPassFail((stats.avgLeafFill > 0.9), true);
+      checkPassFail(intScan(&index,150000,GTE,150999,LTE), 1000);
+    }
+    File::remove(intIndexName);
+
+    options.fillFactor = 50;
+    {
+      BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+      IndexStats stats = index.collectStats();
+      checkPassFail(stats.numEntries, 200000);
+      checkPassFail((stats.avgLeafFill < 0.6), true);
+      checkPassFail(intScan(&index,150000,GTE,150999,LTE), 1000);
+    }
+    File::remove(intIndexName);
+  }
+  std::cout << "test passed" << std::endl;
+  deleteRelation();
+}
+void test11()
+{
+  // testing that the insert hint leaves the same tree as full descents
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 8: insert hint" << std::endl;
+  LeafFormat formats[] = { LEAF_PLAIN, LEAF_COMPRESSED, LEAF_POSTINGS };
+  for (LeafFormat format : formats)
+  {
+    createRelationBackward();
+    int leafPages[2];
+    for (int hint = 0; hint < 2; hint++)
+    {
+      IndexOptions options;
+      options.leafFormat = format;
+      options.insertHint = hint;
+      {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+        leafPages[hint] = index.collectStats().numLeafPages;
+        checkPassFail(intScan(&index,25,GT,40,LT), 14);
+        checkPassFail(intScan(&index,0,GTE,4999,LTE), 5000);
+      }
+      File::remove(intIndexName);
+    }
+    checkPassFail(leafPages[1], leafPages[0]);
+    deleteRelation();
+  }
+  std::cout << "test passed" << std::endl;
+}
+void test12()
+{
+  // testing index statistics and the cardinality estimates from the stored summary
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 9: index statistics" << std::endl;
+  int low = 25, high = 40;
+  createRelationForward();
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    IndexStats stats = index.collectStats();
+    checkPassFail(stats.numEntries, 5000);
+    checkPassFail(stats.numDistinctKeys, 5000);
+    checkPassFail(stats.minKey, 0);
+    checkPassFail(stats.maxKey, 4999);
+    checkPassFail((int) stats.pagesPerLevel.size(), stats.height);
+    checkPassFail(stats.pagesPerLevel.back(), stats.numLeafPages);
+    checkPassFail((int) stats.histogram.size(), STATSHISTOGRAMSIZE);
+    checkPassFail(stats.histogram.back(), 4999);
+    checkPassFail(index.statsSummary().numEntries, 5000);
+    checkPassFail((std::abs(index.estimateScanCount(&low,GT,&high,LT) - 14) < 2), true);
+    checkPassFail((std::abs(index.estimateScanCount(&low,GTE,&high,LTE) - 16) < 2), true);
+  }
+  File::remove(intIndexName);
+  deleteRelation();
+
+  test9Helper();
+  LeafFormat formats[] = { LEAF_PLAIN, LEAF_COMPRESSED, LEAF_POSTINGS };
+  for (LeafFormat format : formats)
+  {
+    IndexOptions options;
+    options.leafFormat = format;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+    IndexStats stats = index.collectStats();
+    checkPassFail(stats.numEntries, 20000);
+    checkPassFail(stats.numDistinctKeys, 7);
+    int key = 3;
+    checkPassFail((std::abs(index.estimateScanCount(&key,GTE,&key,LTE) - 2857) < 400), true);
+    File::remove(intIndexName);
+  }
+  std::cout << "test passed" << std::endl;
+  deleteRelation();
+}
+void test13()
+{
+  // testing the performance counters against the shape of the tree and a scan
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 10: performance counters" << std::endl;
+  test5Helper();
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    IndexStats stats = index.collectStats();
+    IndexCounters counters = index.getCounters();
+    checkPassFail(counters.descents + counters.hintHits, 200000);
+    checkPassFail((int) counters.leafSplits, stats.numLeafPages - 1);
+    checkPassFail((int) counters.nonLeafSplits, stats.numNonLeafPages - 1 - (stats.height - 2));
+    checkPassFail((counters.pins >= counters.nodesVisited), true);
+
+    index.resetCounters();
+    index.setTimingSampleRate(1);
+    checkPassFail(intScan(&index,100000,GT,200000,LT), 99999);
+    counters = index.getCounters();
+    checkPassFail(counters.descents, 1);
+    checkPassFail(counters.scanEntries, 99999);
+    checkPassFail(counters.scanRingReads, counters.siblingHops + 1 - SCANRINGTHRESHOLD);
+    checkPassFail(counters.timedOps[STARTSCAN_OP], 1);
+    checkPassFail(counters.timedOps[SCANNEXT_OP], 99999);
+    std::uint64_t timed = 0;
+    for (int b = 0; b < CYCLEBUCKETS; b++) timed += counters.cycles[SCANNEXT_OP][b];
+    checkPassFail(timed, 99999);
+  }
+  std::cout << "test passed" << std::endl;
+  deleteRelation();
+  File::remove(intIndexName);
+}
+void test14()
+{
+  // testing the asynchronous lookups and scan against startScan()/scanNext()
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 11: asynchronous lookups and scans" << std::endl;
+  test9Helper();
+  LeafFormat formats[] = { LEAF_PLAIN, LEAF_COMPRESSED, LEAF_POSTINGS };
+  for (LeafFormat format : formats)
+  {
+    IndexOptions options;
+    options.leafFormat = format;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+    std::vector<RecordId> rids;
+    int low = 2, high = 5;
+    checkPassFail((int) index.scanAsync(&low, GTE, &high, LT, rids), intScanBatch(&index, 2, GTE, 5, LT));
+    checkPassFail((rids == collectScan(&index, 2, GTE, 5, LT)), true);
+    rids.clear();
+    checkPassFail((int) index.scanAsync(&low, GT, &high, LTE, rids), intScanBatch(&index, 2, GT, 5, LTE));
+    checkPassFail((rids == collectScan(&index, 2, GT, 5, LTE)), true);
+
+    std::vector<int> keys = { 3, 9, 0, 3, 6, -1 };
+    std::vector<std::vector<RecordId>> results;
+    index.lookupBatch(keys, results);
+    checkPassFail((int) results.size(), 6);
+    for (std::size_t k = 0; k < keys.size(); k++)
+      checkPassFail((results[k] == collectScan(&index, keys[k], GTE, keys[k], LTE)), true);
+    checkPassFail((int) results[1].size(), 0);
+    File::remove(intIndexName);
+  }
+  deleteRelation();
+
+  createRelationRandom();
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    std::vector<RecordId> rids;
+    int low = 25, high = 3000;
+    checkPassFail((int) index.scanAsync(&low, GT, &high, LT, rids), 2974);
+    checkPassFail((rids == collectScan(&index, 25, GT, 3000, LT)), true);
+
+    std::vector<int> keys;
+    for (int key = 6000; key >= -1000; key -= 7) keys.push_back(key);
+    std::vector<std::vector<RecordId>> results;
+    index.lookupBatch(keys, results);
+    int found = 0;
+    for (std::size_t k = 0; k < keys.size(); k++)
+      found += results[k].size() == 1 && results[k][0] == collectScan(&index, keys[k], GTE, keys[k], LTE)[0];
+    checkPassFail(found, 715);
+    checkPassFail((index.getCounters().asyncReads > 0), true);
+  }
+  std::cout << "test passed" << std::endl;
+  File::remove(intIndexName);
+  deleteRelation();
+}
+void test15()
+{
+  // testing the interleaved lookups against startScan()/scanNext()
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 12: interleaved lookups" << std::endl;
+  test9Helper();
+  LeafFormat formats[] = { LEAF_PLAIN, LEAF_COMPRESSED, LEAF_POSTINGS };
+  for (LeafFormat format : formats)
+  {
+    IndexOptions options;
+    options.leafFormat = format;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+    std::vector<int> keys = { 3, 9, 0, 3, 6, -1, 5 };
+    std::vector<std::vector<RecordId>> results;
+    for (ProbeSource source : { PROBE_BUFFER_POOL, PROBE_FILE })
+    {
+      index.probeInterleaved(keys, results, source, 3);
+      checkPassFail((int) results.size(), 7);
+      for (std::size_t k = 0; k < keys.size(); k++)
+        checkPassFail((results[k] == collectScan(&index, keys[k], GTE, keys[k], LTE)), true);
+    }
+    File::remove(intIndexName);
+  }
+  deleteRelation();
+
+  createRelationRandom();
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    std::vector<int> keys;
+    for (int key = 6000; key >= -1000; key -= 7) keys.push_back(key);
+    for (ProbeSource source : { PROBE_BUFFER_POOL, PROBE_FILE })
+    {
+      std::vector<std::vector<RecordId>> results;
+      index.probeInterleaved(keys, results, source);
+      int found = 0;
+      for (std::size_t k = 0; k < keys.size(); k++)
+        found += results[k].size() == 1 && results[k][0] == collectScan(&index, keys[k], GTE, keys[k], LTE)[0];
+      checkPassFail(found, 715);
+    }
+  }
+  {
+    // a pool of 6 frames, fewer than the leaves 16 random lookups pin: the group is capped to what
+    // half of it can hold pinned, and no pin outlives its lookup, or the checkpoint could not
+    // flush the index file
+    BufMgr* smallBufMgr = new BufMgr(6);
+    IndexOptions options;
+    options.poolFrames = 6;
+    {
+      BTreeIndex index(relationName, intIndexName, smallBufMgr, offsetof(tuple,i), INTEGER, options);
+      std::vector<int> keys;
+      for (int key = 6000; key >= -1000; key -= 7) keys.push_back(key);
+      std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+      std::vector<std::vector<RecordId>> results;
+      index.probeInterleaved(keys, results);
+      int found = 0;
+      for (std::size_t k = 0; k < keys.size(); k++)
+        found += results[k].size() == 1;
+      checkPassFail(found, 715);
+      index.checkpoint();
+    }
+    delete smallBufMgr;
+  }
+  std::cout << "test passed" << std::endl;
+  File::remove(intIndexName);
+  deleteRelation();
+}
+void test16()
+{
+  // testing a range-partitioned index: routing, scans across partitions and reopening
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 13: partitioned index" << std::endl;
+  createRelationRandom();
+  std::vector<int> splitKeys = { 1000, 2500, 4000 };
+  std::vector<BufMgr*> bufMgrs;
+  for (int i = 0; i < 4; i++) bufMgrs.push_back(new BufMgr(100));
+  std::vector<std::string> indexNames;
+  {
+    PartitionedIndex index(relationName, indexNames, bufMgrs, offsetof(tuple,i), INTEGER, splitKeys);
+    checkPassFail(index.numPartitions(), 4);
+    checkPassFail((int) indexNames.size(), 4);
+    checkPassFail(index.partitionOf(999), 0);
+    checkPassFail(index.partitionOf(1000), 1);
+    checkPassFail(index.partition(1).statsSummary().numEntries, 1500);
+    checkPassFail(index.partition(3).statsSummary().minKey, 4000);
+    checkPassFail(partitionedScan(&index,25,GT,40,LT), 14);
+    checkPassFail(partitionedScan(&index,999,GT,1000,LTE), 1);
+    checkPassFail(partitionedScan(&index,900,GTE,3100,LTE), 2201);
+    checkPassFail(partitionedScan(&index,0,GTE,4999,LTE), 5000);
+    checkPassFail(partitionedScan(&index,5000,GTE,9000,LTE), 0);
+
+    std::vector<int> keys = { 999, 1000, 2499, 2500, 7000, -5 };
+    std::vector<std::vector<RecordId>> results;
+    index.lookupBatch(keys, results);
+    for (int k = 0; k < 4; k++) checkPassFail((int) results[k].size(), 1);
+    checkPassFail((int) results[4].size(), 0);
+    checkPassFail((int) results[5].size(), 0);
+
+    int key = 7000;
+    RecordId rid = results[0][0];
+    index.insertEntry(&key, rid);
+    index.lookupBatch(keys, results);
+    checkPassFail((results[4].size() == 1 && results[4][0] == rid), true);
+    index.checkpoint();
+    checkPassFail(index.partition(3).statsSummary().maxKey, 7000);
+  }
+  {
+    // reopened with one buffer manager: nothing is inserted twice
+    std::vector<BufMgr*> shared(1, bufMgr);
+    PartitionedIndex index(relationName, indexNames, shared, offsetof(tuple,i), INTEGER, splitKeys);
+    checkPassFail(partitionedScan(&index,0,GTE,9000,LTE), 5001);
+  }
+  bool thrown = false;
+  std::vector<std::string> otherIndexNames;
+  try
+  {
+    std::vector<int> otherSplitKeys = { 2000 };
+    PartitionedIndex index(relationName, otherIndexNames, bufMgrs, offsetof(tuple,i), INTEGER, otherSplitKeys);
+  }
+  catch(const BadIndexInfoException &e)
+  {
+    thrown = true;
+  }
+  checkPassFail(thrown, true);
+  for (const std::string& indexName : indexNames) File::remove(indexName);
+  for (BufMgr* partBufMgr : bufMgrs) delete partBufMgr;
+  std::cout << "test passed" << std::endl;
+  deleteRelation();
+}
+void test17()
+{
+  // testing optimistic and latched lookups, alone and concurrently with inserts
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 14: optimistic lookups" << std::endl;
+  BufMgr* olcBufMgr = new BufMgr(1000);
+  test9Helper();
+  LeafFormat formats[] = { LEAF_PLAIN, LEAF_COMPRESSED, LEAF_POSTINGS };
+  for (LeafFormat format : formats)
+  {
+    IndexOptions options;
+    options.leafFormat = format;
+    options.optimisticReads = true;
+    BTreeIndex index(relationName, intIndexName, olcBufMgr, offsetof(tuple,i), INTEGER, options);
+    for (int key = -1; key <= 7; key++)
+    {
+      std::vector<RecordId> optimistic, latched;
+      index.lookupOptimistic(key, optimistic);
+      index.lookupLatched(key, latched);
+      std::vector<RecordId> scanned = collectScan(&index, key, GTE, key, LTE);
+      checkPassFail((optimistic == scanned), true);
+      checkPassFail((latched == scanned), true);
+    }
+    File::remove(intIndexName);
+  }
+  deleteRelation();
+
+  createRelationRandom();
+  {
+    IndexOptions options;
+    options.optimisticReads = true;
+    BTreeIndex index(relationName, intIndexName, olcBufMgr, offsetof(tuple,i), INTEGER, options);
+    std::vector<RecordId> first;
+    index.lookupOptimistic(0, first);
+    RecordId rid = first[0];
+
+    // readers look up old keys and keys already inserted, which must always be found, while the
+    // writer adds new ones and splits the nodes they are in
+    std::atomic<int> misses(0);
+    std::atomic<int> inserted(0);
+    std::atomic<bool> writing(true);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++)
+    {
+      readers.push_back(std::thread([&, t]() {
+        std::vector<RecordId> rids;
+        for (int key = t; writing.load() || key < 5000 * 4; key += 13)
+        {
+          rids.clear();
+          int done = inserted.load();
+          int target = key % 3 == 0 && done > 0 ? 5000 + key % done : key % 5000;
+          if (t % 2 == 0) index.lookupOptimistic(target, rids);
+          else index.lookupLatched(target, rids);
+          if (rids.size() != 1) misses++;
+        }
+      }));
+    }
+    for (int key = 5000; key < 10000; key++)
+    {
+      index.insertEntryInt(key, rid);
+      inserted++;
+    }
+    writing = false;
+    for (std::thread& reader : readers) reader.join();
+    checkPassFail(misses.load(), 0);
+
+    int found = 0;
+    for (int key = 5000; key < 10000; key++)
+    {
+      std::vector<RecordId> rids;
+      index.lookupOptimistic(key, rids);
+      found += rids.size() == 1;
+    }
+    checkPassFail(found, 5000);
+  }
+  {
+    // a pool that cannot hold the whole index is refused when the index is opened
+    BufMgr* smallBufMgr = new BufMgr(4);
+    IndexOptions options;
+    options.optimisticReads = true;
+    bool refused = false;
+    try
+    {
+      BTreeIndex index(relationName, intIndexName, smallBufMgr, offsetof(tuple,i), INTEGER, options);
+    }
+    catch(const BufferExceededException &e)
+    {
+      refused = true;
+    }
+    checkPassFail(refused, true);
+    delete smallBufMgr;
+  }
+  std::cout << "test passed" << std::endl;
+  File::remove(intIndexName);
+  deleteRelation();
+  delete olcBufMgr;
+}
+void test18()
+{
+  // testing the delta buffer: scans and lookups read buffered inserts, merging keeps them
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 15: delta buffer" << std::endl;
+  createRelationRandom();
+  LeafFormat formats[] = { LEAF_PLAIN, LEAF_COMPRESSED, LEAF_POSTINGS };
+  for (LeafFormat format : formats)
+  {
+    IndexOptions options;
+    options.leafFormat = format;
+    options.deltaEntries = 700;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+    IndexCounters counters = index.getCounters();
+    checkPassFail((counters.deltaMerges > 0), true);
+    checkPassFail(intScan(&index,25,GT,40,LT), 14);
+    checkPassFail(intScan(&index,996,GT,1001,LT), 4);
+
+    // buffered: keys 5000 to 5199 past the tree, and a second entry for each of 100 to 109
+    for (int key = 5000; key < 5200; key++)
+    {
+      RecordId rid;
+      rid.page_number = key;
+      rid.slot_number = 1;
+      index.insertEntryInt(key, rid);
+    }
+    std::vector<RecordId> dups = collectScan(&index, 100, GTE, 109, LTE);
+    for (int key = 100; key < 110; key++) index.insertEntryInt(key, dups[key - 100]);
+    checkPassFail(index.getCounters().deltaMerges, counters.deltaMerges);
+
+    std::vector<RecordId> past = collectScan(&index, 5000, GTE, 5199, LTE);
+    checkPassFail((int) past.size(), 200);
+    checkPassFail((past[0].page_number == 5000 && past[199].page_number == 5199), true);
+    checkPassFail((int) collectScan(&index, 4990, GTE, 5009, LTE).size(), 20);
+    checkPassFail(intScan(&index,99,GT,110,LT), 20);
+    int low = 95, high = 115;
+    std::vector<RecordId> async;
+    index.scanAsync(&low, GTE, &high, LTE, async);
+    checkPassFail((async == collectScan(&index, 95, GTE, 115, LTE)), true);
+
+    std::vector<int> keys = { 105, 5100, 6000 };
+    std::vector<std::vector<RecordId>> results;
+    index.probeInterleaved(keys, results);
+    checkPassFail((results[0].size() == 2 && results[1].size() == 1 && results[2].empty()), true);
+    index.lookupBatch(keys, results);
+    checkPassFail((results[0].size() == 2 && results[1].size() == 1 && results[2].empty()), true);
+
+    std::vector<RecordId> buffered = collectScan(&index, 0, GTE, 6000, LTE);
+    index.mergeDelta();
+    checkPassFail(index.getCounters().deltaEntriesMerged, counters.deltaEntriesMerged + 210);
+    std::vector<RecordId> merged = collectScan(&index, 0, GTE, 6000, LTE);
+    std::sort(buffered.begin(), buffered.end(), ridLess);
+    std::sort(merged.begin(), merged.end(), ridLess);
+    checkPassFail((int) merged.size(), 5210);
+    checkPassFail((merged == buffered), true);
+    File::remove(intIndexName);
+  }
+  std::cout << "test passed" << std::endl;
+  deleteRelation();
+}
+void test19()
+{
+  // testing buffered non-leaf nodes: lookups read the buffers, scans apply them first
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 16: buffered non-leaf nodes" << std::endl;
+  createRelationRandom();
+  LeafFormat formats[] = { LEAF_PLAIN, LEAF_COMPRESSED, LEAF_POSTINGS };
+  for (LeafFormat format : formats)
+  {
+    IndexOptions options;
+    options.leafFormat = format;
+    options.nonLeafFormat = NONLEAF_BUFFERED;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+    IndexCounters counters = index.getCounters();
+    checkPassFail((counters.bufferFlushes > 0), true);
+    checkPassFail(intScan(&index,25,GT,40,LT), 14);
+    checkPassFail(intScan(&index,996,GT,1001,LT), 4);
+
+    // enough random keys past the relation for the tree to grow a level of non-leaf nodes
+    std::vector<int> keys;
+    for (int key = 5000; key < 65000; key++) keys.push_back(key);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(format));
+    for (int key : keys)
+    {
+      RecordId rid;
+      rid.page_number = key;
+      rid.slot_number = 1;
+      index.insertEntryInt(key, rid);
+    }
+    checkPassFail((index.getCounters().bufferFlushes > counters.bufferFlushes), true);
+
+    std::vector<int> lookups = { 42, 5000, 30000, 64999, 70000 };
+    std::vector<std::vector<RecordId>> results;
+    index.probeInterleaved(lookups, results);
+    checkPassFail((results[0].size() == 1 && results[1].size() == 1 && results[2].size() == 1 && results[3].size() == 1 && results[4].empty()), true);
+    checkPassFail((results[2][0].page_number == 30000), true);
+    index.lookupBatch(lookups, results);
+    checkPassFail((results[0].size() == 1 && results[1].size() == 1 && results[2].size() == 1 && results[3].size() == 1 && results[4].empty()), true);
+
+    std::vector<RecordId> range = collectScan(&index, 30000, GTE, 30999, LTE);
+    checkPassFail((int) range.size(), 1000);
+    checkPassFail((range[0].page_number == 30000 && range[999].page_number == 30999), true);
+    index.probeInterleaved(lookups, results);
+    checkPassFail((results[2].size() == 1), true);
+
+    IndexStats stats = index.collectStats();
+    checkPassFail((int) stats.numEntries, 65000);
+    checkPassFail((stats.height >= 3), true);
+    checkPassFail((int) collectScan(&index, 0, GTE, 70000, LTE).size(), 65000);
+    File::remove(intIndexName);
+  }
+  std::cout << "test passed" << std::endl;
+  deleteRelation();
+}
+void test20()
+{
+  // testing the merge join of two indexes and the rid-set operators
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 17: merge join and rid-set intersection" << std::endl;
+  createRelationForward();
+  {
+    BTreeIndex left(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    // an index file of its own, filled with sparse keys below
+    IndexOptions options;
+    options.buildFromRelation = false;
+    std::string rightIndexName;
+    BTreeIndex right(relationName, rightIndexName, bufMgr, offsetof(tuple,d), INTEGER, options);
+    for (int key = 0; key < 5000; key += 1000)
+    {
+      RecordId rid;
+      rid.page_number = key;
+      rid.slot_number = 9;
+      left.insertEntryInt(key, rid);
+    }
+    for (int key = 0; key < 9000; key += 1500)
+    {
+      for (int slot = 1; slot <= 2; slot++)
+      {
+        RecordId rid;
+        rid.page_number = key;
+        rid.slot_number = slot;
+        right.insertEntryInt(key, rid);
+      }
+    }
+
+    std::vector<std::pair<RecordId, RecordId>> expected;
+    for (int key = 0; key < 5000; key += 1500)
+      for (RecordId l : collectScan(&left, key, GTE, key, LTE))
+        for (RecordId r : collectScan(&right, key, GTE, key, LTE))
+          expected.push_back(std::make_pair(l, r));
+    checkPassFail((int) expected.size(), 12);
+
+    IndexCounters counters = left.getCounters();
+    std::vector<std::pair<RecordId, RecordId>> pairs;
+    {
+      MergeJoin join(left, right, ScanRange{ 0, GTE, 10000, LTE });
+      RecordId l, r;
+      while (join.next(l, r)) pairs.push_back(std::make_pair(l, r));
+      checkPassFail(join.next(l, r), false);
+    }
+    checkPassFail((pairs == expected), true);
+    checkPassFail((left.getCounters().skipDescents > counters.skipDescents), true);
+
+    int count = 0;
+    {
+      MergeJoin join(right, left, ScanRange{ 1000, GT, 3000, LTE });
+      RecordId l, r;
+      while (join.next(l, r)) count++;
+    }
+    checkPassFail(count, 6);
+    {
+      MergeJoin join(left, right, ScanRange{ 5001, GTE, 10000, LTE });
+      RecordId l, r;
+      checkPassFail(join.next(l, r), false);
+    }
+
+    std::vector<RecordId> low, high, both, either;
+    scanRangeRids(left, ScanRange{ 100, GTE, 300, LTE }, low);
+    scanRangeRids(left, ScanRange{ 200, GTE, 500, LT }, high);
+    intersectRids(low, high, both);
+    std::vector<RecordId> overlap = collectScan(&left, 200, GTE, 300, LTE);
+    std::sort(overlap.begin(), overlap.end(), ridLess);
+    checkPassFail((both == overlap), true);
+    unionRids(low, high, either);
+    std::vector<RecordId> all = collectScan(&left, 100, GTE, 500, LT);
+    std::sort(all.begin(), all.end(), ridLess);
+    checkPassFail((either == all), true);
+    intersectRids(low, std::vector<RecordId>(), both);
+    checkPassFail(both.empty(), true);
+    File::remove(rightIndexName);
+  }
+  std::cout << "test passed" << std::endl;
+  File::remove(intIndexName);
+  deleteRelation();
+}
+void test21()
+{
+  // testing scans of several ranges and of IN lists in one cursor
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 18: multi-range and IN-list scans" << std::endl;
+  createRelationForward();
+  LeafFormat formats[] = { LEAF_PLAIN, LEAF_COMPRESSED, LEAF_POSTINGS };
+  for (LeafFormat format : formats)
+  {
+    IndexOptions options;
+    options.leafFormat = format;
+    options.deltaEntries = 100;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+    // buffered in the delta: a second entry for 4000, and keys past the relation
+    RecordId extra;
+    extra.page_number = 9999;
+    extra.slot_number = 1;
+    index.insertEntryInt(4000, extra);
+    index.insertEntryInt(6500, extra);
+
+    std::vector<ScanRange> ranges = { { 10, GTE, 20, LT }, { 100, GT, 105, LTE }, { 4000, GTE, 4000, LTE }, { 6000, GT, 7000, LT } };
+    std::vector<RecordId> expected;
+    for (const ScanRange& range : ranges)
+    {
+      std::vector<RecordId> rids = collectScan(&index, range.lowVal, range.lowOp, range.highVal, range.highOp);
+      expected.insert(expected.end(), rids.begin(), rids.end());
+    }
+    checkPassFail((int) expected.size(), 18);
+    IndexCounters counters = index.getCounters();
+    index.startMultiScan(ranges);
+    std::vector<RecordId> rids(64);
+    rids.resize(index.scanNextBatch(rids.data(), 64));
+    try
+    {
+      RecordId rid;
+      while (true)
+      {
+        index.scanNext(rid);
+        rids.push_back(rid);
+      }
+    }
+    catch(const IndexScanCompletedException &e)
+    {
+    }
+    index.endScan();
+    checkPassFail((rids == expected), true);
+    checkPassFail((index.getCounters().descents - counters.descents < ranges.size()), true);
+
+    std::vector<int> keys = { 4999, 3, 900, 41000, 3, 2500 };
+    index.startInListScan(keys);
+    std::vector<int> found;
+    try
+    {
+      int key;
+      RecordId rid;
+      while (true)
+      {
+        index.scanNextEntry(key, rid);
+        found.push_back(key);
+      }
+    }
+    catch(const IndexScanCompletedException &e)
+    {
+    }
+    index.endScan();
+    checkPassFail((found == std::vector<int>({ 3, 900, 2500, 4999 })), true);
+    checkPassFail((index.getCounters().skipDescents > counters.skipDescents), true);
+
+    int exceptionCount = 0;
+    try
+    {
+      index.startInListScan(std::vector<int>({ -5, 7000, 41000 }));
+    }
+    catch(const NoSuchKeyFoundException &e)
+    {
+      exceptionCount++;
+    }
+    try
+    {
+      index.startMultiScan(std::vector<ScanRange>({ { 10, GTE, 20, LTE }, { 20, GTE, 30, LT } }));
+    }
+    catch(const BadScanrangeException &e)
+    {
+      exceptionCount++;
+    }
+    checkPassFail(exceptionCount, 2);
+    File::remove(intIndexName);
+  }
+  std::cout << "test passed" << std::endl;
+  deleteRelation();
+}
+void test22()
+{
+  // testing bitmaps of scan results and their AND and OR
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 19: rid bitmaps" << std::endl;
+  createRelationRandom();
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    RidBitmap low, high, both, either;
+    scanBitmap(index, ScanRange{ 100, GTE, 3000, LT }, low);
+    scanBitmap(index, ScanRange{ 2000, GTE, 4000, LT }, high);
+    checkPassFail((int) low.cardinality(), 2900);
+
+    std::vector<RecordId> rids, expected;
+    low.toRids(rids);
+    expected = collectScan(&index, 100, GTE, 3000, LT);
+    std::sort(expected.begin(), expected.end(), ridLess);
+    checkPassFail((rids == expected), true);
+    checkPassFail((low.contains(expected[0]) && low.contains(expected.back())), true);
+    checkPassFail(low.contains(collectScan(&index, 3000, GTE, 3000, LTE)[0]), false);
+
+    both = bitmapAnd(low, high);
+    both.toRids(rids);
+    expected = collectScan(&index, 2000, GTE, 3000, LT);
+    std::sort(expected.begin(), expected.end(), ridLess);
+    checkPassFail((rids == expected), true);
+    either = bitmapOr(low, high);
+    either.toRids(rids);
+    expected = collectScan(&index, 100, GTE, 4000, LT);
+    std::sort(expected.begin(), expected.end(), ridLess);
+    checkPassFail((rids == expected), true);
+
+    // pages are visited in order, each with its slots
+    std::size_t total = 0;
+    std::vector<SlotId> slots;
+    for (std::size_t i = 0; i < either.numPages(); i++)
+    {
+      either.pageSlots(i, slots);
+      total += slots.size();
+      if (i > 0 && either.page(i) <= either.page(i - 1)) total = 0;
+    }
+    checkPassFail((int) total, 3900);
+    // the ranges cover most slots of their pages: bitsets are smaller than slot arrays
+    checkPassFail((either.sizeInBytes() < 3900 * sizeof(SlotId)), true);
+
+    scanBitmap(index, std::vector<ScanRange>({ { 10, GTE, 20, LT }, { 4990, GTE, 6000, LT } }), either);
+    checkPassFail((int) either.cardinality(), 20);
+    scanBitmap(index, ScanRange{ 6000, GTE, 7000, LT }, either);
+    checkPassFail((int) either.cardinality(), 0);
+    checkPassFail((int) bitmapAnd(low, either).cardinality(), 0);
+    checkPassFail((int) bitmapOr(either, low).cardinality(), 2900);
+  }
+  std::cout << "test passed" << std::endl;
+  File::remove(intIndexName);
+  deleteRelation();
+}
+void test23()
+{
+  // testing the fetch of the records of a scan grouped by heap page
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 20: heap fetch in page order" << std::endl;
+  createRelationRandom();
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    RecordId rid;
+    std::string record;
+    for (int batchSize : { 4, 2 * relationSize })
+    {
+      // key order: the records come back as the scan returns their rids
+      HeapFetcher ordered(index, file1, bufMgr, true, batchSize);
+      ordered.startScan(ScanRange{ 25, GT, 40, LT });
+      std::vector<int> keys;
+      std::vector<RecordId> rids;
+      while (ordered.next(rid, record))
+      {
+        keys.push_back(reinterpret_cast<const RECORD*>(record.data())->i);
+        rids.push_back(rid);
+      }
+      checkPassFail(ordered.next(rid, record), false);
+      checkPassFail((int) keys.size(), 14);
+      checkPassFail(std::is_sorted(keys.begin(), keys.end()), true);
+      checkPassFail((rids == collectScan(&index, 25, GT, 40, LT)), true);
+
+      // heap order: each page once per batch, so once in all for one batch of the whole relation
+      HeapFetcher grouped(index, file1, bufMgr, false, batchSize);
+      grouped.startScan(ScanRange{ 0, GTE, 4999, LTE });
+      int count = 0;
+      bool inOrder = true;
+      RecordId last;
+      last.page_number = 0;
+      last.slot_number = 0;
+      while (grouped.next(rid, record))
+      {
+        if (count > 0 && !ridLess(last, rid)) inOrder = false;
+        last = rid;
+        count++;
+      }
+      checkPassFail(count, relationSize);
+      if (batchSize > 4)
+      {
+        checkPassFail(inOrder, true);
+        RidBitmap all;
+        scanBitmap(index, ScanRange{ 0, GTE, 4999, LTE }, all);
+        checkPassFail((grouped.pagesRead() == all.numPages()), true);
+      }
+    }
+
+    RidBitmap bitmap;
+    scanBitmap(index, ScanRange{ 1000, GTE, 1999, LTE }, bitmap);
+    std::vector<std::string> records;
+    fetchRecords(bitmap, file1, bufMgr, records);
+    checkPassFail((int) records.size(), 1000);
+    int inRange = 0;
+    for (const std::string& r : records)
+    {
+      int key = reinterpret_cast<const RECORD*>(r.data())->i;
+      inRange += key >= 1000 && key <= 1999;
+    }
+    checkPassFail(inRange, 1000);
+
+    // a rid that names no record: the exception leaves no page of the relation pinned
+    RecordId stale = collectScan(&index, 4999, GTE, 4999, LTE)[0];
+    stale.slot_number = 4000;
+    index.insertEntryInt(6000, stale);
+    int thrown = 0;
+    try
+    {
+      HeapFetcher fetcher(index, file1, bufMgr);
+      fetcher.startScan(ScanRange{ 4990, GTE, 6000, LTE });
+      while (fetcher.next(rid, record)) {}
+    }
+    catch(const InvalidRecordException &e)
+    {
+      thrown++;
+    }
+    try
+    {
+      fetchRecords(RidBitmap::fromRids({ stale }), file1, bufMgr, records);
+    }
+    catch(const InvalidRecordException &e)
+    {
+      thrown++;
+    }
+    checkPassFail(thrown, 2);
+    bool pinned = false;
+    try
+    {
+      bufMgr->flushFile(file1);
+    }
+    catch(const PagePinnedException &e)
+    {
+      pinned = true;
+    }
+    checkPassFail(pinned, false);
+  }
+  std::cout << "test passed" << std::endl;
+  File::remove(intIndexName);
+  deleteRelation();
+}
+void test24()
+{
+  // testing the online build: inserts during the build go through the side-log, none is lost or doubled
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 21: online index build" << std::endl;
+  createRelationRandom();
+  std::vector<std::pair<int, RecordId>> records;
+  {
+    FileScan fscan(relationName, bufMgr);
+    try
+    {
+      RecordId scanRid;
+      while (1)
+      {
+        fscan.scanNext(scanRid);
+        std::string recordStr = fscan.getRecord();
+        records.emplace_back(reinterpret_cast<const RECORD*>(recordStr.c_str())->i, scanRid);
+      }
+    }
+    catch(const EndOfFileException &e)
+    {
+    }
+  }
+  {
+    IndexOptions options;
+    options.onlineBuild = true;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+    checkPassFail(index.building(), true);
+    checkPassFail((int) collectScan(&index, 0, GTE, 4999, LTE).size(), 0);
+
+    // keys 5000 to 6999 past the relation, and a second insert of the last 100 records, whose
+    // pages the scan has yet to read when they are logged
+    int nextKey = 5000;
+    int steps = 0;
+    while (index.buildStep(2))
+    {
+      for (int i = 0; i < 50; i++, nextKey++)
+      {
+        RecordId rid;
+        rid.page_number = nextKey;
+        rid.slot_number = 1;
+        index.insertEntryInt(nextKey, rid);
+      }
+      if (steps++ == 0)
+        for (std::size_t i = records.size() - 100; i < records.size(); i++)
+          index.insertEntryInt(records[i].first, records[i].second);
+    }
+    checkPassFail((steps > 1), true);
+    checkPassFail((int) collectScan(&index, 0, GTE, 4999, LTE).size(), relationSize);
+
+    // a writer keeps appending to the side-log while finishBuild() catches up
+    std::atomic<bool> started(false);
+    std::thread writer([&index, &started]() {
+      for (int key = 7000; key < 9000; key++)
+      {
+        RecordId rid;
+        rid.page_number = key;
+        rid.slot_number = 1;
+        index.insertEntryInt(key, rid);
+        started = true;
+        if (!index.building()) break;
+      }
+    });
+    while (!started) std::this_thread::yield();
+    index.finishBuild();
+    writer.join();
+    checkPassFail(index.building(), false);
+    IndexCounters counters = index.getCounters();
+    checkPassFail((counters.finalCatchUpEntries <= (std::uint64_t) BUILDCATCHUPENTRIES), true);
+    checkPassFail((counters.sideLogApplied >= (std::uint64_t) (nextKey - 5000 + 100)), true);
+
+    std::vector<RecordId> all = collectScan(&index, 0, GTE, 4999, LTE);
+    std::sort(all.begin(), all.end(), ridLess);
+    checkPassFail((int) all.size(), relationSize);
+    checkPassFail((std::adjacent_find(all.begin(), all.end()) == all.end()), true);
+    checkPassFail((int) collectScan(&index, 5000, GTE, 6999, LTE).size(), nextKey - 5000);
+    std::vector<RecordId> written = collectScan(&index, 7000, GTE, 8999, LTE);
+    checkPassFail((!written.empty() && written.back().page_number - 7000 + 1 == written.size()), true);
+  }
+  std::cout << "test passed" << std::endl;
+  File::remove(intIndexName);
+  deleteRelation();
+}
+void test25()
+{
+  // testing the open of an existing index: no rebuild while it is current, a rebuild once it is not
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 22: index open without rebuild" << std::endl;
+  createRelationRandom();
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    checkPassFail((int) index.tupleCount(), relationSize);
+  }
+  {
+    // one read of the meta page, and no second entry per record
+    bufMgr->clearBufStats();
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    checkPassFail(bufMgr->getBufStats().diskreads, 1);
+    checkPassFail((int) index.tupleCount(), relationSize);
+    checkPassFail((int) collectScan(&index, 0, GTE, 4999, LTE).size(), relationSize);
+    checkPassFail(index.statsSummary().numEntries, (std::int64_t) relationSize);
+  }
+  {
+    // an open that only reads leaves the meta page clean: nothing is written back
+    bufMgr->clearBufStats();
+    {
+      BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+      checkPassFail(intScan(&index, 4990, GT, 4999, LTE), 9);
+    }
+    checkPassFail(bufMgr->getBufStats().diskwrites, 0);
+  }
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    index.insertEntryInt(5000, collectScan(&index, 4999, GTE, 4999, LTE)[0]);
+  }
+  {
+    // inserts since the open are kept, and counted
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    checkPassFail((int) index.tupleCount(), relationSize + 1);
+    checkPassFail(intScan(&index, 4990, GT, 5000, LTE), 10);
+  }
+  {
+    // a format option changed on open is still refused
+    IndexOptions options;
+    options.lowKey = 0;
+    bool refused = false;
+    try
+    {
+      BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+    }
+    catch(const BadIndexInfoException &e)
+    {
+      refused = true;
+    }
+    checkPassFail(refused, true);
+  }
+  {
+    // the first insert after the open writes the cleared complete mark through to the file, so
+    // that a crash while a small pool evicts the nodes of later inserts leaves an index that is rebuilt
+    BufMgr* smallBufMgr = new BufMgr(6);
+    std::vector<Page> crashImage;
+    {
+      BTreeIndex index(relationName, intIndexName, smallBufMgr, offsetof(tuple,i), INTEGER);
+      std::vector<RecordId> rids = collectScan(&index, 0, GTE, 999, LTE);
+      index.insertEntryInt(6000, rids[0]);
+      BlobFile indexFile(intIndexName, false);
+      Page metaPage = indexFile.readPage(1);
+      checkPassFail(reinterpret_cast<IndexMetaInfo*>(&metaPage)->complete, false);
+
+      smallBufMgr->clearBufStats();
+      for (int key = 6001; key < 20000; key++) index.insertEntryInt(key, rids[key % 1000]);
+      checkPassFail((smallBufMgr->getBufStats().diskwrites > 0), true);
+      try
+      {
+        for (PageId pageNo = 1; ; pageNo++) crashImage.push_back(indexFile.readPage(pageNo));
+      }
+      catch(const InvalidPageException &e)
+      {
+      }
+      metaPage = crashImage[0];
+      checkPassFail(reinterpret_cast<IndexMetaInfo*>(&metaPage)->complete, false);
+    }
+    delete smallBufMgr;
+
+    // the index file as the crash left it
+    File::remove(intIndexName);
+    {
+      BlobFile indexFile(intIndexName, true);
+      for (const Page& page : crashImage)
+      {
+        PageId pageNo;
+        indexFile.allocatePage(pageNo);
+        indexFile.writePage(pageNo, page);
+      }
+    }
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    checkPassFail((int) index.tupleCount(), relationSize);
+    checkPassFail((int) collectScan(&index, 0, GTE, 19999, LTE).size(), relationSize);
+  }
+  {
+    // a record dropped from the last page in place, with the size and the modification time of the
+    // relation file kept, still makes the index stale
+    struct stat st;
+    stat(relationName.c_str(), &st);
+    {
+      PageFile relation(relationName, false);
+      PageId lastPageNo = st.st_size / Page::SIZE;
+      Page lastPage = relation.readPage(lastPageNo);
+      RecordId lastRid;
+      lastRid.page_number = lastPageNo;
+      SlotId lastSlot = 0;
+      try
+      {
+        for (lastRid.slot_number = 1; ; lastRid.slot_number++)
+        {
+          lastPage.getRecord(lastRid);
+          lastSlot = lastRid.slot_number;
+        }
+      }
+      catch(const InvalidRecordException &e)
+      {
+      }
+      lastRid.slot_number = lastSlot;
+      lastPage.deleteRecord(lastRid);
+      relation.writePage(lastPageNo, lastPage);
+    }
+    struct timespec times[2] = { st.st_atim, st.st_mtim };
+    utimensat(AT_FDCWD, relationName.c_str(), times, 0);
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    checkPassFail((int) index.tupleCount(), relationSize - 1);
+    checkPassFail((int) collectScan(&index, 0, GTE, 4999, LTE).size(), relationSize - 1);
+  }
+
+  // a relation written anew makes the index stale: it is rebuilt from the relation
+  deleteRelation();
+  createRelationRandom();
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    checkPassFail((int) index.tupleCount(), relationSize);
+    checkPassFail(intScan(&index, 4990, GT, 5000, LTE), 9);
+    checkPassFail((int) collectScan(&index, 0, GTE, 4999, LTE).size(), relationSize);
+  }
+  std::cout << "test passed" << std::endl;
+  File::remove(intIndexName);
+  deleteRelation();
+}
+void test26()
+{
+  // testing compaction: same entries in fewer, fuller leaves, in a file that opens as before
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 23: index compaction" << std::endl;
+  createRelationRandom();
+  LeafFormat formats[] = { LEAF_PLAIN, LEAF_COMPRESSED, LEAF_POSTINGS };
+  for (LeafFormat format : formats)
+  {
+    IndexOptions options;
+    options.leafFormat = format;
+    options.deltaEntries = format == LEAF_PLAIN ? 700 : 0;
+    {
+      BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+      // second entries for keys 0 to 99, left in the delta for LEAF_PLAIN
+      std::vector<RecordId> dups = collectScan(&index, 0, GTE, 99, LTE);
+      for (int key = 0; key < 100; key++) index.insertEntryInt(key, dups[key]);
+      std::vector<RecordId> before = collectScan(&index, 0, GTE, 4999, LTE);
+      IndexStats statsBefore = index.collectStats();
+
+      int low = 10, high = 20;
+      index.startScan(&low, GTE, &high, LTE);
+      index.compact();
+      checkPassFail(index.getCounters().compactions, (std::uint64_t) 1);
+      IndexStats statsAfter = index.collectStats();
+      checkPassFail(statsAfter.numEntries, statsBefore.numEntries);
+      checkPassFail((statsAfter.numLeafPages < statsBefore.numLeafPages), true);
+      // full leaves but for the last
+      if (format == LEAF_PLAIN) checkPassFail(statsAfter.numLeafPages, (int) ((statsAfter.numEntries + INTARRAYLEAFSIZE - 1) / INTARRAYLEAFSIZE));
+      checkPassFail((collectScan(&index, 0, GTE, 4999, LTE) == before), true);
+      checkPassFail(intScan(&index,125,GT,140,LT), 14);
+      checkPassFail(intScan(&index,-3,GT,3,LT), 6);
+
+      // inserts after the compaction split as usual
+      for (int key = 0; key < 100; key++) index.insertEntryInt(key + 5000, dups[key]);
+      checkPassFail((int) collectScan(&index, 0, GTE, 5099, LTE).size(), relationSize + 200);
+
+      index.compact(70);
+      if (format == LEAF_PLAIN) checkPassFail((index.collectStats().avgLeafFill < 0.75), true);
+      checkPassFail((int) collectScan(&index, 0, GTE, 5099, LTE).size(), relationSize + 200);
+    }
+    {
+      // the compacted file is the index file: it opens without a rebuild
+      BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+      checkPassFail((int) index.tupleCount(), relationSize + 200);
+      checkPassFail((int) collectScan(&index, 0, GTE, 5099, LTE).size(), relationSize + 200);
+    }
+    File::remove(intIndexName);
+  }
+  {
+    // runs of one key longer than a leaf: compact() appends them to the rightmost leaf, so every
+    // leaf but the last is still full
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    std::vector<RecordId> rids = collectScan(&index, 0, GTE, 4999, LTE);
+    int runLength = INTARRAYLEAFSIZE * 3 / 2;
+    for (int run = 0; run < 6; run++)
+      for (int k = 0; k < runLength; k++) index.insertEntryInt(10000 + run, rids[(run * runLength + k) % relationSize]);
+    index.compact();
+    int entries = relationSize + 6 * runLength;
+    checkPassFail(index.statsSummary().numEntries, (std::int64_t) entries);
+    checkPassFail(index.collectStats().numLeafPages, (entries + INTARRAYLEAFSIZE - 1) / INTARRAYLEAFSIZE);
+    for (int run = 0; run < 6; run++) checkPassFail(intScan(&index, 10000 + run, GTE, 10000 + run, LTE), runLength);
+  }
+  File::remove(intIndexName);
+  std::cout << "test passed" << std::endl;
+  deleteRelation();
+}
+void test27()
+{
+  // testing the in-memory index: no index page through the buffer pool, and snapshots that open either way
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 24: in-memory index" << std::endl;
+  createRelationRandom();
+  IndexOptions options;
+  options.inMemory = true;
+  std::vector<RecordId> all;
+  {
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+    checkPassFail(index.inMemory(), true);
+    checkPassFail((int) index.tupleCount(), relationSize);
+    bufMgr->clearBufStats();
+    all = collectScan(&index, 0, GTE, 4999, LTE);
+    checkPassFail((int) all.size(), relationSize);
+    std::vector<int> keys = { 7, -1, 4999, 2500 };
+    std::vector<std::vector<RecordId>> results;
+    index.lookupBatch(keys, results);
+    checkPassFail((int) (results[0].size() + results[1].size() + results[2].size() + results[3].size()), 3);
+    index.probeInterleaved(keys, results, PROBE_FILE);
+    checkPassFail((results[2].size() == 1 && results[2][0] == all[4999]), true);
+    checkPassFail(bufMgr->getBufStats().diskreads, 0);
+    checkPassFail(intScan(&index,25,GT,40,LT), 14);
+
+    // second entries for keys 0 to 99, then compaction through the free list of the arena
+    for (int key = 0; key < 100; key++) index.insertEntryInt(key, all[key]);
+    index.compact();
+    checkPassFail((int) collectScan(&index, 0, GTE, 4999, LTE).size(), relationSize + 100);
+    checkPassFail(intScan(&index,-3,GT,3,LT), 6);
+    index.saveSnapshot();
+  }
+  {
+    // the snapshot is an index file: the buffer pool index opens it without a rebuild
+    bufMgr->clearBufStats();
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+    checkPassFail(bufMgr->getBufStats().diskreads, 1);
+    checkPassFail((int) index.tupleCount(), relationSize + 100);
+    checkPassFail((int) collectScan(&index, 0, GTE, 4999, LTE).size(), relationSize + 100);
+    index.insertEntryInt(5000, all[4999]);
+  }
+  {
+    // and so does the in-memory index, which reads it once
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+    checkPassFail((int) index.tupleCount(), relationSize + 101);
+    bufMgr->clearBufStats();
+    checkPassFail((int) collectScan(&index, 0, GTE, 5000, LTE).size(), relationSize + 101);
+    checkPassFail(bufMgr->getBufStats().diskreads, 0);
+    checkPassFail(intScan(&index,4990,GT,5000,LTE), 10);
+    index.insertEntryInt(5001, all[4999]);
+  }
+  {
+    // inserts not saved to a snapshot are lost: the file is as the buffer pool index left it
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+    checkPassFail((int) index.tupleCount(), relationSize + 101);
+  }
+  std::cout << "test passed" << std::endl;
+  File::remove(intIndexName);
+  deleteRelation();
+}
+void test28()
+{
+  // testing the scan ring: a scan of many more leaves than a small pool holds returns every entry,
+  // and leaves the pages the pool held before the scan resident
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 25: scan ring over a small buffer pool" << std::endl;
+  test5Helper();
+  BufMgr* smallBufMgr = new BufMgr(32);
+  {
+    BTreeIndex index(relationName, intIndexName, smallBufMgr, offsetof(tuple,i), INTEGER);
+    IndexStats stats = index.collectStats();
+    checkPassFail((stats.numLeafPages > 4 * SCANRINGTHRESHOLD), true);
+    Page* page;
+    smallBufMgr->readPage(file1, 1, page);
+    smallBufMgr->unPinPage(file1, 1, false);
+
+    index.resetCounters();
+    smallBufMgr->clearBufStats();
+    int low = 0, high = 199999;
+    index.startScan(&low, GTE, &high, LTE);
+    int count = 0;
+    bool inOrder = true;
+    try
+    {
+      int key;
+      RecordId rid;
+      while (true)
+      {
+        index.scanNextEntry(key, rid);
+        if (key != count) inOrder = false;
+        count++;
+      }
+    }
+    catch(const IndexScanCompletedException &e)
+    {
+    }
+    index.endScan();
+    checkPassFail(count, 200000);
+    checkPassFail(inOrder, true);
+    checkPassFail((int) index.getCounters().scanRingReads, stats.numLeafPages - SCANRINGTHRESHOLD);
+    // the pool only took the path to the first leaf and the leaves before the ring
+    checkPassFail((smallBufMgr->getBufStats().diskreads <= stats.height + SCANRINGTHRESHOLD), true);
+
+    smallBufMgr->clearBufStats();
+    smallBufMgr->readPage(file1, 1, page);
+    smallBufMgr->unPinPage(file1, 1, false);
+    checkPassFail(smallBufMgr->getBufStats().diskreads, 0);
+    smallBufMgr->flushFile(file1);
+  }
+  delete smallBufMgr;
+  std::cout << "test passed" << std::endl;
+  deleteRelation();
+  File::remove(intIndexName);
+}
+void test29()
+{
+  // testing inserts while a scan is open: refused while they would move the entries of the
+  // scanned leaf, taken by the delta when the index has one
+	std::cout << "---------------------" << std::endl;
+	std::cout << "Custome Test 26: inserts during a scan" << std::endl;
+  createRelationForward();
+  for (int deltaEntries : { 0, 700 })
+  {
+    IndexOptions options;
+    options.deltaEntries = deltaEntries;
+    BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+    std::vector<RecordId> rids = collectScan(&index, 0, GTE, 4999, LTE);
+    int leavesBefore = index.collectStats().numLeafPages;
+
+    int low = 1000, high = 4999;
+    index.startScan(&low, GTE, &high, LTE);
+    std::vector<RecordId> scanned;
+    RecordId rid;
+    for (int i = 0; i < 10; i++)
+    {
+      index.scanNext(rid);
+      scanned.push_back(rid);
+    }
+    // second entries for keys behind and ahead of the scan, into its leaf until it would split
+    int refused = 0;
+    for (int k = 0; k < INTARRAYLEAFSIZE; k++)
+    {
+      try
+      {
+        index.insertEntryInt(1005 + k % 10, rids[1005 + k % 10]);
+      }
+      catch(const PagePinnedException &e)
+      {
+        refused++;
+      }
+    }
+    checkPassFail(refused, (deltaEntries == 0 ? INTARRAYLEAFSIZE : 0));
+    try
+    {
+      while (true)
+      {
+        index.scanNext(rid);
+        scanned.push_back(rid);
+      }
+    }
+    catch(const IndexScanCompletedException &e)
+    {
+    }
+    index.endScan();
+    // every entry of the tree once, none of those inserted since the scan started
+    checkPassFail((scanned == std::vector<RecordId>(rids.begin() + 1000, rids.end())), true);
+
+    // once the scan has ended the same inserts split the leaf
+    if (deltaEntries == 0)
+    {
+      for (int k = 0; k < INTARRAYLEAFSIZE; k++)
+        index.insertEntryInt(1005 + k % 10, rids[1005 + k % 10]);
+      checkPassFail((index.collectStats().numLeafPages > leavesBefore), true);
+    }
+    checkPassFail((int) collectScan(&index, 1000, GTE, 4999, LTE).size(), 4000 + INTARRAYLEAFSIZE);
+    File::remove(intIndexName);
+  }
+  std::cout << "test passed" << std::endl;
+  deleteRelation();
+}
+void test9Helper()
+{
+	std::vector<RecordId> ridVec;
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+	PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Insert a bunch of tuples into the relation, cycling through 7 key values.
+  for(int i = 0; i < 20000; i++ )
+	{
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i % 7;
+    record1.d = (double)i;
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+		while(1)
+		{
+			try
+			{
+    		new_page.insertRecord(new_data);
+				break;
+			}
+			catch(const InsufficientSpaceException &e)
+			{
+				file1->writePage(new_page_number, new_page);
+  			new_page = file1->allocatePage(new_page_number);
+			}
+		}
+  }
+
+	file1->writePage(new_page_number, new_page);
+}
+
 void test6Helper()
 {
 	std::vector<RecordId> ridVec;
@@ -486,9 +2004,9 @@ void createRelationRandom()
 // indexTests
 // -----------------------------------------------------------------------------
 
-void indexTests()
+void indexTests(const IndexOptions &options)
 {
-  intTests();
+  intTests(options);
 	try
 	{
 		File::remove(intIndexName);
@@ -502,10 +2020,10 @@ void indexTests()
 // intTests
 // -----------------------------------------------------------------------------
 
-void intTests()
+void intTests(const IndexOptions &options)
 {
   std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
 
 	// run some tests
 	checkPassFail(intScan(&index,25,GT,40,LT), 14)
@@ -577,6 +2095,104 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
 	return numResults;
 }
 
+std::vector<RecordId> collectScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  std::vector<RecordId> rids;
+  RecordId scanRid;
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+		return rids;
+	}
+
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid);
+			rids.push_back(scanRid);
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+	}
+  index->endScan();
+	return rids;
+}
+
+int partitionedScan(PartitionedIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  RecordId scanRids[500];
+  int numResults = 0;
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			numResults += index->scanNextBatch(scanRids, 500);
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+	}
+  index->endScan();
+	return numResults;
+}
+
+int intScanBatch(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  RecordId scanRids[500];
+
+  std::cout << "Batch scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+  int numResults = 0;
+
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	while(1)
+	{
+		try
+		{
+			numResults += index->scanNextBatch(scanRids, 500);
+		}
+		catch(const IndexScanCompletedException &e)
+		{
+			break;
+		}
+	}
+
+  std::cout << "Number of results: " << numResults << std::endl;
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
+}
+
 // -----------------------------------------------------------------------------
 // errorTests
 // -----------------------------------------------------------------------------
@@ -691,6 +2307,18 @@ void errorTests()
 			std::cout << "BadScanrangeException Test 1 Passed." << std::endl;
 		}
 
+		std::cout << "Index on a DOUBLE attribute" << std::endl;
+		try
+		{
+			std::string doubleIndexName;
+			BTreeIndex doubleIndex(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+			std::cout << "BadIndexInfoException Test 1 Failed." << std::endl;
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			std::cout << "BadIndexInfoException Test 1 Passed." << std::endl;
+		}
+
 		deleteRelation();
 	}
 
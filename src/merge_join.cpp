@@ -0,0 +1,201 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "merge_join.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+
+namespace badgerdb
+{
+
+/**
+ * Sort rids into heap file order. The rids of an index on an attribute correlated with the
+ * insertion order of the relation are often sorted already.
+ */
+static void sortRids(std::vector<RecordId>& rids)
+{
+	if (!std::is_sorted(rids.begin(), rids.end(), ridLess))
+		std::sort(rids.begin(), rids.end(), ridLess);
+}
+
+/**
+ * First position from i on of a sorted run whose rid is not less than rid: doubles the step until
+ * it passes rid, then searches the last step.
+ */
+static std::size_t gallop(const std::vector<RecordId>& rids, std::size_t i, const RecordId& rid)
+{
+	std::size_t step = 1;
+	while (i + step < rids.size() && ridLess(rids[i + step], rid))
+		step *= 2;
+	return std::lower_bound(rids.begin() + i + step / 2, rids.begin() + std::min(i + step, rids.size()), rid, ridLess)
+			- rids.begin();
+}
+
+// -----------------------------------------------------------------------------
+// MergeJoin::MergeJoin -- Constructor
+// -----------------------------------------------------------------------------
+
+MergeJoin::MergeJoin(BTreeIndex& leftIndex, BTreeIndex& rightIndex, const ScanRange& range)
+	: left(&leftIndex), right(&rightIndex), leftValid(true), rightValid(true), groupPos(0)
+{
+	if (left == right)
+		throw BadIndexInfoException("merge join of an index with itself");
+
+	try {
+		left->startScan(&range.lowVal, range.lowOp, &range.highVal, range.highOp);
+	} catch (const NoSuchKeyFoundException &) {
+		leftValid = false;
+	}
+	try {
+		right->startScan(&range.lowVal, range.lowOp, &range.highVal, range.highOp);
+	} catch (const NoSuchKeyFoundException &) {
+		rightValid = false;
+	}
+	advance(left, leftValid, leftKey, leftRid);
+	advance(right, rightValid, rightKey, rightRid);
+}
+
+// -----------------------------------------------------------------------------
+// MergeJoin::~MergeJoin -- destructor
+// -----------------------------------------------------------------------------
+
+MergeJoin::~MergeJoin()
+{
+	// a side whose scan has completed keeps it open until endScan()
+	try {
+		left->endScan();
+	} catch (...) {
+	}
+	try {
+		right->endScan();
+	} catch (...) {
+	}
+}
+
+void MergeJoin::advance(BTreeIndex* side, bool& valid, int& key, RecordId& rid)
+{
+	if (!valid)
+		return;
+	try {
+		side->scanNextEntry(key, rid);
+	} catch (const IndexScanCompletedException &) {
+		valid = false;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// MergeJoin::next
+// -----------------------------------------------------------------------------
+
+bool MergeJoin::next(RecordId& outLeftRid, RecordId& outRightRid)
+{
+	if (groupPos == rightGroup.size()) {
+		// the current left entry has been paired with the whole group: go on with the next one
+		if (!rightGroup.empty())
+			advance(left, leftValid, leftKey, leftRid);
+		if (!leftValid || rightGroup.empty() || leftKey != groupKey) {
+			if (!findMatch())
+				return false;
+		}
+		groupPos = 0;
+	}
+	outLeftRid = leftRid;
+	outRightRid = rightGroup[groupPos++];
+	return true;
+}
+
+bool MergeJoin::findMatch()
+{
+	rightGroup.clear();
+	groupPos = 0;
+	while (leftValid && rightValid && leftKey != rightKey) {
+		if (leftKey < rightKey) {
+			left->scanSkipTo(rightKey);
+			advance(left, leftValid, leftKey, leftRid);
+		} else {
+			right->scanSkipTo(leftKey);
+			advance(right, rightValid, rightKey, rightRid);
+		}
+	}
+	if (!leftValid || !rightValid)
+		return false;
+
+	groupKey = rightKey;
+	while (rightValid && rightKey == groupKey) {
+		rightGroup.push_back(rightRid);
+		advance(right, rightValid, rightKey, rightRid);
+	}
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// scanRangeRids
+// -----------------------------------------------------------------------------
+
+void scanRangeRids(BTreeIndex& index, const ScanRange& range, std::vector<RecordId>& outRids)
+{
+	outRids.clear();
+	try {
+		index.startScan(&range.lowVal, range.lowOp, &range.highVal, range.highOp);
+	} catch (const NoSuchKeyFoundException &) {
+		return;
+	}
+	RecordId batch[256];
+	try {
+		while (true) {
+			int n = index.scanNextBatch(batch, 256);
+			outRids.insert(outRids.end(), batch, batch + n);
+		}
+	} catch (const IndexScanCompletedException &) {
+	}
+	index.endScan();
+}
+
+// -----------------------------------------------------------------------------
+// intersectRids
+// -----------------------------------------------------------------------------
+
+void intersectRids(std::vector<RecordId> a, std::vector<RecordId> b, std::vector<RecordId>& outRids)
+{
+	outRids.clear();
+	sortRids(a);
+	sortRids(b);
+	std::size_t i = 0, j = 0;
+	while (i < a.size() && j < b.size()) {
+		if (ridLess(a[i], b[j])) {
+			i = gallop(a, i, b[j]);
+		} else if (ridLess(b[j], a[i])) {
+			j = gallop(b, j, a[i]);
+		} else {
+			if (outRids.empty() || outRids.back() != a[i])
+				outRids.push_back(a[i]);
+			i++;
+			j++;
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// unionRids
+// -----------------------------------------------------------------------------
+
+void unionRids(std::vector<RecordId> a, std::vector<RecordId> b, std::vector<RecordId>& outRids)
+{
+	outRids.clear();
+	sortRids(a);
+	sortRids(b);
+	outRids.reserve(a.size() + b.size());
+	std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(outRids), ridLess);
+	outRids.erase(std::unique(outRids.begin(), outRids.end()), outRids.end());
+}
+
+}
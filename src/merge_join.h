@@ -0,0 +1,102 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "btree.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Equi-join of two integer indexes on their keys, streamed from one scan of each in key
+ * order. When the keys of the two sides diverge the side that is behind skips ahead to the other
+ * side's key with BTreeIndex::scanSkipTo(), which gallops within the current leaf and descends the
+ * tree for a key past it, so the leaves between matches are not read.
+ *
+ * The join holds the scans of both indexes until it is destroyed; the two sides must be different
+ * BTreeIndex objects.
+ */
+class MergeJoin {
+ public:
+  /**
+   * @brief Start a scan of each index over range.
+   *
+   * @throws  BadOpcodesException If the operators of range do not contain one of their expected values
+   * @throws  BadScanrangeException If range.lowVal > range.highVal
+   * @throws  BadIndexInfoException If left and right are the same index
+   */
+  MergeJoin(BTreeIndex& left, BTreeIndex& right, const ScanRange& range);
+
+  /**
+   * @brief Ends the scans. Destructor should not throw any exceptions.
+   */
+  ~MergeJoin();
+
+  /**
+   * @brief Fetch the next pair of record ids whose entries have equal keys: the cross product of
+   * the entries of each key, in key order.
+   *
+   * @param leftRid	Set to the record id of the entry of the left index
+   * @param rightRid	Set to the record id of the entry of the right index
+   * @return False, with the rids unchanged, once all pairs have been returned
+   */
+  bool next(RecordId& leftRid, RecordId& rightRid);
+
+ private:
+  /**
+   * Move side to its next entry, clearing its valid flag once its scan has completed.
+   */
+  static void advance(BTreeIndex* side, bool& valid, int& key, RecordId& rid);
+
+  /**
+   * Skip both sides ahead to their next common key and collect the right entries of that key
+   * into rightGroup. Returns false if the sides have no more common key.
+   */
+  bool findMatch();
+
+  BTreeIndex* left;
+  BTreeIndex* right;
+
+  /**
+   * Current entry of each side; false valid flags once its scan has completed.
+   */
+  bool leftValid;
+  int leftKey;
+  RecordId leftRid;
+  bool rightValid;
+  int rightKey;
+  RecordId rightRid;
+
+  /**
+   * Right entries of the key being joined, and the next one to pair with the current left entry.
+   */
+  int groupKey;
+  std::vector<RecordId> rightGroup;
+  std::size_t groupPos;
+};
+
+/**
+ * @brief Record ids of all entries of index in range, in key order. Empty if no key is in range.
+ */
+void scanRangeRids(BTreeIndex& index, const ScanRange& range, std::vector<RecordId>& outRids);
+
+/**
+ * @brief Record ids in both a and b, each once, ordered by page and slot. The inputs are rid sets
+ * of the same relation, such as those of scanRangeRids() over two of its indexes; each is sorted
+ * once and the shorter runs are galloped over.
+ */
+void intersectRids(std::vector<RecordId> a, std::vector<RecordId> b, std::vector<RecordId>& outRids);
+
+/**
+ * @brief Record ids in a or b, each once, ordered by page and slot.
+ */
+void unionRids(std::vector<RecordId> a, std::vector<RecordId> b, std::vector<RecordId>& outRids);
+
+}
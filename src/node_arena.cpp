@@ -0,0 +1,105 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "node_arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <sys/mman.h>
+
+namespace badgerdb
+{
+
+// -----------------------------------------------------------------------------
+// NodeArena::NodeArena -- Constructor
+// -----------------------------------------------------------------------------
+
+NodeArena::NodeArena()
+	: chunks(new std::atomic<char*>[ARENAMAXCHUNKS]()), mappedChunks(0), hugeTlbChunks(0), nextPageNo(1)
+{
+}
+
+// -----------------------------------------------------------------------------
+// NodeArena::~NodeArena -- destructor
+// -----------------------------------------------------------------------------
+
+NodeArena::~NodeArena()
+{
+	for (int c = 0; c < mappedChunks; c++) {
+		char* chunk = chunks[c].load(std::memory_order_relaxed);
+		if (chunkHugeTlb[c])
+			munmap(chunk, ARENACHUNKBYTES);
+		else
+			std::free(chunk);
+	}
+	delete[] chunks;
+}
+
+void NodeArena::mapChunk()
+{
+	if (mappedChunks == ARENAMAXCHUNKS)
+		throw std::bad_alloc();
+	bool hugeTlb = true;
+	void* chunk = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+	chunk = mmap(nullptr, ARENACHUNKBYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+	if (chunk == MAP_FAILED) {
+		// no huge pages reserved: aligned memory the kernel may back with a transparent huge page
+		hugeTlb = false;
+		if (posix_memalign(&chunk, ARENACHUNKBYTES, ARENACHUNKBYTES) != 0)
+			throw std::bad_alloc();
+#if defined(MADV_HUGEPAGE)
+		madvise(chunk, ARENACHUNKBYTES, MADV_HUGEPAGE);
+#endif
+	}
+	chunkHugeTlb.push_back(hugeTlb);
+	hugeTlbChunks += hugeTlb;
+	chunks[mappedChunks].store(static_cast<char*>(chunk), std::memory_order_release);
+	mappedChunks++;
+}
+
+// -----------------------------------------------------------------------------
+// NodeArena::allocate
+// -----------------------------------------------------------------------------
+
+void NodeArena::allocate(PageId& pageNo, Page*& page)
+{
+	if (!freePages.empty()) {
+		pageNo = freePages.back();
+		freePages.pop_back();
+	} else {
+		if ((nextPageNo - 1) / PAGESPERCHUNK == (std::size_t) mappedChunks)
+			mapChunk();
+		pageNo = nextPageNo++;
+	}
+	page = new (this->page(pageNo)) Page();
+}
+
+// -----------------------------------------------------------------------------
+// NodeArena::release
+// -----------------------------------------------------------------------------
+
+void NodeArena::release(PageId pageNo)
+{
+	// kept sorted high to low, so that pages are reused in ascending order
+	freePages.insert(std::upper_bound(freePages.begin(), freePages.end(), pageNo, std::greater<PageId>()), pageNo);
+}
+
+// -----------------------------------------------------------------------------
+// NodeArena::reset
+// -----------------------------------------------------------------------------
+
+void NodeArena::reset()
+{
+	freePages.clear();
+	nextPageNo = 1;
+}
+
+}
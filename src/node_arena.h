@@ -0,0 +1,112 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "types.h"
+#include "page.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Bytes of one chunk of a NodeArena: one huge page.
+ */
+const std::size_t ARENACHUNKBYTES = 2 << 20;
+
+/**
+ * @brief Most chunks a NodeArena maps, 128 GB of nodes.
+ */
+const int ARENAMAXCHUNKS = 65536;
+
+/**
+ * @brief Memory for the nodes of an in-memory BTreeIndex, in place of buffer pool frames. Pages
+ * are numbered from 1 as in a BlobFile and handed out by bumping a counter through 2 MB chunks,
+ * after reusing any page released to the free list. A chunk is a huge page where the kernel
+ * has some reserved (MAP_HUGETLB), and otherwise 2 MB aligned memory advised for transparent
+ * huge pages, so that the whole tree takes few TLB entries.
+ *
+ * Pages never move: page() may be called from any thread concurrently with allocate(), which
+ * publishes each new chunk before handing out its pages. allocate() and release() are not
+ * thread-safe among themselves.
+ */
+class NodeArena {
+ public:
+  NodeArena();
+
+  /**
+   * @brief Unmaps every chunk.
+   */
+  ~NodeArena();
+
+  /**
+   * @brief A zeroed page: the lowest released page if there is one, else the next unused one.
+   *
+   * @param pageNo	Set to the number of the page
+   * @param page		Set to the page
+   * @throws std::bad_alloc If the arena has ARENAMAXCHUNKS chunks or no memory is left
+   */
+  void allocate(PageId& pageNo, Page*& page);
+
+  /**
+   * @brief Put page pageNo on the free list, for allocate() to hand out again.
+   */
+  void release(PageId pageNo);
+
+  /**
+   * @brief Forget every page, keeping the chunks for the pages allocated next.
+   */
+  void reset();
+
+  /**
+   * @brief Page pageNo, which allocate() has handed out.
+   */
+  Page* page(PageId pageNo) const
+  {
+	std::size_t i = pageNo - 1;
+	return reinterpret_cast<Page*>(chunks[i / PAGESPERCHUNK].load(std::memory_order_acquire) + i % PAGESPERCHUNK * sizeof(Page));
+  }
+
+  /**
+   * @brief Pages handed out so far, released ones included: pages 1 to numPages() are valid.
+   */
+  PageId numPages() const { return nextPageNo - 1; }
+
+  /**
+   * @brief Chunks mapped, and those of them that are huge pages of MAP_HUGETLB.
+   */
+  int numChunks() const { return mappedChunks; }
+  int numHugeTlbChunks() const { return hugeTlbChunks; }
+
+ private:
+  static const std::size_t PAGESPERCHUNK = ARENACHUNKBYTES / sizeof(Page);
+
+  /**
+   * Map chunk number mappedChunks.
+   */
+  void mapChunk();
+
+  /**
+   * Start of each chunk, null past mappedChunks, and whether it came from MAP_HUGETLB.
+   */
+  std::atomic<char*>* chunks;
+  std::vector<bool> chunkHugeTlb;
+  int mappedChunks;
+  int hugeTlbChunks;
+
+  /**
+   * Next page never handed out, and released pages with the lowest number last.
+   */
+  PageId nextPageNo;
+  std::vector<PageId> freePages;
+};
+
+}
@@ -0,0 +1,264 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "partitioned_index.h"
+
+#include <exception>
+#include <thread>
+
+#include "filescan.h"
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/bad_opcodes_exception.h"
+#include "exceptions/bad_scanrange_exception.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+#include "exceptions/scan_not_initialized_exception.h"
+
+namespace badgerdb
+{
+
+// -----------------------------------------------------------------------------
+// PartitionedIndex::PartitionedIndex -- Constructor
+// -----------------------------------------------------------------------------
+
+PartitionedIndex::PartitionedIndex(const std::string& relationName, std::vector<std::string>& outIndexNames,
+		const std::vector<BufMgr*>& bufMgrsIn, const int attrByteOffset, const Datatype attrType,
+		const std::vector<int>& splitKeysIn, const IndexOptions& options)
+	: splitKeys(splitKeysIn), bufMgrs(bufMgrsIn), scanExecuting(false)
+{
+	int numParts = splitKeys.size() + 1;
+	if (!std::is_sorted(splitKeys.begin(), splitKeys.end())
+			|| std::adjacent_find(splitKeys.begin(), splitKeys.end()) != splitKeys.end()
+			|| (bufMgrs.size() != 1 && (int) bufMgrs.size() != numParts))
+		throw BadIndexInfoException(relationName);
+
+	// open the partitions one after the other: opening files is not safe across threads
+	outIndexNames.assign(numParts, std::string());
+	std::vector<bool> empty(numParts);
+	try {
+		for (int i = 0; i < numParts; i++) {
+			IndexOptions partOptions = options;
+			partOptions.partition = i;
+			partOptions.lowKey = i == 0 ? INT32_MIN : splitKeys[i-1];
+			partOptions.highKey = i == numParts - 1 ? INT32_MAX : splitKeys[i] - 1;
+			partOptions.buildFromRelation = false;
+			partitions.push_back(new BTreeIndex(relationName, outIndexNames[i], bufMgrs[bufMgrs.size() == 1 ? 0 : i],
+				attrByteOffset, attrType, partOptions));
+			empty[i] = partitions[i]->statsSummary().numEntries == 0;
+		}
+	} catch (...) {
+		for (BTreeIndex* part : partitions) delete part;
+		throw;
+	}
+	if (std::find(empty.begin(), empty.end(), true) == empty.end())
+		return;
+
+	// scan the relation once, sorting its entries by partition
+	std::vector<std::vector<std::pair<int, RecordId>>> entries(numParts);
+	{
+		FileScan fscan(relationName, bufMgrs[0]);
+		try {
+			RecordId scanRid;
+			while (true) {
+				fscan.scanNext(scanRid);
+				std::string recordStr = fscan.getRecord();
+				int key = *(const int*) (recordStr.c_str() + attrByteOffset);
+				int part = partitionOf(key);
+				if (empty[part]) entries[part].push_back(std::make_pair(key, scanRid));
+			}
+		} catch (const EndOfFileException &) {
+		}
+	}
+
+	forEachPartition([&](int i) {
+		if (!empty[i]) return;
+		for (const std::pair<int, RecordId>& entry : entries[i])
+			partitions[i]->insertEntryInt(entry.first, entry.second);
+		partitions[i]->checkpoint();
+	});
+}
+
+// -----------------------------------------------------------------------------
+// PartitionedIndex::~PartitionedIndex -- destructor
+// -----------------------------------------------------------------------------
+
+PartitionedIndex::~PartitionedIndex()
+{
+	for (BTreeIndex* part : partitions) delete part;
+}
+
+// -----------------------------------------------------------------------------
+// PartitionedIndex::forEachPartition
+// -----------------------------------------------------------------------------
+
+template <class Work>
+void PartitionedIndex::forEachPartition(Work work)
+{
+	if (bufMgrs.size() == 1) {
+		for (int i = 0; i < numPartitions(); i++) work(i);
+		return;
+	}
+
+	std::vector<std::exception_ptr> errors(numPartitions());
+	std::vector<std::thread> threads;
+	for (int i = 0; i < numPartitions(); i++) {
+		threads.push_back(std::thread([&, i]() {
+			try {
+				work(i);
+			} catch (...) {
+				errors[i] = std::current_exception();
+			}
+		}));
+	}
+	for (std::thread& thread : threads) thread.join();
+	for (std::exception_ptr& error : errors)
+		if (error) std::rethrow_exception(error);
+}
+
+// -----------------------------------------------------------------------------
+// PartitionedIndex::partitionOf
+// -----------------------------------------------------------------------------
+
+int PartitionedIndex::partitionOf(int key) const
+{
+	return std::upper_bound(splitKeys.begin(), splitKeys.end(), key) - splitKeys.begin();
+}
+
+// -----------------------------------------------------------------------------
+// PartitionedIndex::insertEntry
+// -----------------------------------------------------------------------------
+
+void PartitionedIndex::insertEntry(const void* key, const RecordId rid)
+{
+	int keyInt = *((int*) key);
+	partitions[partitionOf(keyInt)]->insertEntryInt(keyInt, rid);
+}
+
+// -----------------------------------------------------------------------------
+// PartitionedIndex::lookupBatch
+// -----------------------------------------------------------------------------
+
+void PartitionedIndex::lookupBatch(const std::vector<int>& keys, std::vector<std::vector<RecordId>>& results)
+{
+	results.assign(keys.size(), std::vector<RecordId>());
+	std::vector<std::vector<int>> partKeys(numPartitions());
+	std::vector<std::vector<std::size_t>> partLookups(numPartitions());
+	for (std::size_t k = 0; k < keys.size(); k++) {
+		int part = partitionOf(keys[k]);
+		partKeys[part].push_back(keys[k]);
+		partLookups[part].push_back(k);
+	}
+
+	std::vector<std::vector<RecordId>> partResults;
+	for (int i = 0; i < numPartitions(); i++) {
+		if (partKeys[i].empty()) continue;
+		partitions[i]->probeInterleaved(partKeys[i], partResults);
+		for (std::size_t j = 0; j < partLookups[i].size(); j++)
+			results[partLookups[i][j]].swap(partResults[j]);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// PartitionedIndex::startScan
+// -----------------------------------------------------------------------------
+
+void PartitionedIndex::startScan(const void* lowValParm, const Operator lowOpParm,
+		const void* highValParm, const Operator highOpParm)
+{
+	if ((lowOpParm != GT && lowOpParm != GTE) || (highOpParm != LT && highOpParm != LTE))
+		throw BadOpcodesException();
+	if (*((int*) lowValParm) > *((int*) highValParm))
+		throw BadScanrangeException();
+
+	if (scanExecuting)
+		endScan();
+	lowValInt = *((int*) lowValParm);
+	highValInt = *((int*) highValParm);
+	lowOp = lowOpParm;
+	highOp = highOpParm;
+	scanPartition = partitionOf(lowValInt);
+	lastScanPartition = partitionOf(highValInt);
+
+	if (!startPartitionScan())
+		throw NoSuchKeyFoundException();
+	scanExecuting = true;
+}
+
+bool PartitionedIndex::startPartitionScan()
+{
+	for (; scanPartition <= lastScanPartition; scanPartition++) {
+		try {
+			partitions[scanPartition]->startScan(&lowValInt, lowOp, &highValInt, highOp);
+			return true;
+		} catch (const NoSuchKeyFoundException &) {
+		}
+	}
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+// PartitionedIndex::scanNext
+// -----------------------------------------------------------------------------
+
+void PartitionedIndex::scanNext(RecordId& outRid)
+{
+	scanNextBatch(&outRid, 1);
+}
+
+int PartitionedIndex::scanNextBatch(RecordId* outRids, int maxRids)
+{
+	if (!scanExecuting)
+		throw ScanNotInitializedException();
+
+	while (scanPartition <= lastScanPartition) {
+		try {
+			return partitions[scanPartition]->scanNextBatch(outRids, maxRids);
+		} catch (const IndexScanCompletedException &) {
+			// go on in the next partition
+			partitions[scanPartition]->endScan();
+			scanPartition++;
+			startPartitionScan();
+		}
+	}
+	throw IndexScanCompletedException();
+}
+
+// -----------------------------------------------------------------------------
+// PartitionedIndex::endScan
+// -----------------------------------------------------------------------------
+
+void PartitionedIndex::endScan()
+{
+	if (!scanExecuting)
+		throw ScanNotInitializedException();
+	if (scanPartition <= lastScanPartition)
+		partitions[scanPartition]->endScan();
+	scanExecuting = false;
+}
+
+// -----------------------------------------------------------------------------
+// PartitionedIndex::checkpoint
+// -----------------------------------------------------------------------------
+
+void PartitionedIndex::checkpoint()
+{
+	forEachPartition([this](int i) { partitions[i]->checkpoint(); });
+}
+
+// -----------------------------------------------------------------------------
+// PartitionedIndex::compact
+// -----------------------------------------------------------------------------
+
+void PartitionedIndex::compact(int fillPercent)
+{
+	if (scanExecuting)
+		endScan();
+	for (BTreeIndex* part : partitions) part->compact(fillPercent);
+}
+
+}
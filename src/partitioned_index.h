@@ -0,0 +1,181 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "btree.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief An index on a single integer attribute of a relation split by key range into several
+ * BTreeIndex partitions, each with its own file and root. The routing table is the sorted list of
+ * split keys: partition i holds the keys in [splitKeys[i-1], splitKeys[i]), the first and last
+ * partitions are open at their outer ends.
+ *
+ * Inserts and point lookups go to the one partition that holds their key, and range scans visit
+ * the partitions overlapping the range in key order. Given one buffer manager per partition the
+ * partitions are built and checkpointed in parallel, one thread each. Like BTreeIndex this index
+ * supports only one scan at a time.
+ */
+class PartitionedIndex {
+ public:
+  /**
+   * @brief Open the partitions of the index, creating the missing ones, and insert an entry for
+   * every record of the relation into each partition that was created empty. The relation is
+   * scanned once for all partitions.
+   *
+   * @param relationName	Name of the relation file
+   * @param outIndexNames	Set to the names of the partition index files
+   * @param bufMgrs			One buffer manager for all partitions, or one per partition to build in parallel
+   * @param attrByteOffset	Offset of attribute, over which index is to be built, in the record
+   * @param attrType			Datatype of attribute over which index is built
+   * @param splitKeys		Sorted first keys of the partitions after the first; K - 1 keys for K partitions
+   * @param options			Format options of the partitions
+   * @throws BadIndexInfoException If splitKeys is not sorted, bufMgrs has neither one nor
+   * splitKeys.size() + 1 entries, or a partition file was built with other split keys
+   */
+  PartitionedIndex(const std::string& relationName, std::vector<std::string>& outIndexNames,
+                   const std::vector<BufMgr*>& bufMgrs, const int attrByteOffset, const Datatype attrType,
+                   const std::vector<int>& splitKeys, const IndexOptions& options = IndexOptions());
+
+  /**
+   * @brief Ends any scan and closes the partitions. Destructor should not throw any exceptions.
+   */
+  ~PartitionedIndex();
+
+  /**
+   * @brief Number of partitions.
+   */
+  int numPartitions() const { return partitions.size(); }
+
+  /**
+   * @brief Partition that holds key.
+   */
+  int partitionOf(int key) const;
+
+  /**
+   * @brief Partition i, for per-partition statistics, counters and maintenance.
+   */
+  BTreeIndex& partition(int i) { return *partitions[i]; }
+
+  /**
+   * @brief Insert the entry <key, rid> into the partition that holds key.
+   *
+   * @param key		Key to insert, pointer to integer
+   * @param rid		Record ID of a record whose entry is getting inserted into the index
+   */
+  void insertEntry(const void* key, const RecordId rid);
+
+  /**
+   * @brief Look up keys, each in its own partition with BTreeIndex::probeInterleaved().
+   *
+   * @param keys		Keys to look up
+   * @param results	Set to one vector per key holding the record ids of its entries, empty for a missing key
+   */
+  void lookupBatch(const std::vector<int>& keys, std::vector<std::vector<RecordId>>& results);
+
+  /**
+   * @brief Begin a filtered scan of the index, as BTreeIndex::startScan(). The scan returns the
+   * entries of the partitions overlapping the range one partition after the other, so in key order.
+   *
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+   * @throws  NoSuchKeyFoundException If there is no key in the index that satisfies the scan criteria.
+   */
+  void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+  /**
+   * @brief Fetch the record id of the next index entry that matches the scan.
+   *
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+   */
+  void scanNext(RecordId& outRid);
+
+  /**
+   * @brief Fetch the record ids of up to maxRids next index entries that match the scan, as
+   * BTreeIndex::scanNextBatch(). A batch never spans two partitions.
+   *
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+   */
+  int scanNextBatch(RecordId* outRids, int maxRids);
+
+  /**
+   * @brief Terminate the current scan.
+   *
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   */
+  void endScan();
+
+  /**
+   * @brief BTreeIndex::checkpoint() every partition, in parallel if each has its own buffer manager.
+   *
+   * @throws PagePinnedException If a scan is executing
+   */
+  void checkpoint();
+
+  /**
+   * @brief End any scan and BTreeIndex::compact() every partition, one after the other: opening
+   * files is not safe across threads.
+   *
+   * @param fillPercent	Fill of the rewritten nodes, 50 to 100
+   */
+  void compact(int fillPercent = 100);
+
+ private:
+  /**
+   * Run work(i) for every partition i: on one thread per partition if each partition has its own
+   * buffer manager, else one partition after the other. Rethrows the first exception of any run.
+   */
+  template <class Work>
+  void forEachPartition(Work work);
+
+  /**
+   * Routing table, see the class comment.
+   */
+  std::vector<int> splitKeys;
+
+  /**
+   * The partitions in key order, and the buffer managers they use.
+   */
+  std::vector<BTreeIndex*> partitions;
+  std::vector<BufMgr*> bufMgrs;
+
+  /**
+   * True if a scan has been started and not ended.
+   */
+  bool scanExecuting;
+
+  /**
+   * Partition being scanned, and the last partition overlapping the range of the scan.
+   * scanPartition is past lastScanPartition once the scan has completed.
+   */
+  int scanPartition;
+  int lastScanPartition;
+
+  /**
+   * Range of the current scan.
+   */
+  int lowValInt;
+  int highValInt;
+  Operator lowOp;
+  Operator highOp;
+
+  /**
+   * Start the scan on the first partition from scanPartition on that has a key in range. Returns
+   * false, with scanPartition past lastScanPartition, if none has.
+   */
+  bool startPartitionScan();
+};
+
+}
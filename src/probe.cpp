@@ -0,0 +1,206 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "btree.h"
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#include <exception>
+#endif
+
+namespace badgerdb
+{
+
+#if defined(__cpp_impl_coroutine)
+
+/**
+ * @brief Handle of a lookup coroutine. The lookup starts suspended and runs up to its next page
+ * fetch every time it is resumed.
+ */
+struct ProbeTask
+{
+	struct promise_type
+	{
+		std::exception_ptr exception;
+
+		ProbeTask get_return_object() { return ProbeTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { exception = std::current_exception(); }
+	};
+
+	explicit ProbeTask(std::coroutine_handle<promise_type> h) : handle(h) {}
+	ProbeTask(ProbeTask&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+	ProbeTask& operator=(ProbeTask&& other) noexcept
+	{
+		if (handle) handle.destroy();
+		handle = other.handle;
+		other.handle = nullptr;
+		return *this;
+	}
+	ProbeTask(const ProbeTask&) = delete;
+	~ProbeTask() { if (handle) handle.destroy(); }
+
+	/**
+	 * Run the lookup to its next page fetch, rethrowing what it threw. Returns false once it has completed.
+	 */
+	bool resume()
+	{
+		handle.resume();
+		if (handle.promise().exception) std::rethrow_exception(handle.promise().exception);
+		return !handle.done();
+	}
+
+	bool done() const { return handle.done(); }
+
+	std::coroutine_handle<promise_type> handle;
+};
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::probe
+// -----------------------------------------------------------------------------
+
+ProbeTask BTreeIndex::probe(int key, std::vector<RecordId>& rids, ProbeSource source, Page* buffer)
+{
+	// the pin held across a suspension, dropped with the frame if advanceLookup() throws or the
+	// scheduler destroys the lookup before it completes
+	struct PagePin {
+		BTreeIndex* index;
+		PageId pageNo;
+		~PagePin() { if (pageNo != Page::INVALID_NUMBER) index->unpinPage(pageNo, false); }
+	} pin = { this, Page::INVALID_NUMBER };
+	PageId pageNo = rootPageNum;
+	LookupStage stage = LOOKUP_NONLEAF;
+	while (pageNo != Page::INVALID_NUMBER) {
+		Page* page = buffer;
+		if (source == PROBE_FILE) {
+			// the scheduler waits for the reads of all lookups before resuming any of them
+			asyncReader->submit(pageNo, buffer);
+			BTREE_COUNT(asyncReads, 1);
+		} else {
+			readPage(pageNo, page);
+			pin.pageNo = pageNo;
+			prefetchNode(page, stage);
+		}
+		co_await std::suspend_always();
+
+		PageId nextPageNo = advanceLookup(key, page, stage, rids);
+		if (pin.pageNo != Page::INVALID_NUMBER) {
+			unpinPage(pin.pageNo, false);
+			pin.pageNo = Page::INVALID_NUMBER;
+		}
+		pageNo = nextPageNo;
+	}
+}
+
+#endif
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::prefetchNode
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::prefetchNode(const Page* page, LookupStage stage) const
+{
+	const char* bytes = reinterpret_cast<const char*>(page);
+	// the first lines of the node and those its search probes first
+	__builtin_prefetch(bytes);
+	if (stage == LOOKUP_NONLEAF) {
+		const NonLeafNodeInt* node = reinterpret_cast<const NonLeafNodeInt*>(page);
+		if (nonLeafFormat == NONLEAF_SUMMARY) {
+			const int* summary = node->keyArray + nodeOccupancy;
+			for (int b = 0; b < (nodeOccupancy + SUMMARYSTRIDE - 1) / SUMMARYSTRIDE; b += 64 / sizeof(int))
+				__builtin_prefetch(summary + b);
+		} else {
+			__builtin_prefetch(node->keyArray + nodeOccupancy / 4);
+			__builtin_prefetch(node->keyArray + nodeOccupancy / 2);
+			__builtin_prefetch(node->keyArray + nodeOccupancy * 3 / 4);
+		}
+	} else if (stage == LOOKUP_LEAF && leafFormat == LEAF_PLAIN) {
+		const LeafNodeInt* node = reinterpret_cast<const LeafNodeInt*>(page);
+		__builtin_prefetch(node->keyArray + INTARRAYLEAFSIZE / 4);
+		__builtin_prefetch(node->keyArray + INTARRAYLEAFSIZE / 2);
+		__builtin_prefetch(node->keyArray + INTARRAYLEAFSIZE * 3 / 4);
+	} else {
+		// compressed and postings leaves, and overflow pages, are read from the start
+		for (int offset = 64; offset < 512; offset += 64)
+			__builtin_prefetch(bytes + offset);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::probeInterleaved
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::probeInterleaved(const std::vector<int>& keys, std::vector<std::vector<RecordId>>& results,
+		ProbeSource source, int groupSize)
+{
+	results.assign(keys.size(), std::vector<RecordId>());
+	// the nodes of an in-memory index are as near as the buffer pool ones
+	if (arena != nullptr) source = PROBE_BUFFER_POOL;
+	if (source == PROBE_FILE) prepareAsync();
+	groupSize = std::min(groupSize, ASYNCQUEUEDEPTH);
+	if (source == PROBE_BUFFER_POOL && poolFrames > 0) {
+		// every lookup of the group holds a pin, and under optimisticReads the node table another
+		groupSize = std::min(groupSize, poolFrames / 2 / (optimisticReads ? 2 : 1));
+	}
+	groupSize = std::max(1, groupSize);
+	BTREE_COUNT(descents, keys.size());
+
+#if defined(__cpp_impl_coroutine)
+	// lookup in slot i reads into asyncPages[i] for PROBE_FILE
+	std::vector<ProbeTask> group;
+	std::size_t nextKey = 0;
+	for (int slot = 0; slot < groupSize && nextKey < keys.size(); slot++, nextKey++) {
+		group.push_back(probe(keys[nextKey], results[nextKey], source, source == PROBE_FILE ? &asyncPages[slot] : nullptr));
+		group.back().resume();
+	}
+
+	std::size_t active = group.size();
+	while (active > 0) {
+		if (source == PROBE_FILE) asyncReader->wait();
+		for (std::size_t slot = 0; slot < group.size(); slot++) {
+			if (group[slot].done() || group[slot].resume()) continue;
+			// the lookup is complete, start the next one in its slot
+			if (nextKey == keys.size()) {
+				active--;
+				continue;
+			}
+			group[slot] = probe(keys[nextKey], results[nextKey], source, source == PROBE_FILE ? &asyncPages[slot] : nullptr);
+			nextKey++;
+			group[slot].resume();
+		}
+	}
+#else
+	for (std::size_t i = 0; i < keys.size(); i++) {
+		PageId pageNo = rootPageNum;
+		LookupStage stage = LOOKUP_NONLEAF;
+		while (pageNo != Page::INVALID_NUMBER) {
+			Page* page;
+			if (source == PROBE_FILE) {
+				readPagesAsync(std::vector<PageId>(1, pageNo), 0, 1);
+				page = &asyncPages[0];
+			} else {
+				readPage(pageNo, page);
+			}
+			PageId nextPageNo;
+			try {
+				nextPageNo = advanceLookup(keys[i], page, stage, results[i]);
+			} catch (...) {
+				if (source == PROBE_BUFFER_POOL) unpinPage(pageNo, false);
+				throw;
+			}
+			if (source == PROBE_BUFFER_POOL) unpinPage(pageNo, false);
+			pageNo = nextPageNo;
+		}
+	}
+#endif
+	for (std::size_t i = 0; i < keys.size(); i++)
+		deltaLookup(keys[i], results[i]);
+}
+
+}
@@ -0,0 +1,303 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "rid_bitmap.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/no_such_key_found_exception.h"
+
+namespace badgerdb
+{
+
+static bool testBit(const std::uint64_t* words, std::uint32_t numWords, SlotId slot)
+{
+	return (std::uint32_t) slot / 64 < numWords && (words[slot / 64] >> (slot % 64) & 1);
+}
+
+/**
+ * Append the slots of the set bits of words [begin, end) to slots.
+ */
+static void bitsToSlots(const std::uint64_t* begin, const std::uint64_t* end, std::vector<SlotId>& slots)
+{
+	for (const std::uint64_t* w = begin; w != end; w++)
+		for (std::uint64_t word = *w; word != 0; word &= word - 1)
+			slots.push_back((w - begin) * 64 + __builtin_ctzll(word));
+}
+
+// -----------------------------------------------------------------------------
+// RidBitmap::fromRids
+// -----------------------------------------------------------------------------
+
+RidBitmap RidBitmap::fromRids(std::vector<RecordId> rids)
+{
+	if (!std::is_sorted(rids.begin(), rids.end(), ridLess))
+		std::sort(rids.begin(), rids.end(), ridLess);
+	RidBitmap bitmap;
+	std::vector<SlotId> slots;
+	for (std::size_t i = 0; i < rids.size(); ) {
+		PageId page = rids[i].page_number;
+		slots.clear();
+		for (; i < rids.size() && rids[i].page_number == page; i++)
+			if (slots.empty() || slots.back() != rids[i].slot_number)
+				slots.push_back(rids[i].slot_number);
+		bitmap.appendSlots(page, slots.data(), slots.data() + slots.size());
+	}
+	return bitmap;
+}
+
+void RidBitmap::appendSlots(PageId page, const SlotId* begin, const SlotId* end)
+{
+	if (begin == end)
+		return;
+	Container c;
+	c.page = page;
+	c.cardinality = end - begin;
+	std::uint32_t words = end[-1] / 64 + 1;
+	c.bitset = c.cardinality * sizeof(SlotId) > words * sizeof(std::uint64_t);
+	if (c.bitset) {
+		c.offset = wordPool.size();
+		c.length = words;
+		wordPool.resize(wordPool.size() + words, 0);
+		std::uint64_t* bits = wordPool.data() + c.offset;
+		for (const SlotId* slot = begin; slot != end; slot++)
+			bits[*slot / 64] |= std::uint64_t(1) << (*slot % 64);
+	} else {
+		c.offset = slotPool.size();
+		c.length = c.cardinality;
+		slotPool.insert(slotPool.end(), begin, end);
+	}
+	containers.push_back(c);
+}
+
+void RidBitmap::appendWords(PageId page, const std::uint64_t* begin, const std::uint64_t* end)
+{
+	while (end != begin && end[-1] == 0)
+		end--;
+	std::uint32_t cardinality = 0;
+	for (const std::uint64_t* w = begin; w != end; w++)
+		cardinality += __builtin_popcountll(*w);
+	if (cardinality == 0)
+		return;
+	if (cardinality * sizeof(SlotId) <= (end - begin) * sizeof(std::uint64_t)) {
+		std::vector<SlotId> slots;
+		slots.reserve(cardinality);
+		bitsToSlots(begin, end, slots);
+		appendSlots(page, slots.data(), slots.data() + slots.size());
+		return;
+	}
+	Container c;
+	c.page = page;
+	c.cardinality = cardinality;
+	c.bitset = true;
+	c.offset = wordPool.size();
+	c.length = end - begin;
+	wordPool.insert(wordPool.end(), begin, end);
+	containers.push_back(c);
+}
+
+void RidBitmap::appendContainer(const RidBitmap& from, const Container& c)
+{
+	Container copy = c;
+	if (c.bitset) {
+		copy.offset = wordPool.size();
+		wordPool.insert(wordPool.end(), from.wordsOf(c), from.wordsOf(c) + c.length);
+	} else {
+		copy.offset = slotPool.size();
+		slotPool.insert(slotPool.end(), from.slotsOf(c), from.slotsOf(c) + c.length);
+	}
+	containers.push_back(copy);
+}
+
+std::size_t RidBitmap::cardinality() const
+{
+	std::size_t n = 0;
+	for (const Container& c : containers)
+		n += c.cardinality;
+	return n;
+}
+
+bool RidBitmap::contains(const RecordId& rid) const
+{
+	std::vector<Container>::const_iterator c = std::lower_bound(containers.begin(), containers.end(), rid.page_number,
+			[](const Container& c, PageId page) { return c.page < page; });
+	if (c == containers.end() || c->page != rid.page_number)
+		return false;
+	if (c->bitset)
+		return testBit(wordsOf(*c), c->length, rid.slot_number);
+	return std::binary_search(slotsOf(*c), slotsOf(*c) + c->length, rid.slot_number);
+}
+
+void RidBitmap::pageSlots(std::size_t i, std::vector<SlotId>& outSlots) const
+{
+	const Container& c = containers[i];
+	outSlots.clear();
+	if (c.bitset)
+		bitsToSlots(wordsOf(c), wordsOf(c) + c.length, outSlots);
+	else
+		outSlots.assign(slotsOf(c), slotsOf(c) + c.length);
+}
+
+void RidBitmap::toRids(std::vector<RecordId>& outRids) const
+{
+	outRids.clear();
+	outRids.reserve(cardinality());
+	std::vector<SlotId> slots;
+	for (std::size_t i = 0; i < containers.size(); i++) {
+		pageSlots(i, slots);
+		RecordId rid;
+		rid.page_number = containers[i].page;
+		for (SlotId slot : slots) {
+			rid.slot_number = slot;
+			outRids.push_back(rid);
+		}
+	}
+}
+
+std::size_t RidBitmap::sizeInBytes() const
+{
+	return containers.size() * sizeof(Container) + slotPool.size() * sizeof(SlotId)
+		+ wordPool.size() * sizeof(std::uint64_t);
+}
+
+// -----------------------------------------------------------------------------
+// bitmapAnd
+// -----------------------------------------------------------------------------
+
+RidBitmap bitmapAnd(const RidBitmap& a, const RidBitmap& b)
+{
+	RidBitmap result;
+	std::vector<SlotId> slots;
+	std::vector<std::uint64_t> words;
+	std::size_t i = 0, j = 0;
+	while (i < a.containers.size() && j < b.containers.size()) {
+		const RidBitmap::Container& x = a.containers[i];
+		const RidBitmap::Container& y = b.containers[j];
+		if (x.page != y.page) {
+			x.page < y.page ? i++ : j++;
+			continue;
+		}
+		if (x.bitset && y.bitset) {
+			words.resize(std::min(x.length, y.length));
+			for (std::size_t w = 0; w < words.size(); w++)
+				words[w] = a.wordsOf(x)[w] & b.wordsOf(y)[w];
+			result.appendWords(x.page, words.data(), words.data() + words.size());
+		} else {
+			slots.clear();
+			if (!x.bitset && !y.bitset) {
+				std::set_intersection(a.slotsOf(x), a.slotsOf(x) + x.length, b.slotsOf(y), b.slotsOf(y) + y.length,
+						std::back_inserter(slots));
+			} else {
+				// an array filtered by a bitset stays the smaller array
+				const RidBitmap& arrayOwner = x.bitset ? b : a;
+				const RidBitmap::Container& array = x.bitset ? y : x;
+				const RidBitmap& bitsetOwner = x.bitset ? a : b;
+				const RidBitmap::Container& bitset = x.bitset ? x : y;
+				for (const SlotId* slot = arrayOwner.slotsOf(array); slot != arrayOwner.slotsOf(array) + array.length; slot++)
+					if (testBit(bitsetOwner.wordsOf(bitset), bitset.length, *slot))
+						slots.push_back(*slot);
+			}
+			result.appendSlots(x.page, slots.data(), slots.data() + slots.size());
+		}
+		i++;
+		j++;
+	}
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+// bitmapOr
+// -----------------------------------------------------------------------------
+
+RidBitmap bitmapOr(const RidBitmap& a, const RidBitmap& b)
+{
+	RidBitmap result;
+	result.containers.reserve(std::max(a.containers.size(), b.containers.size()));
+	std::vector<SlotId> slots;
+	std::vector<std::uint64_t> words;
+	std::size_t i = 0, j = 0;
+	while (i < a.containers.size() || j < b.containers.size()) {
+		if (j == b.containers.size() || (i < a.containers.size() && a.containers[i].page < b.containers[j].page)) {
+			result.appendContainer(a, a.containers[i++]);
+			continue;
+		}
+		if (i == a.containers.size() || b.containers[j].page < a.containers[i].page) {
+			result.appendContainer(b, b.containers[j++]);
+			continue;
+		}
+		const RidBitmap::Container& x = a.containers[i++];
+		const RidBitmap::Container& y = b.containers[j++];
+		if (!x.bitset && !y.bitset) {
+			slots.clear();
+			std::set_union(a.slotsOf(x), a.slotsOf(x) + x.length, b.slotsOf(y), b.slotsOf(y) + y.length,
+					std::back_inserter(slots));
+			result.appendSlots(x.page, slots.data(), slots.data() + slots.size());
+			continue;
+		}
+		// at least one side is a bitset: or both into a bitset
+		words.assign(std::max(x.bitset ? x.length : a.slotsOf(x)[x.length - 1] / 64 + 1,
+				y.bitset ? y.length : b.slotsOf(y)[y.length - 1] / 64 + 1), 0);
+		for (const RidBitmap* owner : { &a, &b }) {
+			const RidBitmap::Container& c = owner == &a ? x : y;
+			if (c.bitset) {
+				for (std::uint32_t w = 0; w < c.length; w++)
+					words[w] |= owner->wordsOf(c)[w];
+			} else {
+				for (const SlotId* slot = owner->slotsOf(c); slot != owner->slotsOf(c) + c.length; slot++)
+					words[*slot / 64] |= std::uint64_t(1) << (*slot % 64);
+			}
+		}
+		result.appendWords(x.page, words.data(), words.data() + words.size());
+	}
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+// scanBitmap
+// -----------------------------------------------------------------------------
+
+/**
+ * Rids of the rest of the scan running on index, then ends the scan.
+ */
+static void drainScan(BTreeIndex& index, std::vector<RecordId>& rids)
+{
+	RecordId batch[256];
+	try {
+		while (true) {
+			int n = index.scanNextBatch(batch, 256);
+			rids.insert(rids.end(), batch, batch + n);
+		}
+	} catch (const IndexScanCompletedException &) {
+	}
+	index.endScan();
+}
+
+void scanBitmap(BTreeIndex& index, const ScanRange& range, RidBitmap& outBitmap)
+{
+	std::vector<RecordId> rids;
+	try {
+		index.startScan(&range.lowVal, range.lowOp, &range.highVal, range.highOp);
+		drainScan(index, rids);
+	} catch (const NoSuchKeyFoundException &) {
+	}
+	outBitmap = RidBitmap::fromRids(std::move(rids));
+}
+
+void scanBitmap(BTreeIndex& index, const std::vector<ScanRange>& ranges, RidBitmap& outBitmap)
+{
+	std::vector<RecordId> rids;
+	try {
+		index.startMultiScan(ranges);
+		drainScan(index, rids);
+	} catch (const NoSuchKeyFoundException &) {
+	}
+	outBitmap = RidBitmap::fromRids(std::move(rids));
+}
+
+}
@@ -0,0 +1,133 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "btree.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Compressed set of record ids, laid out like a Roaring bitmap: one container per heap
+ * page, kept sorted by page number, holding the slots of the page either as a sorted array of
+ * slot numbers or as a bitset over slots 0 to the largest one, whichever is smaller. Sparse pages
+ * cost two bytes per rid and full pages about one bit per slot.
+ *
+ * The pages of the set are visited in page number order, so a heap fetch driven by a bitmap reads
+ * each page once and in physical order.
+ */
+class RidBitmap {
+ public:
+  /**
+   * @brief Set of the rids, in any order and with repeats. The rids are sorted once unless they
+   * are sorted already.
+   */
+  static RidBitmap fromRids(std::vector<RecordId> rids);
+
+  /**
+   * @brief Number of rids in the set.
+   */
+  std::size_t cardinality() const;
+
+  /**
+   * @brief True if rid is in the set.
+   */
+  bool contains(const RecordId& rid) const;
+
+  /**
+   * @brief Number of heap pages with a rid in the set.
+   */
+  std::size_t numPages() const { return containers.size(); }
+
+  /**
+   * @brief Page number of the i-th page of the set, in page number order.
+   */
+  PageId page(std::size_t i) const { return containers[i].page; }
+
+  /**
+   * @brief Slot numbers of the rids of the i-th page of the set, in ascending order.
+   */
+  void pageSlots(std::size_t i, std::vector<SlotId>& outSlots) const;
+
+  /**
+   * @brief All rids of the set, in heap file order.
+   */
+  void toRids(std::vector<RecordId>& outRids) const;
+
+  /**
+   * @brief Bytes used by the containers of the set.
+   */
+  std::size_t sizeInBytes() const;
+
+  /**
+   * @brief Rids in both a and b.
+   */
+  friend RidBitmap bitmapAnd(const RidBitmap& a, const RidBitmap& b);
+
+  /**
+   * @brief Rids in a or b.
+   */
+  friend RidBitmap bitmapOr(const RidBitmap& a, const RidBitmap& b);
+
+ private:
+  /**
+   * Slots of one page: slotPool[offset, offset + length) if bitset is false, else bit s of
+   * wordPool[offset, offset + length) for slot s. The pools keep a container at 20 bytes and no
+   * allocation of its own, as most pages of a sparse set hold one or two rids.
+   */
+  struct Container
+  {
+	PageId page;
+	std::uint32_t cardinality;
+	std::uint32_t offset;
+	std::uint32_t length;
+	bool bitset;
+  };
+
+  /**
+   * Append a container for page holding the sorted, distinct slots [begin, end), or the set bits
+   * of words [begin, end), in the smaller of the two forms. Nothing is appended for no slot.
+   */
+  void appendSlots(PageId page, const SlotId* begin, const SlotId* end);
+  void appendWords(PageId page, const std::uint64_t* begin, const std::uint64_t* end);
+
+  /**
+   * Append a copy of container c of from.
+   */
+  void appendContainer(const RidBitmap& from, const Container& c);
+
+  const SlotId* slotsOf(const Container& c) const { return slotPool.data() + c.offset; }
+  const std::uint64_t* wordsOf(const Container& c) const { return wordPool.data() + c.offset; }
+
+  /**
+   * Containers of the pages of the set, sorted by page number, and the slots and bitset words
+   * they point into. No container is empty.
+   */
+  std::vector<Container> containers;
+  std::vector<SlotId> slotPool;
+  std::vector<std::uint64_t> wordPool;
+};
+
+RidBitmap bitmapAnd(const RidBitmap& a, const RidBitmap& b);
+RidBitmap bitmapOr(const RidBitmap& a, const RidBitmap& b);
+
+/**
+ * @brief Bitmap of the rids of all entries of index in range. Empty if no key is in range.
+ */
+void scanBitmap(BTreeIndex& index, const ScanRange& range, RidBitmap& outBitmap);
+
+/**
+ * @brief Bitmap of the rids of all entries of index in any of ranges, which are sorted and do
+ * not overlap as for BTreeIndex::startMultiScan(). Empty if no key is in any range.
+ */
+void scanBitmap(BTreeIndex& index, const std::vector<ScanRange>& ranges, RidBitmap& outBitmap);
+
+}